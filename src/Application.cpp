@@ -211,6 +211,10 @@ void Application::Init()
 
     Configuration::Initialize();
 
+    // Debug/LogLevel: 0 debug, 1 info, 2 warnings, 3 errors. Debug/LogFlush: 0 per batch, 1 per message, 2 on exit.
+    Log::SetLevel(Log::ELogLevel(Clamp(int(Configuration::GetConfigf("LogLevel", "Debug")), int(Log::LOG_DEBUG), int(Log::LOG_ERROR))));
+    Log::SetFlushPolicy(Log::EFlushPolicy(Clamp(int(Configuration::GetConfigf("LogFlush", "Debug")), int(Log::FLUSH_BATCH), int(Log::FLUSH_EXIT))));
+
     bool Setup = false;
 
     if (RunMode == MODE_PLAY)
@@ -502,6 +506,8 @@ void Application::HandleScrollInput(double xOff, double yOff)
 
 void Application::Close()
 {
+    Game::SongWheel::GetInstance().StopWatching();
+
     if (Game)
     {
         Game->Cleanup();
@@ -10,6 +10,14 @@
 #include "Logging.h"
 #include "osuBackgroundAnimation.h"
 #include "VideoPlayback.h"
+#include "ImageStreamer.h"
+
+CfgVar StreamBGA("StreamBGA");
+CfgVar StreamBGALookahead("StreamBGALookahead");
+CfgVar StreamBGAThreads("StreamBGAThreads");
+
+// How early to get a video ready before its layer shows it.
+const double VideoPrerollTime = 1.0;
 
 std::filesystem::path GetSongBackground(Game::Song &Song)
 {
@@ -68,6 +76,7 @@ class BMSBackground : public BackgroundAnimation
 	
 
     ImageList List;
+    std::unique_ptr<ImageStreamer> Streamer;
     Game::VSRG::Song* Song;
     Game::VSRG::Difficulty* Difficulty;
     bool Validated;
@@ -80,6 +89,7 @@ public:
         this->Difficulty = Difficulty;
         this->Song = Song;
         Validated = false;
+        List.SetCompressible(true);
         MissTime = 0;
 
 		MaxWidth = MaxHeight = 256;
@@ -108,6 +118,24 @@ public:
         EventsLayer1 = Difficulty->Data->BMPEvents->BMPEventsLayer;
         EventsLayer2 = Difficulty->Data->BMPEvents->BMPEventsLayer2;
 
+        sort(EventsLayer0.begin(), EventsLayer0.end());
+        sort(EventsLayerMiss.begin(), EventsLayerMiss.end());
+        sort(EventsLayer1.begin(), EventsLayer1.end());
+        sort(EventsLayer2.begin(), EventsLayer2.end());
+
+        // The miss layer can show up at any time and BMPs 0/1 are needed at Validate,
+        // so those are always loaded up front. Everything else is streamed in if enabled.
+        std::set<int> AlwaysResident = { 0, 1 };
+        if (StreamBGA)
+        {
+            double Lookahead = StreamBGALookahead > 0 ? double(StreamBGALookahead) : 4.0;
+            int Threads = StreamBGAThreads > 0 ? int(StreamBGAThreads) : 2;
+            Streamer = std::make_unique<ImageStreamer>(Lookahead, Threads);
+
+            for (auto &ev : EventsLayerMiss)
+                AlwaysResident.insert(ev.BMP);
+        }
+
 		for (auto v : Difficulty->Data->BMPEvents->BMPList) {
 			std::filesystem::path vs = v.second;
 			std::filesystem::path path = Song->SongDirectory / vs;
@@ -115,7 +143,7 @@ public:
 			{
 				auto vid = new VideoPlayback();
 				if (vid->Open(path)) {
-					vid->StartDecodeThread();
+					vid->StartDecoding();
 					List.AddToListIndex(vid, v.first);
 					Videos[v.first] = vid;
 					MaxWidth = std::max(MaxWidth, vid->w);
@@ -124,15 +152,46 @@ public:
 				else
 					delete vid;
 			}
+			else if (Streamer && AlwaysResident.find(v.first) == AlwaysResident.end())
+				Streamer->AddImage(v.first, path);
 			else
 				List.AddToListIndex(path, v.first);
 
 		}
 
+        if (Streamer)
+        {
+            AddStreamIntervals(EventsLayer0);
+            AddStreamIntervals(EventsLayer1);
+            AddStreamIntervals(EventsLayer2);
+            Streamer->Prefetch(0);
+        }
+
         List.AddToList(Song->BackgroundFilename, Song->SongDirectory);
         List.LoadAll();
     }
 
+    // Each BMP is displayed from its event until the next one on the same layer.
+    void AddStreamIntervals(const std::vector<AutoplayBMP> &events_layer)
+    {
+        for (size_t i = 0; i < events_layer.size(); i++)
+        {
+            double End = i + 1 < events_layer.size() ? events_layer[i + 1].Time : std::numeric_limits<double>::infinity();
+            Streamer->AddInterval(events_layer[i].BMP, events_layer[i].Time, End);
+        }
+    }
+
+    Texture* GetImage(int index)
+    {
+        if (Streamer)
+        {
+            auto tex = Streamer->GetFromIndex(index);
+            if (tex) return tex;
+        }
+
+        return List.GetFromIndex(index);
+    }
+
     void Validate() override
     {
         if (Validated) return;
@@ -162,11 +221,6 @@ public:
 		Layer0->SetWidth(1);
 		Layer0->SetHeight(1);
 
-        sort(EventsLayer0.begin(), EventsLayer0.end());
-        sort(EventsLayerMiss.begin(), EventsLayerMiss.end());
-        sort(EventsLayer1.begin(), EventsLayer1.end());
-        sort(EventsLayer2.begin(), EventsLayer2.end());
-
         // Add BMP 0 as default value for layer 0. I was opting for a
         // if() at SetLayerImage time, but we're microoptimizing for branch mishits.
         if (EventsLayerMiss.size() == 0 || (EventsLayerMiss.size() > 0 && EventsLayerMiss[0].Time > 0))
@@ -188,11 +242,21 @@ public:
     void SetLayerImage(Sprite *sprite, std::vector<AutoplayBMP> &events_layer, double time)
     {
         auto bmp = std::lower_bound(events_layer.begin(), events_layer.end(), time, TimeSegmentCompare<AutoplayBMP>);
+
+        // Have a video coming up on this layer start decoding from its beginning.
+        if (bmp != events_layer.end() && bmp->Time - time < VideoPrerollTime &&
+            (bmp == events_layer.begin() || (bmp - 1)->BMP != bmp->BMP))
+        {
+            auto vid = dynamic_cast<VideoPlayback*>(GetImage(bmp->BMP));
+            if (vid)
+                vid->Preroll(0);
+        }
+
         if (bmp != events_layer.begin())
         {
             bmp = bmp - 1;
 
-			auto tex = List.GetFromIndex(bmp->BMP);
+			auto tex = GetImage(bmp->BMP);
 			auto vid = dynamic_cast<VideoPlayback*>(tex);
 			if (vid) {
 				vid->UpdateClock(time - bmp->Time);
@@ -213,6 +277,9 @@ public:
     {
         if (!Validated) return;
 
+        if (Streamer)
+            Streamer->Update(Time);
+
         SetLayerImage(Layer0.get(), EventsLayer0, Time);
         SetLayerImage(LayerMiss.get(), EventsLayerMiss, Time);
         SetLayerImage(Layer1.get(), EventsLayer1, Time);
@@ -251,6 +318,7 @@ public:
         : BackgroundAnimation(parent), List(this)
     {
         Log::Printf("Using static background: %s\n", Filename.string().c_str());
+        List.SetCompressible(true);
         List.AddToListIndex(Filename, 0);
     }
 
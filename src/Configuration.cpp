@@ -19,6 +19,15 @@ std::string ConfigFile = "config.ini";
 
 const std::string GlobalNamespace = "Global";
 
+std::atomic<uint32_t> Configuration::Generation(1);
+
+// Reading a missing key writes it in, and song scans read settings from several threads at once.
+std::mutex ConfigMutex;
+
+std::mutex ListenerMutex;
+std::map<int, ChangeNotification> ChangeListeners;
+int NextListenerID = 1;
+
 class ConfigurationException : std::exception
 {
 private:
@@ -30,6 +39,33 @@ public:
 
 ConfigurationException CfgNotLoaded("Configuration not loaded yet.");
 
+int Configuration::AddChangeListener(ChangeNotification Fn)
+{
+	std::unique_lock<std::mutex> lock(ListenerMutex);
+	ChangeListeners[NextListenerID] = Fn;
+	return NextListenerID++;
+}
+
+void Configuration::RemoveChangeListener(int ID)
+{
+	std::unique_lock<std::mutex> lock(ListenerMutex);
+	ChangeListeners.erase(ID);
+}
+
+// Listeners are called on a copy, without the lock, so they may read the configuration or add and remove listeners.
+void NotifyChange(const std::string &Name, const std::string &Namespace)
+{
+	std::vector<ChangeNotification> Listeners;
+	{
+		std::unique_lock<std::mutex> lock(ListenerMutex);
+		for (auto &L : ChangeListeners)
+			Listeners.push_back(L.second);
+	}
+
+	for (auto &L : Listeners)
+		L(Name, Namespace);
+}
+
 void Configuration::SetConfigFile(std::string cfg)
 {
     ConfigFile = cfg;
@@ -54,6 +90,8 @@ void Configuration::Initialize()
     SkinCfgLua->RunScript(GameState::GetInstance().GetSkinFile("skin.lua"));
 
     LoadTextureParameters();
+    Generation++;
+    NotifyChange("", "");
 }
 
 void Configuration::Cleanup()
@@ -100,14 +138,16 @@ std::string GetConfsInt(std::string Name, std::string Namespace, LuaManager &L)
     return Retval;
 }
 
-double GetConffInt(std::string Name, std::string Namespace, LuaManager &L)
+double GetConffInt(std::string Name, std::string Namespace, LuaManager &L, bool &IsFunction)
 {
     double Retval = 0;
+    IsFunction = false;
     if (Namespace.length())
     {
         if (L.UseArray(Namespace))
         {
 			if (L.CallFunction(Name.c_str(), 0, 1)) {
+				IsFunction = true;
 				if (L.RunFunction())
 					Retval = L.GetFunctionResultD();
 			}
@@ -120,6 +160,7 @@ double GetConffInt(std::string Name, std::string Namespace, LuaManager &L)
     }
     else {
 		if (L.CallFunction(Name.c_str(), 0, 1)) {
+			IsFunction = true;
 			if (L.RunFunction())
 				Retval = L.GetFunctionResultD();
 		} else
@@ -138,6 +179,7 @@ std::string Configuration::GetConfigs(std::string Name, std::string Namespace)
     if (Namespace.length()) g = Namespace;
     std::string out;
 
+	std::unique_lock<std::mutex> lock(ConfigMutex);
 	if (!Config) throw CfgNotLoaded;
 
     if (Config->GetValue(g.c_str(), Name.c_str()))
@@ -152,8 +194,14 @@ void Configuration::SetConfig(std::string Name, std::string Value, std::string N
     std::string g = GlobalNamespace;
     if (Namespace.length()) g = Namespace;
 
-	if (!Config) throw CfgNotLoaded;
-    Config->SetValue(g.c_str(), Name.c_str(), Value.c_str());
+	{
+		std::unique_lock<std::mutex> lock(ConfigMutex);
+		if (!Config) throw CfgNotLoaded;
+		Config->SetValue(g.c_str(), Name.c_str(), Value.c_str());
+		Generation++;
+	}
+
+	NotifyChange(Name, g);
 }
 
 float  Configuration::GetConfigf(std::string Name, std::string Namespace)
@@ -162,6 +210,7 @@ float  Configuration::GetConfigf(std::string Name, std::string Namespace)
     double out;
     if (Namespace.length()) g = Namespace;
 
+	std::unique_lock<std::mutex> lock(ConfigMutex);
 	if (!Config) throw CfgNotLoaded;
     if (Config->GetDoubleValue(g.c_str(), Name.c_str(), -10000) == -10000)
     {
@@ -178,14 +227,19 @@ std::string Configuration::GetSkinConfigs(std::string Name, std::string Namespac
     return GetConfsInt(Name, Namespace, *SkinCfgLua);
 }
 
-double  Configuration::GetSkinConfigf(std::string Name, std::string Namespace)
+double  Configuration::GetSkinConfigf(std::string Name, std::string Namespace, bool *IsFunction)
 {
-    return GetConffInt(Name, Namespace, *SkinCfgLua);
+    bool Called;
+    double Value = GetConffInt(Name, Namespace, *SkinCfgLua, Called);
+    if (IsFunction)
+        *IsFunction = Called;
+    return Value;
 }
 
 void Configuration::GetConfigListS(std::string Name, std::map<std::string, std::string> &Out, std::string DefaultKeyName)
 {
     CSimpleIniA::TNamesDepend List;
+	std::unique_lock<std::mutex> lock(ConfigMutex);
 	if (!Config) throw CfgNotLoaded;
 
     Config->GetAllKeys(Name.c_str(), List);
@@ -205,6 +259,7 @@ void Configuration::GetConfigListS(std::string Name, std::map<std::string, std::
 void Configuration::GetConfigListS(std::string Name, std::map<std::string, std::filesystem::path> &Out, std::string DefaultKeyName)
 {
     CSimpleIniA::TNamesDepend List;
+	std::unique_lock<std::mutex> lock(ConfigMutex);
 	if (!Config) throw CfgNotLoaded;
 
     Config->GetAllKeys(Name.c_str(), List);
@@ -9,7 +9,8 @@ namespace Configuration
     std::string GetConfigs(std::string Name, std::string Namespace = "");
     float  GetConfigf(std::string Name, std::string Namespace = "");
     std::string GetSkinConfigs(std::string Name, std::string Namespace = "");
-    double  GetSkinConfigf(std::string Name, std::string Namespace = "");
+    // IsFunction tells if the metric was computed by a skin function, rather than read off a variable.
+    double  GetSkinConfigf(std::string Name, std::string Namespace = "", bool *IsFunction = nullptr);
 
 	std::filesystem::path GetSkinSound(std::string snd);
     void GetConfigListS(std::string Name, std::map<std::string, std::string> &Out, std::string DefaultKeyName);
@@ -28,23 +29,60 @@ namespace Configuration
     // void SetConfig(std::string Name, float Value, std::string Namespace = "");
     /// void SaveConfig();
     void Cleanup();
+
+    // Bumped whenever a value may have changed: SetConfig and (re)loading the configuration or skin.
+    extern std::atomic<uint32_t> Generation;
+
+    // Told about the same changes as Generation, after the value is in: SetConfig passes the name and namespace
+    // (Global if none was given), (re)loading passes an empty name. Runs on the thread that made the change.
+    typedef std::function<void(const std::string &Name, const std::string &Namespace)> ChangeNotification;
+
+    // Returns an ID to remove it with.
+    int AddChangeListener(ChangeNotification Fn);
+    void RemoveChangeListener(int ID);
 }
 
 class ConfigurationVariable
 {
 protected:
 	std::string nm, ns;
+
+	// The Configuration::Generation flt() last resolved at in the high half and the value's bits in the low one,
+	// so a cached read is a single load. Generation 0 never matches, for values that can't be cached.
+	mutable std::atomic<uint64_t> cache;
+
+	virtual float resolve(bool &cacheable) const
+	{
+		cacheable = true;
+		return Configuration::GetConfigf(nm, ns);
+	}
 public:
-	ConfigurationVariable(std::string _nm, std::string _ns = "") : nm(_nm), ns(_ns) {};
+	ConfigurationVariable(std::string _nm, std::string _ns = "") : nm(_nm), ns(_ns), cache(0) {};
 	~ConfigurationVariable() = default;
 	virtual std::string str() const
 	{
 		return Configuration::GetConfigs(nm, ns);
 	};
 
-	virtual float flt() const
+	float flt() const
 	{
-		return Configuration::GetConfigf(nm, ns);
+		uint64_t c = cache.load(std::memory_order_acquire);
+		uint32_t gen = Configuration::Generation.load(std::memory_order_acquire);
+		uint32_t bits;
+		float value;
+
+		if (uint32_t(c >> 32) == gen)
+		{
+			bits = uint32_t(c);
+			memcpy(&value, &bits, sizeof value);
+			return value;
+		}
+
+		bool cacheable;
+		value = resolve(cacheable);
+		memcpy(&bits, &value, sizeof bits);
+		cache.store((uint64_t(cacheable ? gen : 0) << 32) | bits, std::memory_order_release);
+		return value;
 	}
 
 	operator float() const
@@ -83,9 +121,14 @@ public:
 		return Configuration::GetSkinConfigs(nm, ns);
 	}
 
-	float flt() const override
+protected:
+	// Skin functions may give a different value every call, so only plain values are cached.
+	float resolve(bool &cacheable) const override
 	{
-		return Configuration::GetSkinConfigf(nm, ns);
+		bool IsFunction;
+		float value = Configuration::GetSkinConfigf(nm, ns, &IsFunction);
+		cacheable = !IsFunction;
+		return value;
 	}
 };
 
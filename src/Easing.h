@@ -3,69 +3,212 @@
 #include <math.h>
 
 /*
-	The least redundant way of defining easings, semantically speaking!
+	Easings take the fraction of an animation that has passed (0 to 1) and return how far along
+	the animated value should be. Numbered as in osu! storyboards.
 */
-inline float func_ease_in(float lerp, std::function<float(float)> f)
+enum EEasing : int
 {
-	return f(lerp);
-}
+	EASE_LINEAR,
+	EASE_OUT,
+	EASE_IN,
+	EASE_QUAD_IN,
+	EASE_QUAD_OUT,
+	EASE_QUAD_INOUT,
+	EASE_CUBIC_IN,
+	EASE_CUBIC_OUT,
+	EASE_CUBIC_INOUT,
+	EASE_QUART_IN,
+	EASE_QUART_OUT,
+	EASE_QUART_INOUT,
+	EASE_QUINT_IN,
+	EASE_QUINT_OUT,
+	EASE_QUINT_INOUT,
+	EASE_SINE_IN,
+	EASE_SINE_OUT,
+	EASE_SINE_INOUT,
+	EASE_EXPO_IN,
+	EASE_EXPO_OUT,
+	EASE_EXPO_INOUT,
+	EASE_CIRC_IN,
+	EASE_CIRC_OUT,
+	EASE_CIRC_INOUT,
+	EASE_ELASTIC_IN,
+	EASE_ELASTIC_OUT,
+	EASE_ELASTIC_HALF_OUT,
+	EASE_ELASTIC_QUARTER_OUT,
+	EASE_ELASTIC_INOUT,
+	EASE_BACK_IN,
+	EASE_BACK_OUT,
+	EASE_BACK_INOUT,
+	EASE_BOUNCE_IN,
+	EASE_BOUNCE_OUT,
+	EASE_BOUNCE_INOUT,
+	EASE_COUNT
+};
 
-inline float func_ease_out(float lerp, std::function<float(float)> f)
+/*
+	The least redundant way of defining easings, semantically speaking!
+	Every easing is an "in" curve; out and in-out are derived from it at compile time.
+*/
+template<float (*f)(float)>
+inline float func_ease_out(float lerp)
 {
 	return 1 - f(1 - lerp);
 }
 
-inline float f2_ease_inout(float lerp, std::function<float(float)> f1, std::function<float(float)> f2)
+template<float (*f)(float)>
+inline float func_ease_inout(float lerp)
 {
 	lerp *= 2;
 	if (lerp < 1)
-		return func_ease_in(lerp, f1);
+		return f(lerp) / 2;
 	else
-		return func_ease_out(lerp - 1, f2);
+		return 1 - f(2 - lerp) / 2;
 }
 
-inline float func_ease_inout(float lerp, std::function<float(float)> f1)
+template<int v>
+inline float pow_ease_in(float lerp)
 {
-	return f2_ease_inout(lerp, f1, f1);
+	float r = lerp;
+	for (int i = 1; i < v; i++)
+		r *= lerp;
+	return r;
 }
 
-template<int v>
-float pow_ease_in(float lerp) 
+inline float sine_ease_in(float lerp)
 {
-	auto f = [](float l) -> float { return pow(l, v); };
-	return func_ease_in(lerp, f);
+	return 1 - cos(lerp * float(M_PI) / 2);
 }
 
-template<int v>
-float pow_ease_out(float lerp)
+inline float expo_ease_in(float lerp)
 {
-	auto f = [](float l) -> float { return pow(l, v); };
-	return func_ease_out(lerp, f);
+	return lerp == 0 ? 0 : pow(2.f, 10 * (lerp - 1));
 }
 
-template<int v>
-float pow_ease_inout(float lerp)
+inline float circ_ease_in(float lerp)
+{
+	return 1 - sqrt(std::max(1 - lerp * lerp, 0.f));
+}
+
+const float elastic_period = 0.3f;
+
+inline float elastic_ease_in(float lerp)
 {
-	auto f = [](float l) -> float { return pow(l, v); };
-	return func_ease_inout(lerp, f);
+	if (lerp == 0 || lerp == 1)
+		return lerp;
+
+	return -pow(2.f, 10 * (lerp - 1)) * sin((lerp - 1 - elastic_period / 4) * 2 * float(M_PI) / elastic_period);
 }
 
-inline float passthrough(float v) { return v; }
+// osu!'s elastic out has squashed variants, so it isn't derived from elastic in.
+template<int div>
+inline float elastic_ease_out(float lerp)
+{
+	if (lerp == 0 || lerp == 1)
+		return lerp;
+
+	return pow(2.f, -10 * lerp) * sin((lerp / div - elastic_period / 4) * 2 * float(M_PI) / elastic_period) + 1;
+}
 
+inline float elastic_ease_inout(float lerp)
+{
+	const float period = elastic_period * 1.5f;
 
-extern std::function<float(float)> ease_none;
-extern std::function<float(float)> ease_in;
-extern std::function<float(float)> ease_out;
-extern std::function<float(float)> ease_inout;
-extern std::function<float(float)> ease_3in;
-extern std::function<float(float)> ease_3out;
-extern std::function<float(float)> ease_3inout;
-extern std::function<float(float)> ease_4in;
-extern std::function<float(float)> ease_4out;
-extern std::function<float(float)> ease_4inout;
-extern std::function<float(float)> ease_5in;
-extern std::function<float(float)> ease_5out;
-extern std::function<float(float)> ease_5inout;
+	if (lerp == 0 || lerp == 1)
+		return lerp;
 
+	lerp = lerp * 2 - 1;
+	if (lerp < 0)
+		return -0.5f * pow(2.f, 10 * lerp) * sin((lerp - period / 4) * 2 * float(M_PI) / period);
+	else
+		return 0.5f * pow(2.f, -10 * lerp) * sin((lerp - period / 4) * 2 * float(M_PI) / period) + 1;
+}
 
+inline float back_ease_in(float lerp)
+{
+	const float s = 1.70158f;
+	return lerp * lerp * ((s + 1) * lerp - s);
+}
+
+// In-out overshoots further than in and out do.
+inline float back_ease_inout(float lerp)
+{
+	const float s = 1.70158f * 1.525f;
+
+	lerp *= 2;
+	if (lerp < 1)
+		return lerp * lerp * ((s + 1) * lerp - s) / 2;
+
+	lerp -= 2;
+	return (lerp * lerp * ((s + 1) * lerp + s) + 2) / 2;
+}
+
+inline float bounce_ease_out(float lerp)
+{
+	if (lerp < 1 / 2.75f)
+		return 7.5625f * lerp * lerp;
+	if (lerp < 2 / 2.75f) {
+		lerp -= 1.5f / 2.75f;
+		return 7.5625f * lerp * lerp + .75f;
+	}
+	if (lerp < 2.5f / 2.75f) {
+		lerp -= 2.25f / 2.75f;
+		return 7.5625f * lerp * lerp + .9375f;
+	}
+
+	lerp -= 2.625f / 2.75f;
+	return 7.5625f * lerp * lerp + .984375f;
+}
+
+inline float bounce_ease_in(float lerp)
+{
+	return 1 - bounce_ease_out(1 - lerp);
+}
+
+// Eased fraction for an EEasing. Unknown easings are linear.
+inline float ApplyEasing(int ease, float lerp)
+{
+	switch (ease)
+	{
+	case EASE_OUT:
+	case EASE_QUAD_OUT: return func_ease_out<pow_ease_in<2>>(lerp);
+	case EASE_IN:
+	case EASE_QUAD_IN: return pow_ease_in<2>(lerp);
+	case EASE_QUAD_INOUT: return func_ease_inout<pow_ease_in<2>>(lerp);
+	case EASE_CUBIC_IN: return pow_ease_in<3>(lerp);
+	case EASE_CUBIC_OUT: return func_ease_out<pow_ease_in<3>>(lerp);
+	case EASE_CUBIC_INOUT: return func_ease_inout<pow_ease_in<3>>(lerp);
+	case EASE_QUART_IN: return pow_ease_in<4>(lerp);
+	case EASE_QUART_OUT: return func_ease_out<pow_ease_in<4>>(lerp);
+	case EASE_QUART_INOUT: return func_ease_inout<pow_ease_in<4>>(lerp);
+	case EASE_QUINT_IN: return pow_ease_in<5>(lerp);
+	case EASE_QUINT_OUT: return func_ease_out<pow_ease_in<5>>(lerp);
+	case EASE_QUINT_INOUT: return func_ease_inout<pow_ease_in<5>>(lerp);
+	case EASE_SINE_IN: return sine_ease_in(lerp);
+	case EASE_SINE_OUT: return func_ease_out<sine_ease_in>(lerp);
+	case EASE_SINE_INOUT: return func_ease_inout<sine_ease_in>(lerp);
+	case EASE_EXPO_IN: return expo_ease_in(lerp);
+	case EASE_EXPO_OUT: return func_ease_out<expo_ease_in>(lerp);
+	case EASE_EXPO_INOUT: return func_ease_inout<expo_ease_in>(lerp);
+	case EASE_CIRC_IN: return circ_ease_in(lerp);
+	case EASE_CIRC_OUT: return func_ease_out<circ_ease_in>(lerp);
+	case EASE_CIRC_INOUT: return func_ease_inout<circ_ease_in>(lerp);
+	case EASE_ELASTIC_IN: return elastic_ease_in(lerp);
+	case EASE_ELASTIC_OUT: return elastic_ease_out<1>(lerp);
+	case EASE_ELASTIC_HALF_OUT: return elastic_ease_out<2>(lerp);
+	case EASE_ELASTIC_QUARTER_OUT: return elastic_ease_out<4>(lerp);
+	case EASE_ELASTIC_INOUT: return elastic_ease_inout(lerp);
+	case EASE_BACK_IN: return back_ease_in(lerp);
+	case EASE_BACK_OUT: return func_ease_out<back_ease_in>(lerp);
+	case EASE_BACK_INOUT: return back_ease_inout(lerp);
+	case EASE_BOUNCE_IN: return bounce_ease_in(lerp);
+	case EASE_BOUNCE_OUT: return bounce_ease_out(lerp);
+	case EASE_BOUNCE_INOUT: return func_ease_inout<bounce_ease_in>(lerp);
+	case EASE_LINEAR:
+	default:
+		return lerp;
+	}
+}
 
+// out[i] = Lerp(from[i], to[i], eased lerp) for count values, with the easing evaluated once.
+void LerpEased(int ease, float lerp, const float *from, const float *to, float *out, size_t count);
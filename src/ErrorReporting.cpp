@@ -9,6 +9,9 @@ void InitDbgHelp();
 
 void signalrec(int sig) {
 	PrintStackTrace();
+
+	// The trace is only queued; get it into log.txt before the process goes down.
+	Log::FlushAfterCrash();
 }
 
 void RegisterSignals() {
@@ -0,0 +1,126 @@
+#include "pch.h"
+
+#include "Fingerprint.h"
+#include "MappedFile.h"
+
+namespace Fingerprint
+{
+	const uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	const uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t Rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	// Little-endian regardless of alignment, so the digest is the same everywhere.
+	inline uint64_t Read64(const uint8_t* p)
+	{
+		uint64_t v = 0;
+		for (int i = 7; i >= 0; i--)
+			v = (v << 8) | p[i];
+		return v;
+	}
+
+	inline uint64_t Read32(const uint8_t* p)
+	{
+		return uint64_t(p[0]) | uint64_t(p[1]) << 8 | uint64_t(p[2]) << 16 | uint64_t(p[3]) << 24;
+	}
+
+	inline uint64_t Round(uint64_t Acc, uint64_t Input)
+	{
+		Acc += Input * Prime2;
+		Acc = Rotl(Acc, 31);
+		return Acc * Prime1;
+	}
+
+	inline uint64_t MergeRound(uint64_t Acc, uint64_t Val)
+	{
+		Acc ^= Round(0, Val);
+		return Acc * Prime1 + Prime4;
+	}
+
+	uint64_t Hash(const void* Data, size_t Length, uint64_t Seed)
+	{
+		auto p = static_cast<const uint8_t*>(Data);
+		auto End = p + Length;
+		uint64_t h;
+
+		if (Length >= 32)
+		{
+			uint64_t v1 = Seed + Prime1 + Prime2;
+			uint64_t v2 = Seed + Prime2;
+			uint64_t v3 = Seed;
+			uint64_t v4 = Seed - Prime1;
+
+			for (; p + 32 <= End; p += 32)
+			{
+				v1 = Round(v1, Read64(p));
+				v2 = Round(v2, Read64(p + 8));
+				v3 = Round(v3, Read64(p + 16));
+				v4 = Round(v4, Read64(p + 24));
+			}
+
+			h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+			h = MergeRound(h, v1);
+			h = MergeRound(h, v2);
+			h = MergeRound(h, v3);
+			h = MergeRound(h, v4);
+		}
+		else
+			h = Seed + Prime5;
+
+		h += Length;
+
+		for (; p + 8 <= End; p += 8)
+		{
+			h ^= Round(0, Read64(p));
+			h = Rotl(h, 27) * Prime1 + Prime4;
+		}
+
+		if (p + 4 <= End)
+		{
+			h ^= Read32(p) * Prime1;
+			h = Rotl(h, 23) * Prime2 + Prime3;
+			p += 4;
+		}
+
+		for (; p < End; p++)
+		{
+			h ^= *p * Prime5;
+			h = Rotl(h, 11) * Prime1;
+		}
+
+		h ^= h >> 33;
+		h *= Prime2;
+		h ^= h >> 29;
+		h *= Prime3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	std::string ToString(uint64_t Hash)
+	{
+		char Out[17];
+		snprintf(Out, sizeof Out, "%016llx", (unsigned long long)Hash);
+		return Out;
+	}
+
+	std::string ForFile(std::filesystem::path Filename)
+	{
+		uint64_t h;
+		MappedFile File;
+
+		if (File.Open(Filename))
+			h = Hash(File.GetData(), File.GetSize());
+		else if (std::filesystem::exists(Filename) && std::filesystem::file_size(Filename) == 0)
+			h = Hash(nullptr, 0);
+		else
+			return "";
+
+		return ToString(h);
+	}
+}
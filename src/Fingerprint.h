@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+	Fast content hashes for telling whether a chart file changed. XXH64 over the memory-mapped file:
+	it isn't cryptographic, so anything that has to identify a chart to other people (scores, online)
+	should use its SHA-256 instead (Utility::GetSha256ForFile).
+*/
+namespace Fingerprint
+{
+	uint64_t Hash(const void* Data, size_t Length, uint64_t Seed = 0);
+	std::string ToString(uint64_t Hash);
+
+	// Hex digest of the file's contents. Empty if it can't be read.
+	std::string ForFile(std::filesystem::path Filename);
+}
@@ -244,7 +244,7 @@ Texture* GameState::GetSongBG()
 
 		if (std::filesystem::exists(toLoad))
 		{
-			SongBG->LoadFile(toLoad, true);
+			SongBG->LoadFile(toLoad, true, true);
 			return SongBG;
 		}
 
@@ -287,7 +287,7 @@ Texture* GameState::GetSongStage()
 
 			if (File.string().length() && std::filesystem::exists(toLoad))
 			{
-				StageImage->LoadFile(toLoad, true);
+				StageImage->LoadFile(toLoad, true, true);
 				return StageImage;
 			}
 
@@ -378,12 +378,12 @@ void GameState::SubmitScore(int pn)
 	// TODO
 }
 
-bool Game::GameState::IsSongUnlocked(Game::Song * song)
+bool Game::GameState::IsSongUnlocked(int SongID)
 {
 	return true;
 }
 
-void Game::GameState::UnlockSong(Game::Song * song)
+void Game::GameState::UnlockSong(int SongID)
 {
 }
 
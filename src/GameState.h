@@ -107,8 +107,9 @@ namespace Game
 		int GetPlayerCount() const;
 		void SubmitScore(int pn);
 
-		bool IsSongUnlocked(Game::Song *song);
-		void UnlockSong(Game::Song *song);
+		// By song ID, so the wheel can tell without loading the song.
+		bool IsSongUnlocked(int SongID);
+		void UnlockSong(int SongID);
 
 		void SetRootScreen(std::shared_ptr<Screen> root);
 		std::shared_ptr<Screen> GetCurrentScreen();
@@ -9,12 +9,14 @@
 ImageList::ImageList(bool ReleaseAtDestruction)
 {
     ShouldDeleteAtDestruction = ReleaseAtDestruction;
+    Compressible = false;
 }
 
 ImageList::ImageList(Interruptible *Parent, bool ReleaseAtDestruction)
     : Interruptible(Parent)
 {
     ShouldDeleteAtDestruction = ReleaseAtDestruction;
+    Compressible = false;
 }
 
 ImageList::~ImageList()
@@ -31,7 +33,7 @@ void ImageList::AddToList(const std::filesystem::path Filename, const std::files
 
     if (Images.find(ResFilename) == Images.end())
     {
-        ImageLoader::AddToPending(ResFilename);
+        ImageLoader::AddToPending(ResFilename, Compressible);
         Images[ResFilename] = nullptr;
     }
 }
@@ -40,7 +42,7 @@ void ImageList::AddToListIndex(const std::filesystem::path Filename, int Index)
 {
     if (ImagesIndex.find(Index) == ImagesIndex.end())
     {
-        ImageLoader::AddToPending(Filename);
+        ImageLoader::AddToPending(Filename, Compressible);
         Images[Filename] = nullptr;
         ImagesIndex[Index] = nullptr;
         ImagesIndexPending[Index] = Filename;
@@ -52,6 +54,11 @@ void ImageList::AddToListIndex(Texture * tex, int Index)
 	ImagesIndex[Index] = tex;
 }
 
+void ImageList::SetCompressible(bool compressible)
+{
+    Compressible = compressible;
+}
+
 void ImageList::Destroy()
 {
     for (auto i = Images.begin(); i != Images.end(); ++i)
@@ -71,7 +78,7 @@ bool ImageList::LoadAll()
     bool WereErrors = false;
     for (auto i = Images.begin(); i != Images.end(); ++i)
     {
-        i->second = ImageLoader::Load(i->first);
+        i->second = ImageLoader::Load(i->first, Compressible);
         if (i->second == nullptr)
             WereErrors = true;
         CheckInterruption();
@@ -79,7 +86,7 @@ bool ImageList::LoadAll()
 
     for (auto i = ImagesIndexPending.begin(); i != ImagesIndexPending.end();)
     {
-        ImagesIndex[i->first] = ImageLoader::Load(i->second);
+        ImagesIndex[i->first] = ImageLoader::Load(i->second, Compressible);
         if (ImagesIndex[i->first] == nullptr)
             WereErrors = true;
 
@@ -15,6 +15,7 @@ class ImageList : public Interruptible
     std::map <int, std::filesystem::path> ImagesIndexPending;
     std::map <int, Texture*> ImagesIndex;
     bool ShouldDeleteAtDestruction;
+    bool Compressible;
 
 public:
 
@@ -23,6 +24,9 @@ public:
     ~ImageList();
 
     void Destroy();
+
+    // Let images added after this call use the compressed texture cache.
+    void SetCompressible(bool compressible);
     void AddToList(const std::filesystem::path Filename, const std::filesystem::path Prefix);
 
 	// AddToListIndex asks ImageLoader to load on a different thread.
@@ -5,11 +5,12 @@
 
 #include "Texture.h"
 #include "ImageLoader.h"
+#include "TextureCache.h"
 #include "Rendering.h"
 
 std::mutex LoadMutex;
 std::map<std::filesystem::path, Texture*> ImageLoader::Textures;
-std::map<std::filesystem::path, ImageLoader::UploadData> ImageLoader::PendingUploads;
+std::map<std::filesystem::path, ImageData> ImageLoader::PendingUploads;
 
 CfgVar ImageLoaderMessages("ImageLoader", "Debug");
 CfgVar XorTexture("XorTexture", "Debug");
@@ -76,7 +77,7 @@ Texture* ImageLoader::InsertImage(std::filesystem::path Name, ImageData &imgData
     Texture* I;
     if (XorTexture) return Renderer::GetXorTexture();
 
-    if (imgData.Data.size() == 0) return nullptr;
+    if (imgData.Data.size() == 0 && imgData.CompressedData.size() == 0) return nullptr;
 
     if (Textures.find(Name) == Textures.end())
         I = (Textures[Name] = new Texture());
@@ -89,71 +90,281 @@ Texture* ImageLoader::InsertImage(std::filesystem::path Name, ImageData &imgData
     return I;
 }
 
-template<typename Stream>
-auto open_image(Stream&& in)
+enum class ImageFormat
 {
-    using namespace boost::gil;
+    Unknown,
+    PNG,
+    JPEG,
+    BMP,
+    TGA
+};
+
+// Guess the format from the header bytes so that we only need to set up one decoder.
+// TGA has no magic number, so anything we don't recognize is handed to the TGA decoder.
+ImageFormat sniff_format(const unsigned char* buf, size_t len)
+{
+    static const unsigned char png_sig[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+    if (len >= sizeof(png_sig) && memcmp(buf, png_sig, sizeof(png_sig)) == 0)
+        return ImageFormat::PNG;
+
+    if (len >= 3 && buf[0] == 0xFF && buf[1] == 0xD8 && buf[2] == 0xFF)
+        return ImageFormat::JPEG;
+
+    if (len >= 2 && buf[0] == 'B' && buf[1] == 'M')
+        return ImageFormat::BMP;
+
+    // color map type, image type and bpp should all be sane for TGA.
+    if (len >= 18 && buf[1] <= 1)
+    {
+        auto type = buf[2];
+        auto bpp = buf[16];
+        bool valid_type = (type >= 1 && type <= 3) || (type >= 9 && type <= 11);
+        bool valid_bpp = bpp == 8 || bpp == 15 || bpp == 16 || bpp == 24 || bpp == 32;
+        if (valid_type && valid_bpp)
+            return ImageFormat::TGA;
+    }
+
+    return ImageFormat::Unknown;
+}
+
+// Read-only, seekable view over a memory buffer so gil can read without copying it into a stringstream.
+class memory_streambuf : public std::streambuf
+{
+public:
+    memory_streambuf(const unsigned char* buf, size_t len)
+    {
+        auto p = (char*)buf;
+        setg(p, p, p + len);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        char* target;
+        if (dir == std::ios_base::beg)
+            target = eback() + off;
+        else if (dir == std::ios_base::cur)
+            target = gptr() + off;
+        else
+            target = egptr() + off;
+
+        if (target < eback() || target > egptr())
+            return pos_type(off_type(-1));
+
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Decode using libpng's simplified API straight into the output buffer.
+bool decode_png(const unsigned char* buf, size_t len, ImageData &out)
+{
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_memory(&image, buf, len))
+        return false;
+
+    image.format = PNG_FORMAT_RGBA;
+    out.Data.resize(image.width * image.height);
+
+    if (!png_image_finish_read(&image, nullptr, out.Data.data(), 0, nullptr))
+    {
+        png_image_free(&image);
+        out.Data.clear();
+        return false;
+    }
+
+    out.Width = image.width;
+    out.Height = image.height;
+    return true;
+}
+
+template <class T>
+T read_le(const unsigned char* p)
+{
+    // Put together unsigned, since shifting into the sign bit of a signed T is undefined.
+    typename std::make_unsigned<T>::type ret = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+        ret |= decltype(ret)(p[i]) << (8 * i);
+    return T(ret);
+}
+
+// Fast path for the uncompressed 24 bit and palettized BMPs that make up most BMS BGAs.
+// Returns false for anything else (RLE, bitfields, 16/32 bits) so gil can deal with it,
+// and throws for headers that don't fit in the file, which neither of us can read.
+bool decode_bmp(const unsigned char* buf, size_t len, ImageData &out)
+{
+    const size_t file_header_size = 14;
+    if (len < file_header_size + 40)
+        return false;
+
+    auto data_offset = read_le<uint32_t>(buf + 10);
+    auto info = buf + file_header_size;
+    auto info_size = read_le<uint32_t>(info);
+    if (info_size < 40)
+        return false;
+
+    auto width = read_le<int32_t>(info + 4);
+    auto height = read_le<int32_t>(info + 8);
+    auto bpp = read_le<uint16_t>(info + 14);
+    auto compression = read_le<uint32_t>(info + 16);
+    auto colors_used = read_le<uint32_t>(info + 32);
+
+    // INT32_MIN has no positive counterpart.
+    if (width <= 0 || height == 0 || height == std::numeric_limits<int32_t>::min())
+        throw std::runtime_error("BMP has an invalid size");
+
+    if (file_header_size + info_size > len || data_offset > len)
+        throw std::runtime_error("BMP header runs past the end of the file");
 
-    rgba8_image_t img;
-    do
+    if (compression != 0)
+        return false;
+
+    if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 24)
+        return false;
+
+    bool bottom_up = height > 0;
+    height = bottom_up ? height : -height;
+
+    size_t stride = ((size_t(width) * bpp + 31) / 32) * 4;
+    if (stride > (len - data_offset) / size_t(height))
+        throw std::runtime_error("BMP pixel data runs past the end of the file");
+
+    // palette entries are BGRX quads right after the info header.
+    uint32_t palette[256] = {};
+    if (bpp <= 8)
     {
-        try
+        size_t max_colors = size_t(1) << bpp;
+        size_t count = colors_used ? std::min<size_t>(colors_used, max_colors) : max_colors;
+        auto pal = info + info_size;
+        if (file_header_size + info_size + count * 4 > data_offset)
+            throw std::runtime_error("BMP palette runs into the pixel data");
+
+        for (size_t i = 0; i < count; i++)
         {
-            try
-            {
-                read_and_convert_image(in, img, png_tag());
-                break;
-            }
-            catch (std::ios_base::failure) {}
+            auto c = reinterpret_cast<unsigned char*>(&palette[i]);
+            c[0] = pal[i * 4 + 2];
+            c[1] = pal[i * 4 + 1];
+            c[2] = pal[i * 4 + 0];
+            c[3] = 0xFF;
+        }
+    }
 
-            in.clear();
-            in.seekg(0);
-            try
-            {
-                read_and_convert_image(in, img, jpeg_tag());
-                break;
-            }
-            catch (std::ios_base::failure) {}
+    out.Data.resize(size_t(width) * height);
+    out.Width = width;
+    out.Height = height;
+
+    for (int y = 0; y < height; y++)
+    {
+        auto src = buf + data_offset + stride * (bottom_up ? height - 1 - y : y);
+        auto dst = out.Data.data() + size_t(y) * width;
 
-            in.clear();
-            in.seekg(0);
-            try
+        if (bpp == 24)
+        {
+            auto dst8 = reinterpret_cast<unsigned char*>(dst);
+            for (int x = 0; x < width; x++)
             {
-                read_and_convert_image(in, img, targa_tag());
-                break;
+                dst8[x * 4 + 0] = src[x * 3 + 2];
+                dst8[x * 4 + 1] = src[x * 3 + 1];
+                dst8[x * 4 + 2] = src[x * 3 + 0];
+                dst8[x * 4 + 3] = 0xFF;
             }
-            catch (std::ios_base::failure) {}
-
-            in.clear();
-            in.seekg(0);
-            read_and_convert_image(in, img, bmp_tag());
         }
-        catch (...)
+        else if (bpp == 8)
         {
-            Log::Printf("Could not load image");
+            for (int x = 0; x < width; x++)
+                dst[x] = palette[src[x]];
         }
-    } while (false);
+        else
+        {
+            int per_byte = 8 / bpp;
+            int mask = (1 << bpp) - 1;
+            for (int x = 0; x < width; x++)
+            {
+                int shift = 8 - bpp * (x % per_byte + 1);
+                dst[x] = palette[(src[x / per_byte] >> shift) & mask];
+            }
+        }
+    }
 
-    auto v = view(img);
-    using pixel = decltype(v)::value_type;
-    auto data = std::vector<uint32_t>();
-	data.resize(v.width() * v.height());
+    return true;
+}
 
-	static_assert(sizeof(pixel) == sizeof(uint32_t), "Pixels are required to be RGBA 32 bits");
-    copy_pixels(v, interleaved_view(v.width(), v.height(), (pixel*)data.data(),
-        v.width() * sizeof(pixel)));
+// Generic gil decoding, reading the header first so we can convert straight into the output buffer.
+template <class Tag>
+void decode_gil(const unsigned char* buf, size_t len, ImageData &out, Tag tag)
+{
+    using namespace boost::gil;
+
+    memory_streambuf sbuf(buf, len);
+    std::istream in(&sbuf);
+
+    auto info = read_image_info(in, tag);
+    int w = info._info._width;
+    int h = abs(info._info._height);
+
+    in.clear();
+    in.seekg(0);
+
+    using pixel = rgba8_pixel_t;
+    static_assert(sizeof(pixel) == sizeof(uint32_t), "Pixels are required to be RGBA 32 bits");
+
+    out.Data.resize(size_t(w) * h);
+    auto v = interleaved_view(w, h, (pixel*)out.Data.data(), w * sizeof(pixel));
+    read_and_convert_view(in, v, tag);
 
+    out.Width = w;
+    out.Height = h;
+}
+
+ImageData decode_image(const unsigned char* buf, size_t len)
+{
+    using namespace boost::gil;
 
     ImageData out;
-    out.Data.assign(data.begin(), data.end());
-    out.Width = v.width();
-    out.Height = v.height();
+    auto format = sniff_format(buf, len);
+
+    try
+    {
+        switch (format)
+        {
+        case ImageFormat::PNG:
+            if (!decode_png(buf, len, out))
+                decode_gil(buf, len, out, png_tag());
+            break;
+        case ImageFormat::JPEG:
+            decode_gil(buf, len, out, jpeg_tag());
+            break;
+        case ImageFormat::BMP:
+            if (!decode_bmp(buf, len, out))
+                decode_gil(buf, len, out, bmp_tag());
+            break;
+        case ImageFormat::TGA:
+        case ImageFormat::Unknown:
+            decode_gil(buf, len, out, targa_tag());
+            break;
+        }
+    }
+    catch (...)
+    {
+        Log::Printf("Could not load image");
+        out.Data.clear();
+        out.Width = out.Height = 0;
+    }
 
     return out;
 }
 
 const char* exts[] = {".png", ".bmp", ".tga", ".jpg", ".jpeg"};
-ImageData ImageLoader::GetDataForImage(std::filesystem::path filename)
+ImageData ImageLoader::GetDataForImage(std::filesystem::path filename, bool Compressible)
 {
 	if (!std::filesystem::exists(filename)) {
 		auto orig_ext = filename.extension().string();
@@ -182,6 +393,14 @@ ImageData ImageLoader::GetDataForImage(std::filesystem::path filename)
 			return {};
 	}
 
+	bool UseCache = Compressible && TextureCache::IsAvailable();
+	if (UseCache)
+	{
+		ImageData cached;
+		if (TextureCache::Fetch(filename, cached))
+			return cached;
+	}
+
 	// this macro warps around windows/linux stuff wrt wide strings
 	CreateBinIfstream(file, filename);
     if (!file.is_open())
@@ -193,9 +412,31 @@ ImageData ImageLoader::GetDataForImage(std::filesystem::path filename)
         return{};
     }
 
-    auto out = open_image(file);
+    file.seekg(0, std::ios::end);
+    auto end = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    std::vector<unsigned char> buf;
+    if (end >= 0)
+    {
+        buf.resize(static_cast<size_t>(end));
+        file.read((char*)buf.data(), buf.size());
+    }
+
+    if (end < 0 || !file)
+    {
+        if (ImageLoaderMessages)
+            Log::Printf("ImageLoader: Unable to read \"%s\".\n", filename.string().c_str());
+
+        return{};
+    }
+
+    auto out = decode_image(buf.data(), buf.size());
     out.Filename = filename;
 
+	if (UseCache)
+		TextureCache::Store(filename, out);
+
 	if (ImageLoaderMessages)
 		Log::LogPrintf("ImageLoader: \"%s\" loaded.\n", filename.string().c_str());
 
@@ -204,16 +445,10 @@ ImageData ImageLoader::GetDataForImage(std::filesystem::path filename)
 
 ImageData ImageLoader::GetDataForImageFromMemory(const unsigned char* const buffer, size_t len)
 {
-    auto file = std::stringstream{ std::stringstream::in |
-        std::stringstream::out | std::stringstream::binary };
-    file.write((const char*)buffer, len);
-
-    auto out = open_image(file);
-
-    return out;
+    return decode_image(buffer, len);
 }
 
-Texture* ImageLoader::Load(std::filesystem::path filename)
+Texture* ImageLoader::Load(std::filesystem::path filename, bool Compressible)
 {
     if (XorTexture) return Renderer::GetXorTexture();
 
@@ -224,7 +459,7 @@ Texture* ImageLoader::Load(std::filesystem::path filename)
     }
     else
     {
-        ImageData ImgData = GetDataForImage(filename);
+        ImageData ImgData = GetDataForImage(filename, Compressible);
         Texture* Ret = InsertImage(filename, ImgData);
 
         Texture::LastBound = Ret;
@@ -234,20 +469,15 @@ Texture* ImageLoader::Load(std::filesystem::path filename)
     return 0;
 }
 
-void ImageLoader::AddToPending(std::filesystem::path Filename)
+void ImageLoader::AddToPending(std::filesystem::path Filename, bool Compressible)
 {
-    UploadData New;
-
     if (XorTexture) return;
 
     if (Textures.find(Filename) == Textures.end())
     {
-        auto d = GetDataForImage(Filename);
-        New.Data = d.Data;
-        New.Width = d.Width;
-        New.Height = d.Height;
+        auto d = GetDataForImage(Filename, Compressible);
         LoadMutex.lock();
-        PendingUploads.insert(std::pair<std::filesystem::path, UploadData>(Filename, New));
+        PendingUploads[Filename] = std::move(d);
         LoadMutex.unlock();
     }
 }
@@ -267,14 +497,7 @@ void ImageLoader::UpdateTextures()
     if (PendingUploads.size() && LoadMutex.try_lock())
     {
         for (auto i = PendingUploads.begin(); i != PendingUploads.end(); i++)
-        {
-            ImageData imgData;
-            imgData.Data = i->second.Data;
-            imgData.Width = i->second.Width;
-            imgData.Height = i->second.Height;
-
-            Texture::LastBound = InsertImage(i->first, imgData);
-        }
+            Texture::LastBound = InsertImage(i->first, i->second);
 
         PendingUploads.clear();
         LoadMutex.unlock();
@@ -6,14 +6,8 @@ class ImageLoader
 {
 private:
 
-    struct UploadData
-    {
-        std::vector<uint32_t> Data;
-        int Width, Height;
-    };
-
     static std::map<std::filesystem::path, Texture*> Textures;
-    static std::map<std::filesystem::path, UploadData> PendingUploads;
+    static std::map<std::filesystem::path, ImageData> PendingUploads;
 
     static Texture*		InsertImage(std::filesystem::path Name, ImageData &imgData);
 public:
@@ -26,15 +20,20 @@ public:
 
     static void   DeleteImage(Texture* &ToDelete);
 
+    /*
+        Compressible images may be served from and stored to the compressed texture cache.
+        Meant for backgrounds and BGA frames, not skin elements.
+    */
+
     /* For multi-threaded loading. */
-    static void   AddToPending(std::filesystem::path Filename);
+    static void   AddToPending(std::filesystem::path Filename, bool Compressible = false);
     static void   LoadFromManifest(const char** Manifest, int Count, std::string Prefix = "");
     static void   UpdateTextures();
-    static ImageData GetDataForImage(std::filesystem::path filename);
+    static ImageData GetDataForImage(std::filesystem::path filename, bool Compressible = false);
     static ImageData GetDataForImageFromMemory(const unsigned char *const buffer, size_t len);
 	static void	  ReloadAll();
 	static void RegisterTexture(Texture* tex);
 
     /* On-the-spot, main thread loading or reloading. */
-    static Texture* Load(std::filesystem::path filename);
+    static Texture* Load(std::filesystem::path filename, bool Compressible = false);
 };
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include "Logging.h"
+#include "Texture.h"
+#include "ImageLoader.h"
+#include "ImageStreamer.h"
+
+ImageStreamer::ImageStreamer(double lookahead, int threads)
+{
+	NextInterval = 0;
+	LastTime = -std::numeric_limits<double>::infinity();
+	Lookahead = lookahead;
+	Sorted = true;
+	Stop = false;
+
+	for (int i = 0; i < std::max(threads, 1); i++)
+		Workers.push_back(std::thread(&ImageStreamer::Worker, this));
+}
+
+ImageStreamer::~ImageStreamer()
+{
+	QueueMutex.lock();
+	Stop = true;
+	QueueMutex.unlock();
+	QueueCondition.notify_all();
+
+	for (auto &t : Workers)
+		t.join();
+
+	for (auto &img : Images)
+		delete img.second.Tex;
+}
+
+void ImageStreamer::AddImage(int index, std::filesystem::path filename)
+{
+	StreamedImage img;
+	img.Filename = filename;
+	img.State = IMG_UNLOADED;
+	img.Uses = 0;
+	img.Tex = nullptr;
+
+	Images[index] = img;
+}
+
+void ImageStreamer::AddInterval(int index, double start, double end)
+{
+	Intervals.push_back({ start, end, index });
+	Sorted = false;
+}
+
+void ImageStreamer::Worker()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		QueueCondition.wait(lock, [&]() { return Stop || !Jobs.empty(); });
+
+		if (Stop)
+			return;
+
+		auto job = Jobs.front();
+		Jobs.pop_front();
+		lock.unlock();
+
+		// The texture cache can throw on filesystem errors. Leaving this thread that way would take the game down;
+		// an empty image marks it failed instead.
+		ImageData data;
+		try {
+			data = ImageLoader::GetDataForImage(job.second, true);
+		}
+		catch (std::exception &e) {
+			Log::LogPrintf("ImageStreamer: Unable to load \"%s\": %s\n", job.second.string().c_str(), e.what());
+			data = ImageData();
+		}
+
+		lock.lock();
+		Decoded[job.first] = std::move(data);
+	}
+}
+
+void ImageStreamer::Request(int index)
+{
+	auto img = Images.find(index);
+	if (img == Images.end())
+		return;
+
+	img->second.Uses++;
+	if (img->second.State == IMG_UNLOADED)
+	{
+		img->second.State = IMG_QUEUED;
+
+		QueueMutex.lock();
+		Jobs.push_back(std::make_pair(index, img->second.Filename));
+		QueueMutex.unlock();
+		QueueCondition.notify_one();
+	}
+}
+
+void ImageStreamer::Release(int index)
+{
+	auto img = Images.find(index);
+	if (img == Images.end())
+		return;
+
+	auto &s = img->second;
+	if (--s.Uses > 0)
+		return;
+
+	if (s.State == IMG_RESIDENT)
+	{
+		delete s.Tex;
+		s.Tex = nullptr;
+		s.State = IMG_UNLOADED;
+	}
+	else if (s.State == IMG_QUEUED)
+	{
+		// If a worker already took it, Upload drops the result.
+		std::lock_guard<std::mutex> lock(QueueMutex);
+		auto job = std::find_if(Jobs.begin(), Jobs.end(), [&](const std::pair<int, std::filesystem::path> &j) {
+			return j.first == index;
+		});
+
+		if (job != Jobs.end())
+		{
+			Jobs.erase(job);
+			s.State = IMG_UNLOADED;
+		}
+	}
+}
+
+void ImageStreamer::Prefetch(double time)
+{
+	// Active intervals are a min-heap on their end time.
+	auto ends_later = [](const Interval &a, const Interval &b) {
+		return a.End > b.End;
+	};
+
+	bool rebuild = time < LastTime;
+	if (!Sorted)
+	{
+		std::stable_sort(Intervals.begin(), Intervals.end(), [](const Interval &a, const Interval &b) {
+			return a.Start < b.Start;
+		});
+
+		Sorted = true;
+		rebuild = true;
+	}
+
+	// Seeking backwards: rebuild the active set from scratch, but only release
+	// the old one after requesting the new one so shared images stay resident.
+	std::vector<Interval> old;
+	if (rebuild)
+	{
+		old.swap(Active);
+		NextInterval = 0;
+	}
+
+	LastTime = time;
+
+	while (NextInterval < Intervals.size() && Intervals[NextInterval].Start <= time + Lookahead)
+	{
+		auto &iv = Intervals[NextInterval++];
+		if (iv.End < time)
+			continue;
+
+		Active.push_back(iv);
+		std::push_heap(Active.begin(), Active.end(), ends_later);
+		Request(iv.Index);
+	}
+
+	for (auto &iv : old)
+		Release(iv.Index);
+
+	while (Active.size() && Active.front().End < time)
+	{
+		auto index = Active.front().Index;
+		std::pop_heap(Active.begin(), Active.end(), ends_later);
+		Active.pop_back();
+		Release(index);
+	}
+}
+
+void ImageStreamer::Upload()
+{
+	std::map<int, ImageData> ready;
+
+	QueueMutex.lock();
+	ready.swap(Decoded);
+	QueueMutex.unlock();
+
+	for (auto &d : ready)
+	{
+		auto &s = Images[d.first];
+
+		if (!d.second.Data.size() && !d.second.CompressedData.size())
+		{
+			s.State = IMG_FAILED;
+			continue;
+		}
+
+		if (s.Uses == 0)
+		{
+			s.State = IMG_UNLOADED;
+			continue;
+		}
+
+		s.State = IMG_RESIDENT;
+		s.Tex = new Texture();
+		s.Tex->SetTextureData2D(d.second);
+	}
+}
+
+void ImageStreamer::Update(double time)
+{
+	Prefetch(time);
+	Upload();
+}
+
+bool ImageStreamer::HasFailed(int index) const
+{
+	auto img = Images.find(index);
+	return img != Images.end() && img->second.State == IMG_FAILED;
+}
+
+Texture* ImageStreamer::GetFromIndex(int index)
+{
+	auto img = Images.find(index);
+	if (img == Images.end())
+		return nullptr;
+
+	return img->second.Tex;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Texture.h"
+
+/*
+	Keeps only the images needed around the current time resident.
+	Each image is given the time intervals where it's displayed. As time advances,
+	images whose interval begins within the look-ahead window are decoded on worker threads
+	and uploaded on the main thread, and images with no pending intervals are released.
+	Meant for BGA frames, so images may come from the compressed texture cache.
+*/
+class ImageStreamer
+{
+	struct Interval
+	{
+		double Start, End;
+		int Index;
+	};
+
+	enum EImageState
+	{
+		IMG_UNLOADED,
+		IMG_QUEUED,
+		IMG_RESIDENT,
+		IMG_FAILED // Couldn't be decoded. Kept through releases so it isn't tried again.
+	};
+
+	struct StreamedImage
+	{
+		std::filesystem::path Filename;
+		EImageState State;
+		int Uses;
+		Texture* Tex;
+	};
+
+	std::map<int, StreamedImage> Images;
+	std::vector<Interval> Intervals;
+
+	// Intervals admitted into the window, by end time.
+	std::vector<Interval> Active;
+
+	size_t NextInterval;
+	double LastTime;
+	double Lookahead;
+	bool Sorted;
+
+	// Shared with the workers.
+	std::mutex QueueMutex;
+	std::condition_variable QueueCondition;
+	std::deque<std::pair<int, std::filesystem::path>> Jobs;
+	std::map<int, ImageData> Decoded;
+	std::vector<std::thread> Workers;
+	bool Stop;
+
+	void Worker();
+	void Request(int index);
+	void Release(int index);
+
+public:
+	ImageStreamer(double lookahead, int threads);
+	~ImageStreamer();
+
+	void AddImage(int index, std::filesystem::path filename);
+
+	// The image at index is displayed between start and end.
+	void AddInterval(int index, double start, double end);
+
+	// Request images needed for [time, time + lookahead] and release the ones past use. Thread safe
+	// as long as it's not called concurrently with itself or Upload.
+	void Prefetch(double time);
+
+	// Turn decoded images into textures. Main thread only.
+	void Upload();
+
+	// Prefetch and Upload.
+	void Update(double time);
+
+	// Whether the image at index couldn't be loaded. It won't be tried again.
+	bool HasFailed(int index) const;
+
+	// nullptr if not resident (yet).
+	Texture* GetFromIndex(int index);
+};
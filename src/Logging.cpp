@@ -3,12 +3,246 @@
 #include "Logging.h"
 
 using std::wcout;
-static std::fstream logfile ("log.txt", std::ios::out);
+
+/*
+	Callers format their message straight into a slot of a fixed-size ring and go on;
+	a single thread writes them out in order, in batches. Claiming a slot is a compare-and-swap,
+	so the render, loading and scanning threads never wait on the disk or on each other.
+	Only if the writer falls a whole ring behind do callers wait for it to catch up,
+	rather than lose messages, or with FLUSH_EVERY, where each caller waits for its own message.
+*/
+namespace
+{
+	const size_t LogMessageSize = 2048;
+	const size_t LogQueueSize = 1024; // Must be a power of two.
+
+	// Set once the sink is destroyed at exit. Anything logged after that is printed right away.
+	std::atomic<bool> SinkGone(false);
+
+	enum ELogTarget
+	{
+		TARGET_CONSOLE = 1,
+		TARGET_FILE = 2
+	};
+
+	struct LogMessage
+	{
+		std::atomic<size_t> Sequence;
+		int Targets;
+		Log::ELogLevel Level;
+		char Text[LogMessageSize];
+	};
+
+	class LogSink
+	{
+		LogMessage Queue[LogQueueSize];
+		std::atomic<size_t> EnqueuePos;
+		size_t DequeuePos; // Only the writer thread touches this.
+
+		std::atomic<size_t> Written;
+		std::atomic<bool> Running;
+
+		std::fstream LogFile;
+		std::thread Writer;
+		std::mutex WakeMutex;
+		std::condition_variable Wake, Drained;
+
+		void Output(const LogMessage &Msg)
+		{
+			const char* Tag = "";
+			if (Msg.Level == Log::LOG_WARNING) Tag = "Warning: ";
+			if (Msg.Level == Log::LOG_ERROR) Tag = "Error: ";
+
+			if (Msg.Targets & TARGET_CONSOLE)
+				wprintf(L"%hs%hs", Tag, Msg.Text);
+
+			if (Msg.Targets & TARGET_FILE)
+			{
+				LogFile << Tag << Msg.Text;
+				if (FlushPolicy == Log::FLUSH_EVERY)
+					LogFile.flush();
+			}
+		}
+
+		// Write out everything that's been published. Returns whether there was anything.
+		bool Drain()
+		{
+			bool Any = false;
+
+			for (;;)
+			{
+				auto &Msg = Queue[DequeuePos & (LogQueueSize - 1)];
+				if (Msg.Sequence.load(std::memory_order_acquire) != DequeuePos + 1)
+					break;
+
+				Output(Msg);
+				Msg.Sequence.store(DequeuePos + LogQueueSize, std::memory_order_release);
+				DequeuePos++;
+				Any = true;
+			}
+
+			if (Any && FlushPolicy != Log::FLUSH_EXIT)
+				LogFile.flush();
+
+			return Any;
+		}
+
+		void Run()
+		{
+			while (Running)
+			{
+				if (!Drain())
+				{
+					std::unique_lock<std::mutex> lock(WakeMutex);
+					Wake.wait_for(lock, std::chrono::milliseconds(10));
+				}
+
+				Written = DequeuePos;
+				Drained.notify_all();
+			}
+
+			Drain();
+			LogFile.flush();
+			Written = DequeuePos;
+			Drained.notify_all();
+		}
+
+		// Wait until the writer has gone past Target.
+		void WaitWritten(size_t Target)
+		{
+			std::unique_lock<std::mutex> lock(WakeMutex);
+
+			while (Running && Written < Target)
+			{
+				Wake.notify_one();
+				Drained.wait_for(lock, std::chrono::milliseconds(10));
+			}
+		}
+
+	public:
+		std::atomic<int> Level;
+		std::atomic<int> FlushPolicy;
+
+		LogSink() : EnqueuePos(0), DequeuePos(0), Written(0), Running(true),
+			LogFile("log.txt", std::ios::out), Level(Log::LOG_DEBUG), FlushPolicy(Log::FLUSH_BATCH)
+		{
+			for (size_t i = 0; i < LogQueueSize; i++)
+				Queue[i].Sequence = i;
+
+			Writer = std::thread(&LogSink::Run, this);
+		}
+
+		~LogSink()
+		{
+			SinkGone = true;
+			Running = false;
+			Wake.notify_one();
+			if (Writer.joinable())
+				Writer.join();
+		}
+
+		void Push(int Targets, Log::ELogLevel MsgLevel, const char* Format, va_list vl)
+		{
+			if (MsgLevel < Level)
+				return;
+
+			auto Pos = EnqueuePos.load(std::memory_order_relaxed);
+			LogMessage *Msg;
+
+			for (;;)
+			{
+				Msg = &Queue[Pos & (LogQueueSize - 1)];
+				auto Seq = Msg->Sequence.load(std::memory_order_acquire);
+				auto Diff = intptr_t(Seq) - intptr_t(Pos);
+
+				if (Diff == 0)
+				{
+					if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (Diff < 0)
+				{
+					// Full.
+					Wake.notify_one();
+					std::this_thread::yield();
+					Pos = EnqueuePos.load(std::memory_order_relaxed);
+				}
+				else
+					Pos = EnqueuePos.load(std::memory_order_relaxed);
+			}
+
+			vsnprintf(Msg->Text, LogMessageSize, Format, vl);
+			Msg->Targets = Targets;
+			Msg->Level = MsgLevel;
+			Msg->Sequence.store(Pos + 1, std::memory_order_release);
+
+			// A message still in the ring is lost if the process dies, so this one has to be on disk before going on.
+			if (FlushPolicy == Log::FLUSH_EVERY)
+				WaitWritten(Pos + 1);
+			// Don't let a burst sit until the writer's next timeout.
+			else if ((Pos & (LogQueueSize / 4 - 1)) == 0)
+				Wake.notify_one();
+		}
+
+		void Flush()
+		{
+			WaitWritten(EnqueuePos.load());
+		}
+
+		/*
+			For a crash, so it takes no locks and waits on nothing that may never come: the writer may be the thread
+			that crashed, another thread may have died holding WakeMutex or between claiming a slot and publishing it.
+			The writer gets a moment to catch up; if it doesn't, whatever's published past it is written from here.
+		*/
+		void FlushAfterCrash()
+		{
+			auto Target = EnqueuePos.load();
+			auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+
+			while (Written < Target && std::chrono::steady_clock::now() < Deadline)
+				std::this_thread::yield();
+
+			if (Written >= Target)
+				return;
+
+			for (size_t Pos = Written; Pos < Target; Pos++)
+			{
+				auto &Msg = Queue[Pos & (LogQueueSize - 1)];
+				if (Msg.Sequence.load(std::memory_order_acquire) == Pos + 1)
+					Output(Msg);
+			}
+
+			LogFile.flush();
+		}
+	};
+
+	LogSink& GetSink()
+	{
+		static LogSink Sink;
+		return Sink;
+	}
+
+	void Enqueue(int Targets, Log::ELogLevel Level, const char* Format, va_list vl)
+	{
+		if (!SinkGone)
+		{
+			GetSink().Push(Targets, Level, Format, vl);
+			return;
+		}
+
+		char Buffer[LogMessageSize];
+		vsnprintf(Buffer, LogMessageSize, Format, vl);
+		wprintf(L"%hs", Buffer);
+	}
+}
 
 #ifndef NDEBUG
 void Log::DebugPrintf(std::string Format, ...)
 {
-    LogPrintf(Format);
+    va_list vl;
+    va_start(vl, Format);
+    Enqueue(TARGET_CONSOLE | TARGET_FILE, LOG_DEBUG, Format.c_str(), vl);
+    va_end(vl);
 }
 #else
 void Log::DebugPrintf(std::string Format, ...)
@@ -19,33 +253,53 @@ void Log::DebugPrintf(std::string Format, ...)
 
 void Log::Printf(std::string Format, ...)
 {
-    char Buffer[2048];
     va_list vl;
     va_start(vl, Format);
-    vsnprintf(Buffer, 2048, Format.c_str(), vl);
+    Enqueue(TARGET_CONSOLE, LOG_INFO, Format.c_str(), vl);
     va_end(vl);
-	wprintf(L"%hs", Buffer);
 }
 
 void Log::Logf(std::string Format, ...)
 {
-    char Buffer[2048];
     va_list vl;
     va_start(vl, Format);
-    vsnprintf(Buffer, 2048, Format.c_str(), vl);
+    Enqueue(TARGET_FILE, LOG_INFO, Format.c_str(), vl);
     va_end(vl);
-    logfile << Buffer;
-    logfile.flush();
 }
 
 void Log::LogPrintf(std::string str, ...)
 {
-    char Buffer[2048];
     va_list vl;
     va_start(vl, str);
-    vsnprintf(Buffer, 2048, str.c_str(), vl);
+    Enqueue(TARGET_CONSOLE | TARGET_FILE, LOG_INFO, str.c_str(), vl);
     va_end(vl);
-	wprintf(L"%hs", Buffer);
-    logfile << Buffer;
-	logfile.flush();
-}
\ No newline at end of file
+}
+
+void Log::Writef(ELogLevel Level, std::string Format, ...)
+{
+    va_list vl;
+    va_start(vl, Format);
+    Enqueue(TARGET_CONSOLE | TARGET_FILE, Level, Format.c_str(), vl);
+    va_end(vl);
+}
+
+void Log::SetLevel(ELogLevel Level)
+{
+    GetSink().Level = Level;
+}
+
+void Log::SetFlushPolicy(EFlushPolicy Policy)
+{
+    GetSink().FlushPolicy = Policy;
+}
+
+void Log::Flush()
+{
+    GetSink().Flush();
+}
+
+void Log::FlushAfterCrash()
+{
+    if (!SinkGone)
+        GetSink().FlushAfterCrash();
+}
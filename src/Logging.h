@@ -2,9 +2,37 @@
 
 namespace Log
 {
+    enum ELogLevel
+    {
+        LOG_DEBUG,
+        LOG_INFO,
+        LOG_WARNING,
+        LOG_ERROR
+    };
+
+    // When log.txt gets flushed. Writing always happens on the logging thread.
+    enum EFlushPolicy
+    {
+        FLUSH_BATCH, // After writing whatever was queued.
+        FLUSH_EVERY, // After every message, with the caller waiting until it's written.
+        FLUSH_EXIT   // Only once logging shuts down.
+    };
+
     void DebugPrintf(std::string Format, ...);
 
     void Printf(std::string Format, ...);
     void Logf(std::string Format, ...);
     void LogPrintf(std::string str, ...);
-};
\ No newline at end of file
+
+    // Like LogPrintf, dropped if below the level set with SetLevel. Warnings and errors are tagged as such.
+    void Writef(ELogLevel Level, std::string Format, ...);
+
+    void SetLevel(ELogLevel Level);
+    void SetFlushPolicy(EFlushPolicy Policy);
+
+    // Wait until everything logged so far is written out and flushed.
+    void Flush();
+
+    // Like Flush, for a crash handler: takes no locks and gives up waiting on the writer after a moment.
+    void FlushAfterCrash();
+};
@@ -19,6 +19,7 @@
 #include "Logging.h"
 
 #include "Shader.h"
+#include "Easing.h"
 
 namespace LuaAnimFuncs
 {
@@ -270,9 +271,22 @@ void DefineSpriteInterface(LuaManager* anim_lua)
 	AddRDLuaGlobal(anim_lua);
 
     // Animation constants
-    anim_lua->SetGlobal("EaseNone", Animation::EaseLinear);
-    anim_lua->SetGlobal("EaseIn", Animation::EaseIn);
-    anim_lua->SetGlobal("EaseOut", Animation::EaseOut);
+    anim_lua->SetGlobal("EaseNone", EASE_LINEAR);
+    anim_lua->SetGlobal("EaseIn", LuaEaseIn);
+    anim_lua->SetGlobal("EaseOut", LuaEaseOut);
+    anim_lua->SetGlobal("EaseInOut", EASE_QUAD_INOUT);
+    anim_lua->SetGlobal("EaseCubicIn", EASE_CUBIC_IN);
+    anim_lua->SetGlobal("EaseCubicOut", EASE_CUBIC_OUT);
+    anim_lua->SetGlobal("EaseCubicInOut", EASE_CUBIC_INOUT);
+    anim_lua->SetGlobal("EaseSineIn", EASE_SINE_IN);
+    anim_lua->SetGlobal("EaseSineOut", EASE_SINE_OUT);
+    anim_lua->SetGlobal("EaseSineInOut", EASE_SINE_INOUT);
+    anim_lua->SetGlobal("EaseExpoIn", EASE_EXPO_IN);
+    anim_lua->SetGlobal("EaseExpoOut", EASE_EXPO_OUT);
+    anim_lua->SetGlobal("EaseElasticOut", EASE_ELASTIC_OUT);
+    anim_lua->SetGlobal("EaseBackIn", EASE_BACK_IN);
+    anim_lua->SetGlobal("EaseBackOut", EASE_BACK_OUT);
+    anim_lua->SetGlobal("EaseBounceOut", EASE_BOUNCE_OUT);
 
     anim_lua->SetGlobal("BlendAdd", (int)BLEND_ADD);
     anim_lua->SetGlobal("BlendAlpha", (int)BLEND_ALPHA);
@@ -377,6 +391,8 @@ void CreateNewLuaAnimInterface(LuaManager *AnimLua)
     luabridge::getGlobalNamespace(AnimLua->GetState())
         .beginClass <SceneEnvironment>("GraphObjMan")
         .addFunction("AddAnimation", &SceneEnvironment::AddLuaAnimation)
+        .addFunction("AddTween", &SceneEnvironment::AddTween)
+        .addFunction("AddTweenTo", &SceneEnvironment::AddTweenTo)
         .addFunction("AddTarget", &SceneEnvironment::AddTarget)
         .addFunction("Sort", &SceneEnvironment::Sort)
         .addFunction("StopAnimation", &SceneEnvironment::StopAnimationsForTarget)
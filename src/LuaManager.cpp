@@ -34,6 +34,7 @@ int DoGameScript(lua_State *S)
 
 LuaManager::LuaManager()
 {
+	mGeneration = 1;
     State = luaL_newstate();
     if (State)
     {
@@ -78,6 +79,7 @@ bool LuaManager::RunScript(std::filesystem::path file)
         return false;
 
     Log::LogPrintf("LuaManager: Running script %s.\n", Utility::ToU8(file.wstring()).c_str());
+	InvalidateFunctions();
 
 
 	if ((errload = luaL_loadfile(State, Utility::ToLocaleStr(file.wstring()).c_str()))) {
@@ -103,6 +105,7 @@ bool LuaManager::RunString(std::string string)
 {
     int errload = 0, errcall = 0;
 
+	InvalidateFunctions();
     if ((errload = luaL_loadstring(State, string.c_str())) || (errcall = lua_pcall(State, 0, LUA_MULTRET, 0)))
     {
         std::string reason = lua_tostring(State, -1);
@@ -114,6 +117,7 @@ bool LuaManager::RunString(std::string string)
 
 bool LuaManager::Require(std::filesystem::path Filename)
 {
+	InvalidateFunctions();
 	lua_pushcfunction(State, LuaPanic);
     lua_getglobal(State, "require");
     lua_pushstring(State, Utility::ToLocaleStr(Filename.wstring()).c_str());
@@ -146,6 +150,7 @@ bool LuaManager::Register(lua_CFunction Function, std::string FunctionName)
     if (!Function || FunctionName.empty())
         return false;
     lua_register(State, FunctionName.c_str(), Function);
+	InvalidateFunctions();
     return true;
 }
 
@@ -196,12 +201,14 @@ double LuaManager::GetGlobalD(std::string VariableName, double Default)
 
 void LuaManager::SetGlobal(const std::string &VariableName, const std::string &Value)
 {
+	InvalidateFunctions();
     lua_pushstring(State, Value.c_str());
     lua_setglobal(State, VariableName.c_str());
 }
 
 void LuaManager::SetGlobal(const std::string &VariableName, const double &Value)
 {
+	InvalidateFunctions();
     lua_pushnumber(State, Value);
     lua_setglobal(State, VariableName.c_str());
 }
@@ -431,6 +438,41 @@ bool LuaManager::CallFunction(const char* Name, int Arguments, int Results)
     return IsFunc;
 }
 
+bool LuaManager::CallFunction(LuaFunction &Func, int Arguments, int Results)
+{
+	if (Func.State != State || Func.Generation != mGeneration)
+	{
+		if (Func.State == State)
+			luaL_unref(State, LUA_REGISTRYINDEX, Func.Ref);
+
+		lua_getglobal(State, Func.Name.c_str());
+		if (lua_isfunction(State, -1))
+			Func.Ref = luaL_ref(State, LUA_REGISTRYINDEX);
+		else
+		{
+			Pop();
+			Func.Ref = LUA_NOREF;
+		}
+
+		Func.State = State;
+		Func.Generation = mGeneration;
+	}
+
+	if (Func.Ref == LUA_NOREF)
+		return false;
+
+	func_args = Arguments;
+	func_results = Results;
+	lua_rawgeti(State, LUA_REGISTRYINDEX, Func.Ref);
+	func_input = true;
+	return true;
+}
+
+void LuaManager::InvalidateFunctions()
+{
+	mGeneration++;
+}
+
 bool LuaManager::RunFunction()
 {
     if (!func_input)
@@ -2,6 +2,23 @@
 
 int LuaPanic(lua_State* State);
 
+/*
+	A global function looked up by name once and kept in the registry,
+	so calling it through LuaManager::CallFunction skips the lookup.
+	It's looked up again after a script runs or a global is set from here, since those may redefine it.
+*/
+class LuaFunction
+{
+	friend class LuaManager;
+
+	std::string Name;
+	lua_State* State;
+	int Ref;
+	uint32_t Generation;
+public:
+	LuaFunction(std::string name) : Name(name), State(nullptr), Ref(LUA_NOREF), Generation(0) {}
+};
+
 class LuaManager
 {
     lua_State* State;
@@ -10,6 +27,9 @@ class LuaManager
     int func_args, func_results; bool func_input; bool func_err;
 	std::string last_error;
 
+	// Bumped whenever globals may have been redefined, see LuaFunction.
+	uint32_t mGeneration;
+
 public:
 
     LuaManager();
@@ -50,6 +70,10 @@ public:
 	void PushArgument(bool Value);
 
     bool CallFunction(const char* Name, int Arguments = 0, int Results = 0);
+    bool CallFunction(LuaFunction &Func, int Arguments = 0, int Results = 0);
+
+    // Have every LuaFunction look its function up again.
+    void InvalidateFunctions();
     bool RunFunction();
 
     int GetFunctionResult(int StackPos = 1);
@@ -0,0 +1,73 @@
+#include "pch.h"
+
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : mData(nullptr), mSize(0)
+{
+}
+
+bool MappedFile::Open(std::filesystem::path path)
+{
+#ifdef _WIN32
+	mFile = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(mFile, &size);
+	mSize = size.QuadPart;
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mMapping) {
+		CloseHandle(mFile);
+		return false;
+	}
+
+	mData = (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mData) {
+		CloseHandle(mMapping);
+		CloseHandle(mFile);
+		return false;
+	}
+#else
+	int fd = open(path.string().c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	mSize = st.st_size;
+	auto data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	mData = (const char*)data;
+#endif
+	return true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (!mData)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mData);
+	CloseHandle(mMapping);
+	CloseHandle(mFile);
+#else
+	munmap((void*)mData, mSize);
+#endif
+}
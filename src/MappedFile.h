@@ -0,0 +1,22 @@
+#pragma once
+
+// Read-only view of a whole file. Empty files can't be mapped, so Open fails on those.
+class MappedFile
+{
+	const char* mData;
+	size_t mSize;
+#ifdef _WIN32
+	HANDLE mFile, mMapping;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(std::filesystem::path path);
+
+	const char* GetData() const { return mData; }
+	size_t GetSize() const { return mSize; }
+};
@@ -865,7 +865,7 @@ public:
 							throw OsuManiaLoaderException("Not an osu!mania chart.");
 
 					if (ReadingModeOld == REvents)
-						Diff->Data->osbSprites = std::make_shared<osb::SpriteList>(ReadOSBEvents(EventsContent));
+						Diff->Data->osbSprites = std::make_shared<osb::SpriteList>(LoadOSBEvents(EventsContent.str()));
 
 					ReadingModeOld = ReadingMode;
 					continue;
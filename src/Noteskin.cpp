@@ -19,7 +19,16 @@
 
 namespace Game {
 	namespace VSRG {
-		Noteskin::Noteskin(PlayerContext *parent) {
+		Noteskin::Noteskin(PlayerContext *parent) :
+			UpdateFunc("Update"),
+			DrawNormalFunc("DrawNormal"),
+			DrawFakeFunc("DrawFake"),
+			DrawLiftFunc("DrawLift"),
+			DrawMineFunc("DrawMine"),
+			DrawHoldHeadFunc("DrawHoldHead"),
+			DrawHoldTailFunc("DrawHoldTail"),
+			DrawHoldBodyFunc("DrawHoldBody")
+		{
 			CanRender = false;
 			NoteScreenSize = 0;
 			DecreaseHoldSizeWhenBeingHit = true;
@@ -87,7 +96,7 @@ namespace Game {
 
 		void Noteskin::Update(float Delta, float CurrentBeat)
 		{
-			if (NoteskinLua.CallFunction("Update", 2))
+			if (NoteskinLua.CallFunction(UpdateFunc, 2))
 			{
 				NoteskinLua.PushArgument(Delta);
 				NoteskinLua.PushArgument(CurrentBeat);
@@ -97,23 +106,23 @@ namespace Game {
 
 		void Noteskin::DrawNote(TrackNote& T, int Lane, float Location)
 		{
-			const char* CallFunc = nullptr;
+			LuaFunction* CallFunc = nullptr;
 
 			switch (T.GetDataNoteKind())
 			{
 			case VSRG::ENoteKind::NK_NORMAL:
-				CallFunc = "DrawNormal";
+				CallFunc = &DrawNormalFunc;
 				break;
 			case VSRG::ENoteKind::NK_FAKE:
-				CallFunc = "DrawFake";
+				CallFunc = &DrawFakeFunc;
 				break;
 			case VSRG::ENoteKind::NK_INVISIBLE:
 				return; // Undrawable
 			case VSRG::ENoteKind::NK_LIFT:
-				CallFunc = "DrawLift";
+				CallFunc = &DrawLiftFunc;
 				break;
 			case VSRG::ENoteKind::NK_MINE:
-				CallFunc = "DrawMine";
+				CallFunc = &DrawMineFunc;
 				break;
 			case VSRG::ENoteKind::NK_ROLL:
 				return; // Unimplemented
@@ -123,7 +132,7 @@ namespace Game {
 			// We didn't get a name to call. Odd.
 
 			CanRender = true;
-			if (NoteskinLua.CallFunction(CallFunc, 4))
+			if (NoteskinLua.CallFunction(*CallFunc, 4))
 			{
 				NoteskinLua.PushArgument(Lane);
 				NoteskinLua.PushArgument(Location);
@@ -161,8 +170,8 @@ namespace Game {
 
 		void Noteskin::DrawHoldHead(TrackNote &T, int Lane, float Location, int ActiveLevel)
 		{
-			if (!NoteskinLua.CallFunction("DrawHoldHead", 4))
-				if (!NoteskinLua.CallFunction("DrawNormal", 4))
+			if (!NoteskinLua.CallFunction(DrawHoldHeadFunc, 4))
+				if (!NoteskinLua.CallFunction(DrawNormalFunc, 4))
 					return;
 
 			CanRender = true;
@@ -177,8 +186,8 @@ namespace Game {
 		void Noteskin::DrawHoldTail(TrackNote& T, int Lane, float Location, int ActiveLevel)
 		{
 
-			if (!NoteskinLua.CallFunction("DrawHoldTail", 4))
-				if (!NoteskinLua.CallFunction("DrawNormal", 4))
+			if (!NoteskinLua.CallFunction(DrawHoldTailFunc, 4))
+				if (!NoteskinLua.CallFunction(DrawNormalFunc, 4))
 					return;
 
 			CanRender = true;
@@ -207,7 +216,7 @@ namespace Game {
 
 		void Noteskin::DrawHoldBody(int Lane, float Location, float Size, int ActiveLevel)
 		{
-			if (!NoteskinLua.CallFunction("DrawHoldBody", 4))
+			if (!NoteskinLua.CallFunction(DrawHoldBodyFunc, 4))
 				return;
 
 			CanRender = true;
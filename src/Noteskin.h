@@ -28,6 +28,12 @@ namespace Game {
 			bool CanRender;
 			bool DecreaseHoldSizeWhenBeingHit;
 			PlayerContext* Parent;
+
+			// Called for every note, every frame.
+			LuaFunction UpdateFunc;
+			LuaFunction DrawNormalFunc, DrawFakeFunc, DrawLiftFunc, DrawMineFunc;
+			LuaFunction DrawHoldHeadFunc, DrawHoldTailFunc, DrawHoldBodyFunc;
+
 			void LuaRender(Sprite*);
 
 		public:
@@ -26,6 +26,7 @@ namespace Renderer {
 	void DoQuadDraw();
 	void SetBlendingMode(EBlendMode Mode);
 	void SetTexturedQuadVBO(VBO *TexQuad);
+	void SetCurrentObjectMatrix(glm::mat4 &mat);
 	void DrawTexturedQuad(Texture* ToDraw, const AABB& TextureCrop, const Transformation& QuadTransformation, const EBlendMode &Mode = BLEND_ALPHA, const ColorRGB &InColor = Color::White);
 	void DrawPrimitiveQuad(Transformation &QuadTransformation, const EBlendMode &Mode = BLEND_ALPHA, const ColorRGB &InColor = Color::White);
 
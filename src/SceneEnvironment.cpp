@@ -11,6 +11,7 @@
 
 #include "RaindropRocketInterface.h"
 #include "TruetypeFont.h"
+#include "Easing.h"
 
 void CreateLuaInterface(LuaManager *AnimLua);
 
@@ -156,8 +157,73 @@ bool LuaAnimation(LuaManager* Lua, std::string Func, Sprite* Target, float Frac)
     else return false;
 }
 
+ETweenProperty TweenPropertyFromString(const std::string &Property)
+{
+    if (Property == "X") return TWEEN_X;
+    if (Property == "Y") return TWEEN_Y;
+    if (Property == "ScaleX") return TWEEN_SCALEX;
+    if (Property == "ScaleY") return TWEEN_SCALEY;
+    if (Property == "Rotation") return TWEEN_ROTATION;
+    if (Property == "Width") return TWEEN_WIDTH;
+    if (Property == "Height") return TWEEN_HEIGHT;
+    if (Property == "Alpha") return TWEEN_ALPHA;
+    if (Property == "Red") return TWEEN_RED;
+    if (Property == "Green") return TWEEN_GREEN;
+    if (Property == "Blue") return TWEEN_BLUE;
+    if (Property == "LightenFactor") return TWEEN_LIGHTENFACTOR;
+    return TWEEN_UNKNOWN;
+}
+
+float GetTweenProperty(Sprite* Target, ETweenProperty Property)
+{
+    switch (Property)
+    {
+    case TWEEN_X: return Target->GetPositionX();
+    case TWEEN_Y: return Target->GetPositionY();
+    case TWEEN_SCALEX: return Target->GetScaleX();
+    case TWEEN_SCALEY: return Target->GetScaleY();
+    case TWEEN_ROTATION: return Target->GetRotation();
+    case TWEEN_WIDTH: return Target->GetWidth();
+    case TWEEN_HEIGHT: return Target->GetHeight();
+    case TWEEN_ALPHA: return Target->Alpha;
+    case TWEEN_RED: return Target->Red;
+    case TWEEN_GREEN: return Target->Green;
+    case TWEEN_BLUE: return Target->Blue;
+    case TWEEN_LIGHTENFACTOR: return Target->LightenFactor;
+    default: return 0;
+    }
+}
+
+void SetTweenProperty(Sprite* Target, ETweenProperty Property, float Value)
+{
+    switch (Property)
+    {
+    case TWEEN_X: Target->SetPositionX(Value); break;
+    case TWEEN_Y: Target->SetPositionY(Value); break;
+    case TWEEN_SCALEX: Target->SetScaleX(Value); break;
+    case TWEEN_SCALEY: Target->SetScaleY(Value); break;
+    case TWEEN_ROTATION: Target->SetRotation(Value); break;
+    case TWEEN_WIDTH: Target->SetWidth(Value); break;
+    case TWEEN_HEIGHT: Target->SetHeight(Value); break;
+    case TWEEN_ALPHA: Target->Alpha = Value; break;
+    case TWEEN_RED: Target->Red = Value; break;
+    case TWEEN_GREEN: Target->Green = Value; break;
+    case TWEEN_BLUE: Target->Blue = Value; break;
+    case TWEEN_LIGHTENFACTOR: Target->LightenFactor = Value; break;
+    default: break;
+    }
+}
+
+void SceneEnvironment::StopTweens(Drawable2D* Target)
+{
+    Tweens.erase(std::remove_if(Tweens.begin(), Tweens.end(),
+        [&](const Tween& T) { return T.Target == Target; }), Tweens.end());
+}
+
 void SceneEnvironment::StopAnimationsForTarget(Sprite* Target)
 {
+    StopTweens(Target);
+
     for (auto i = Animations.begin();
     i != Animations.end();
         )
@@ -181,7 +247,7 @@ void SceneEnvironment::RunIntro(float Fraction, float Delta)
         return;
     }
 
-    if (Lua->CallFunction("UpdateIntro", 2))
+    if (Lua->CallFunction(UpdateIntroFunc, 2))
     {
         Lua->PushArgument(Fraction);
         Lua->PushArgument(Delta);
@@ -198,7 +264,7 @@ void SceneEnvironment::RunExit(float Fraction, float Delta)
         return;
     }
 
-    if (Lua->CallFunction("UpdateExit", 2))
+    if (Lua->CallFunction(UpdateExitFunc, 2))
     {
         Lua->PushArgument(Fraction);
         Lua->PushArgument(Delta);
@@ -218,12 +284,21 @@ float SceneEnvironment::GetExitDuration()
     return std::max(Lua->GetGlobalD("ExitDuration"), 0.0);
 }
 
+int EasingFromLua(int Easing)
+{
+    if (Easing == LuaEaseIn)
+        return EASE_IN;
+    if (Easing == LuaEaseOut)
+        return EASE_OUT;
+    return Clamp(Easing, int(EASE_LINEAR), int(EASE_COUNT) - 1);
+}
+
 void SceneEnvironment::AddLuaAnimation(Sprite* Target, const std::string &FuncName,
     int Easing, float Duration, float Delay)
 {
     Animation Anim;
     Anim.Function = bind(LuaAnimation, Lua.get(), FuncName, Target, std::placeholders::_1);
-    Anim.Easing = (Animation::EEaseType)Easing;
+    Anim.Easing = EasingFromLua(Easing);
     Anim.Duration = Duration;
     Anim.Delay = Delay;
     Anim.Target = Target;
@@ -231,7 +306,107 @@ void SceneEnvironment::AddLuaAnimation(Sprite* Target, const std::string &FuncNa
     Animations.push_back(Anim);
 }
 
-SceneEnvironment::SceneEnvironment(const char* ScreenName, bool initUI)
+void SceneEnvironment::AddTween(Sprite* Target, const std::string &Property, float From, float To,
+    float Duration, int Easing, float Delay, const std::string &OnComplete)
+{
+    Tween T;
+    T.Property = TweenPropertyFromString(Property);
+    if (!Target || T.Property == TWEEN_UNKNOWN)
+    {
+        Log::LogPrintf("SceneEnvironment: Can't tween property \"%s\".\n", Property.c_str());
+        return;
+    }
+
+    T.Target = Target;
+    T.From = From;
+    T.To = To;
+    T.FromCurrent = false;
+    T.Time = 0;
+    T.Duration = Duration;
+    T.Delay = Delay;
+    T.Easing = EasingFromLua(Easing);
+    T.OnComplete = OnComplete;
+
+    Tweens.push_back(T);
+}
+
+void SceneEnvironment::AddTweenTo(Sprite* Target, const std::string &Property, float To,
+    float Duration, int Easing, float Delay, const std::string &OnComplete)
+{
+    auto Count = Tweens.size();
+    AddTween(Target, Property, 0, To, Duration, Easing, Delay, OnComplete);
+    if (Tweens.size() != Count)
+        Tweens.back().FromCurrent = true;
+}
+
+void SceneEnvironment::UpdateTweens(double TimeDelta)
+{
+    // Callbacks run once we're done with the list, since they may add or stop tweens.
+    std::vector<std::pair<std::string, Sprite*>> Completed;
+
+    size_t Kept = 0;
+    for (size_t i = 0; i < Tweens.size(); i++)
+    {
+        auto &T = Tweens[i];
+        bool Starting = T.Time == 0;
+
+        if (T.Delay > 0)
+        {
+            T.Delay -= TimeDelta;
+            if (T.Delay >= 0)
+            {
+                if (Kept != i)
+                    Tweens[Kept] = std::move(T);
+                Kept++;
+                continue;
+            }
+
+            T.Time = -T.Delay; // Pretend it started right on time.
+            T.Delay = 0;
+        }
+        else
+            T.Time += TimeDelta;
+
+        if (Starting && T.FromCurrent)
+        {
+            T.From = GetTweenProperty(T.Target, T.Property);
+            T.FromCurrent = false;
+        }
+
+        if (T.Time >= T.Duration)
+        {
+            SetTweenProperty(T.Target, T.Property, T.To);
+            if (T.OnComplete.length())
+                Completed.push_back(std::make_pair(std::move(T.OnComplete), T.Target));
+            continue;
+        }
+
+        float Frac = ApplyEasing(T.Easing, T.Time / T.Duration);
+        SetTweenProperty(T.Target, T.Property, T.From + (T.To - T.From) * Frac);
+
+        if (Kept != i)
+            Tweens[Kept] = std::move(T);
+        Kept++;
+    }
+
+    Tweens.resize(Kept);
+
+    for (auto &C : Completed)
+    {
+        if (Lua->CallFunction(C.first.c_str(), 1))
+        {
+            luabridge::push(Lua->GetState(), C.second);
+            Lua->RunFunction();
+        }
+    }
+}
+
+SceneEnvironment::SceneEnvironment(const char* ScreenName, bool initUI) :
+    UpdateFunc("Update"),
+    UpdateIntroFunc("UpdateIntro"),
+    UpdateExitFunc("UpdateExit"),
+    NextOrder(0),
+    OrderStale(false)
 {
     Animations.reserve(10);
     Lua = std::make_shared<LuaManager>();
@@ -276,8 +451,8 @@ void SceneEnvironment::InitializeUI()
     // Now set up document
     ReloadUI();
 
-    ManagedObjects.push_back(obctx);
-    Objects.push_back(obctx);
+    ManagedObjects.insert(obctx);
+    InsertObject(obctx);
     SetUILayer(0);
 
     RocketContext->LoadMouseCursor("cursor.rml");
@@ -351,27 +526,127 @@ void SceneEnvironment::Preload(std::filesystem::path Filename, std::string Arrna
 
 void SceneEnvironment::Sort()
 {
-    std::stable_sort(Objects.begin(), Objects.end(),
-        [](const Drawable2D *A, const Drawable2D *B)->bool { return A->GetZ() < B->GetZ(); });
+    std::vector<Drawable2D*> Moved;
+
+    for (auto &L : Layers)
+    {
+        auto &Objs = L.second.Objects;
+        size_t Kept = 0;
+
+        for (size_t i = 0; i < Objs.size(); i++)
+        {
+            auto Obj = Objs[i];
+            if (!Obj)
+                continue;
+
+            if (Obj->GetZ() != L.first)
+            {
+                Moved.push_back(Obj);
+                continue;
+            }
+
+            if (Kept != i)
+            {
+                Objs[Kept] = Obj;
+                ObjectSlots[Obj].Index = Kept;
+            }
+
+            Kept++;
+        }
+
+        Objs.resize(Kept);
+    }
+
+    // Objects whose Z changed are merged into their new layer by their old place in the draw order,
+    // which is where a stable sort of the whole list by Z would have put them.
+    auto ByOrder = [&](Drawable2D* A, Drawable2D* B)
+    {
+        return ObjectSlots[A].Order < ObjectSlots[B].Order;
+    };
+
+    std::sort(Moved.begin(), Moved.end(), [&](Drawable2D* A, Drawable2D* B)
+    {
+        return A->GetZ() != B->GetZ() ? A->GetZ() < B->GetZ() : ByOrder(A, B);
+    });
+
+    for (size_t i = 0; i < Moved.size(); )
+    {
+        auto Z = Moved[i]->GetZ();
+        size_t End = i;
+        while (End < Moved.size() && Moved[End]->GetZ() == Z)
+            End++;
+
+        auto &Objs = Layers[Z].Objects;
+        auto Mid = Objs.size();
+        Objs.insert(Objs.end(), Moved.begin() + i, Moved.begin() + End);
+        std::inplace_merge(Objs.begin(), Objs.begin() + Mid, Objs.end(), ByOrder);
+        i = End;
+    }
+
+    // Slots only need rewriting if something moved or was added since the last Sort.
+    bool Renumber = OrderStale || !Moved.empty();
+    uint64_t Order = 0;
+
+    for (auto L = Layers.begin(); L != Layers.end(); )
+    {
+        auto &Objs = L->second.Objects;
+
+        if (Objs.empty())
+        {
+            L = Layers.erase(L);
+            continue;
+        }
+
+        if (Renumber)
+        {
+            for (size_t i = 0; i < Objs.size(); i++)
+                ObjectSlots[Objs[i]] = { L->first, i, Order++ };
+        }
+
+        ++L;
+    }
+
+    if (Renumber)
+    {
+        NextOrder = Order;
+        OrderStale = false;
+    }
+}
+
+std::vector<Drawable2D*> SceneEnvironment::GetDrawOrder() const
+{
+    std::vector<Drawable2D*> Out;
+    for (auto &L : Layers)
+    {
+        for (auto i : L.second.Objects)
+            if (i) Out.push_back(i);
+    }
+
+    return Out;
+}
+
+void SceneEnvironment::InsertObject(Drawable2D *Obj)
+{
+    if (ObjectSlots.count(Obj))
+        return;
+
+    auto &L = Layers[Obj->GetZ()];
+    ObjectSlots[Obj] = { Obj->GetZ(), L.Objects.size(), NextOrder++ };
+    L.Objects.push_back(Obj);
+    OrderStale = true;
 }
 
 Sprite* SceneEnvironment::CreateObject()
 {
     Sprite* Out = new Sprite;
-    ManagedObjects.push_back(Out);
+    ManagedObjects.insert(Out);
     AddTarget(Out, true); // Destroy on reload
     return Out;
 }
 
 bool SceneEnvironment::IsManagedObject(Drawable2D *Obj)
 {
-    for (auto i : ManagedObjects)
-    {
-        if (Obj == i)
-            return true;
-    }
-
-    return false;
+    return ManagedObjects.count(Obj) != 0;
 }
 
 void SceneEnvironment::Initialize(std::filesystem::path Filename, bool RunScript)
@@ -390,12 +665,10 @@ void SceneEnvironment::Initialize(std::filesystem::path Filename, bool RunScript
 
 void SceneEnvironment::AddTarget(Sprite *Targ, bool IsExternal)
 {
-    Objects.push_back(Targ);
+    InsertObject(Targ);
 
     if (IsExternal)
         ExternalObjects.push_back(Targ);
-
-    Sort();
 }
 
 void SceneEnvironment::AddLuaTarget(Sprite *Targ, std::string Varname)
@@ -407,27 +680,16 @@ void SceneEnvironment::AddLuaTarget(Sprite *Targ, std::string Varname)
 
 void SceneEnvironment::StopManagingObject(Drawable2D *Obj)
 {
-    for (auto i = ManagedObjects.begin(); i != ManagedObjects.end(); ++i)
-    {
-        if (Obj == *i)
-        {
-            ManagedObjects.erase(i);
-            return;
-        }
-    }
+    ManagedObjects.erase(Obj);
 }
 
 void SceneEnvironment::RemoveManagedObject(Drawable2D *Obj)
 {
-    for (auto i = ManagedObjects.begin(); i != ManagedObjects.end(); ++i)
+    if (ManagedObjects.erase(Obj))
     {
-        if (*i == Obj)
-        {
-            RemoveTarget(*i);
-            delete *i;
-            ManagedObjects.erase(i);
-            return;
-        }
+        RemoveTarget(Obj);
+        StopTweens(Obj);
+        delete Obj;
     }
 }
 
@@ -464,19 +726,14 @@ void SceneEnvironment::RemoveExternalObjects()
 
 void SceneEnvironment::RemoveTarget(Drawable2D *Targ)
 {
-    for (auto i = Objects.begin(); i != Objects.end(); )
-    {
-        if (*i == Targ)
-        {
-            i = Objects.erase(i);
-            continue;
-        }
-
-        if (i == Objects.end())
-            break;
+    auto Slot = ObjectSlots.find(Targ);
+    if (Slot == ObjectSlots.end())
+        return;
 
-        ++i;
-    }
+    // Sort closes the hole.
+    auto &L = Layers[Slot->second.Layer];
+    L.Objects[Slot->second.Index] = nullptr;
+    ObjectSlots.erase(Slot);
 }
 
 void SceneEnvironment::DrawTargets(double TimeDelta)
@@ -520,21 +777,7 @@ void SceneEnvironment::UpdateTargets(double TimeDelta)
             else continue;
         }
 
-        float frac;
-
-        switch (i->Easing)
-        {
-        case Animation::EaseIn:
-            frac = pow(i->Time / i->Duration, 2);
-            break;
-        case Animation::EaseOut:
-            frac = i->Time / i->Duration;
-            frac = -frac*(frac - 2);
-            break;
-        case Animation::EaseLinear:
-        default:
-            frac = i->Time / i->Duration;
-        }
+        float frac = ApplyEasing(i->Easing, i->Time / i->Duration);
 
         if (!i->Function(frac)) // Says the animation is over?
         {
@@ -546,7 +789,9 @@ void SceneEnvironment::UpdateTargets(double TimeDelta)
         i++;
     }
 
-    if (Lua->CallFunction("Update", 1))
+    UpdateTweens(TimeDelta);
+
+    if (Lua->CallFunction(UpdateFunc, 1))
     {
         Lua->PushArgument(TimeDelta);
         Lua->RunFunction();
@@ -559,6 +804,19 @@ void SceneEnvironment::UpdateTargets(double TimeDelta)
 
         RocketContext->Update();
     }
+
+    Sort();
+    UpdateMatrices();
+}
+
+void SceneEnvironment::UpdateMatrices()
+{
+    // Chained objects bring their chain up to date first; those already are skip right past it.
+    for (auto &L : Layers)
+    {
+        for (auto i : L.second.Objects)
+            if (i) i->GetMatrix();
+    }
 }
 
 void SceneEnvironment::ReloadUI()
@@ -608,23 +866,26 @@ void SceneEnvironment::SetScreenName(std::string sname)
 	mScreenName = sname;
 }
 
-void SceneEnvironment::DrawUntilLayer(uint32_t Layer)
+void SceneEnvironment::DrawLayer(SceneLayer &Layer)
 {
-    for (auto i : Objects)
+    // Index, not iterators: rendering may add to the layer.
+    for (size_t i = 0; i < Layer.Objects.size(); i++)
     {
-        if (i == nullptr) { /* throw an error */ continue; }
-        if (i->GetZ() <= Layer)
-            i->Render();
+        if (Layer.Objects[i])
+            Layer.Objects[i]->Render();
     }
 }
 
+void SceneEnvironment::DrawUntilLayer(uint32_t Layer)
+{
+    for (auto i = Layers.begin(); i != Layers.end() && i->first <= Layer; ++i)
+        DrawLayer(i->second);
+}
+
 void SceneEnvironment::DrawFromLayer(uint32_t Layer)
 {
-    for (auto i = Objects.begin(); i != Objects.end(); ++i)
-    {
-        if ((*i)->GetZ() >= Layer)
-            (*i)->Render();
-    }
+    for (auto i = Layers.lower_bound(Layer); i != Layers.end(); ++i)
+        DrawLayer(i->second);
 }
 
 LuaManager *SceneEnvironment::GetEnv()
@@ -689,7 +950,11 @@ ImageList* SceneEnvironment::GetImageList()
 
 void SceneEnvironment::DoEvent(std::string EventName, int Return)
 {
-    if (Lua->CallFunction(EventName.c_str(), 0, Return))
+    auto Func = EventFuncs.find(EventName);
+    if (Func == EventFuncs.end())
+        Func = EventFuncs.insert(std::make_pair(EventName, LuaFunction(EventName))).first;
+
+    if (Lua->CallFunction(Func->second, 0, Return))
         Lua->RunFunction();
 
     if (Doc)
@@ -1,8 +1,9 @@
 #pragma once
 
+#include "LuaManager.h"
+
 class Drawable2D;
 class Sprite;
-class LuaManager;
 class ImageList;
 class RocketContextObject;
 class TruetypeFont;
@@ -21,12 +22,7 @@ struct Animation
     std::function <bool(float Fraction)> Function;
 
     float Time, Duration, Delay;
-    enum EEaseType
-    {
-        EaseLinear,
-        EaseIn,
-        EaseOut
-    } Easing;
+    int Easing; // An EEasing
 
     Sprite* Target;
 
@@ -38,15 +34,78 @@ struct Animation
     }
 };
 
+// Skins pass easings as numbers. EaseIn and EaseOut were 1 and 2 before easings took the osu! numbering,
+// where those two are the other way round, so they keep their old meaning; the rest are EEasings.
+const int LuaEaseIn = 1;
+const int LuaEaseOut = 2;
+int EasingFromLua(int Easing);
+
+// Sprite properties a tween can drive. Named like their Lua properties.
+enum ETweenProperty
+{
+    TWEEN_X,
+    TWEEN_Y,
+    TWEEN_SCALEX,
+    TWEEN_SCALEY,
+    TWEEN_ROTATION,
+    TWEEN_WIDTH,
+    TWEEN_HEIGHT,
+    TWEEN_ALPHA,
+    TWEEN_RED,
+    TWEEN_GREEN,
+    TWEEN_BLUE,
+    TWEEN_LIGHTENFACTOR,
+    TWEEN_UNKNOWN
+};
+
+// One property of Target going from From to To, evaluated without calling into Lua.
+struct Tween
+{
+    Sprite* Target;
+    ETweenProperty Property;
+    float From, To;
+    bool FromCurrent; // Take From off Target once the delay is over.
+
+    float Time, Duration, Delay;
+    int Easing; // An EEasing
+
+    std::string OnComplete; // Lua function called with Target when done. Empty for none.
+};
+
 class SceneEnvironment
 {
+    // Objects on a layer, in the order they were added.
+    // Removed objects leave a null behind until the next Sort.
+    struct SceneLayer
+    {
+        std::vector<Drawable2D*> Objects;
+    };
+
+    // Where an object is in Layers. Order is its place in the whole draw order as of the
+    // last Sort (or later, for objects added since), which decides where it goes when its Z changes.
+    struct ObjectSlot
+    {
+        uint32_t Layer;
+        size_t Index;
+        uint64_t Order;
+    };
+
     std::shared_ptr<LuaManager> Lua;
+
+    // Called every frame, or by name through DoEvent, so they're looked up once.
+    LuaFunction UpdateFunc, UpdateIntroFunc, UpdateExitFunc;
+    std::map<std::string, LuaFunction> EventFuncs;
+
     std::shared_ptr<ImageList> Images;
-    std::vector<Drawable2D*> Objects;
-    std::vector<Drawable2D*> ManagedObjects;
+    std::map<uint32_t, SceneLayer> Layers;
+    std::unordered_map<Drawable2D*, ObjectSlot> ObjectSlots;
+    uint64_t NextOrder;
+    bool OrderStale;
+    std::unordered_set<Drawable2D*> ManagedObjects;
     std::vector<Drawable2D*> ExternalObjects;
     std::vector<TruetypeFont*> ManagedFonts;
     std::vector <Animation> Animations;
+    std::vector <Tween> Tweens;
     bool mFrameSkip;
     std::string mScreenName;
     std::filesystem::path mInitScript;
@@ -54,6 +113,11 @@ class SceneEnvironment
     Rocket::Core::Context* RocketContext;
     Rocket::Core::ElementDocument *Doc;
     RocketContextObject* obctx;
+
+    void InsertObject(Drawable2D *Obj);
+    void UpdateTweens(double TimeDelta);
+    void StopTweens(Drawable2D *Target);
+    static void DrawLayer(SceneLayer &Layer);
 public:
     SceneEnvironment(const char* ScreenName, bool initGUI = false);
     ~SceneEnvironment();
@@ -82,6 +146,13 @@ public:
     void DoEvent(std::string EventName, int Return = 0);
     void AddLuaAnimation(Sprite* Target, const std::string &FName, int Easing, float Duration, float Delay);
     void StopAnimationsForTarget(Sprite* Target);
+
+    // Property is a Lua property name such as "X" or "Alpha". AddTweenTo starts from wherever
+    // the property is when the delay is over.
+    void AddTween(Sprite* Target, const std::string &Property, float From, float To,
+        float Duration, int Easing, float Delay, const std::string &OnComplete);
+    void AddTweenTo(Sprite* Target, const std::string &Property, float To,
+        float Duration, int Easing, float Delay, const std::string &OnComplete);
     void AddTarget(Sprite *Targ, bool IsExternal = false);
     void AddLuaTarget(Sprite *Targ, std::string Varname);
     void AddLuaTargetArray(Sprite *Targ, std::string Varname, std::string Arrname);
@@ -90,9 +161,16 @@ public:
 
     TruetypeFont* CreateTTF(const char* Dir);
 
+    // Move objects whose Z changed to their new layer, and drop removed ones.
     void Sort();
 
+    // Every object, in the order they're drawn.
+    std::vector<Drawable2D*> GetDrawOrder() const;
+
     void UpdateTargets(double TimeDelta);
+
+    // Rebuild the matrices of every object that changed, in one pass before drawing.
+    void UpdateMatrices();
     void DrawUntilLayer(uint32_t Layer);
     void DrawFromLayer(uint32_t Layer);
 
@@ -309,7 +309,8 @@ namespace Game {
 
 		void ScreenGameplay::OnPlayerHit(ScoreKeeperJudgment judgment, double dt, uint32_t lane, bool hold, bool release, int pn)
 		{
-			
+			BGA->OnHit();
+
 			if (Animations->GetEnv()->CallFunction("HitEvent", 6))
 			{
 				Animations->GetEnv()->PushArgument(judgment);
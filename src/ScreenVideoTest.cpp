@@ -13,7 +13,7 @@ ScreenVideoTest::ScreenVideoTest() : Screen("ScreenVideoTest", false)
 	clock = 0;
 	play.Open("bga.mp4");
 
-	play.StartDecodeThread();
+	play.StartDecoding();
 
 	Running = true;
 	sprite.SetImage(&play);
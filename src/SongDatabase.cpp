@@ -3,6 +3,7 @@
 
 #include "Logging.h"
 
+#include "Fingerprint.h"
 #include "Song7K.h"
 #include "SongDatabase.h"
 
@@ -21,7 +22,8 @@ CREATE TABLE IF NOT EXISTS [songfiledb] (\
   [id] INTEGER PRIMARY KEY, \
   [filename] varchar(260), \
   [lastmodified] INTEGER, \
-  [hash] varchar(64)); \
+  [hash] varchar(64), \
+  [fingerprint] varchar(16)); \
 CREATE TABLE IF NOT EXISTS [diffdb] (\
   [songid] INTEGER CONSTRAINT [sid] REFERENCES [songdb]([id]) ON DELETE CASCADE, \
   [diffid] INTEGER PRIMARY KEY, \
@@ -36,11 +38,32 @@ CREATE TABLE IF NOT EXISTS [diffdb] (\
   [author] VARCHAR(256),\
   [genre] VARCHAR(256),\
   [stagefile] varchar(260));\
+CREATE TABLE IF NOT EXISTS [dirdb] (\
+  [directory] varchar(260) PRIMARY KEY, \
+  [signature] varchar(16), \
+  [songs] TEXT);\
     CREATE INDEX IF NOT EXISTS song_index ON songfiledb(filename);\
 	  CREATE INDEX IF NOT EXISTS diff_index ON diffdb(diffid, songid, fileid);\
 	  CREATE INDEX IF NOT EXISTS songid_index ON songdb(id);\
+	  CREATE INDEX IF NOT EXISTS diff_songid_index ON diffdb(songid);\
   ";
 
+// WAL lets the read connection go on while a scan holds a write transaction open, and makes
+// synchronous=NORMAL safe: a crash can lose the last commits, but never corrupts the cache.
+auto DatabaseConfiguration = "PRAGMA journal_mode=WAL;\
+  PRAGMA synchronous=NORMAL;\
+  PRAGMA cache_size=-16384;\
+  PRAGMA temp_store=MEMORY;";
+
+const int DatabaseBusyTimeout = 5000; // ms
+
+// Kept in user_version; Migrate brings older databases up to it.
+const int DatabaseVersion = 1;
+
+// A batch is committed after this many writes or this long, whichever comes first.
+const int BatchMaxWrites = 4096;
+const auto BatchMaxAge = std::chrono::seconds(1);
+
 auto InsertSongQuery = "INSERT INTO songdb VALUES (NULL,$title,$author,$subtitle,$fn,$bg,$psong,$ptime)";
 
 auto InsertDifficultyQuery = "INSERT INTO diffdb VALUES (\
@@ -51,12 +74,12 @@ auto InsertDifficultyQuery = "INSERT INTO diffdb VALUES (\
 
 auto GetFilenameIDQuery = "SELECT id, lastmodified FROM songfiledb WHERE filename=$fn";
 
-auto InsertFilenameQuery = "INSERT INTO songfiledb VALUES (NULL,$fn,$lmt,$hash)";
+auto InsertFilenameQuery = "INSERT INTO songfiledb (filename, lastmodified, fingerprint) VALUES ($fn,$lmt,$fp)";
 
 auto GetDiffNameQuery = "SELECT name FROM diffdb \
 							 WHERE (diffdb.fileid = (SELECT songfiledb.id FROM songfiledb WHERE filename=?))";
 
-auto GetLMTQuery = "SELECT lastmodified FROM songfiledb WHERE filename=$fn";
+auto GetLMTQuery = "SELECT lastmodified, fingerprint FROM songfiledb WHERE filename=$fn";
 
 auto GetSongInfo = "SELECT songtitle, \
 				   songauthor, songfilename,\
@@ -69,7 +92,19 @@ auto GetDiffInfo = "SELECT diffid, name, objcount,\
 
 auto GetFileInfo = "SELECT filename, lastmodified FROM songfiledb WHERE id=$fid";
 
-auto UpdateLMT = "UPDATE songfiledb SET lastmodified=$lmt, hash=$hash WHERE filename=$fn";
+// Length is the first difficulty's, as GetDifficulty(0) would give. Followed by at most SummaryBatchSize IDs.
+auto GetSongSummariesQuery = "SELECT songdb.id, songtitle, songauthor, COUNT(diffid), MIN(level), MAX(level), MAX(keys),\
+	MAX(CASE WHEN duration > 0 THEN objcount / duration END),\
+	(SELECT duration FROM diffdb AS firstdiff WHERE firstdiff.songid=songdb.id ORDER BY diffid LIMIT 1)\
+	FROM songdb JOIN diffdb ON diffdb.songid = songdb.id WHERE songdb.id IN (";
+
+const size_t SummaryBatchSize = 500;
+
+// A SHA-256 left by an older version is dropped if the contents changed.
+auto UpdateLMT = "UPDATE songfiledb SET lastmodified=$lmt, fingerprint=$fp, \
+	hash=CASE WHEN fingerprint=$fp THEN hash END WHERE filename=$fn";
+
+auto TouchFile = "UPDATE songfiledb SET lastmodified=$lmt WHERE filename=$fn";
 
 auto UpdateDiff = "UPDATE diffdb SET name=$name,objcount=$objcnt,scoreobjectcount=$scoreobjcnt,\
 	duration=$dur,\
@@ -96,6 +131,48 @@ auto GetPreviewOfSong = "SELECT previewsong, previewtime FROM songdb WHERE id=$s
 auto sGetStageFile = "SELECT stagefile FROM diffdb WHERE diffid=$did";
 auto GetGenre = "SELECT genre FROM diffdb WHERE diffid=$did";
 
+auto GetDirSignature = "SELECT signature, songs FROM dirdb WHERE directory=$dir";
+auto SetDirSignature = "INSERT OR REPLACE INTO dirdb VALUES ($dir,$sig,$songs)";
+
+// Everything under a directory sorts between its name followed by the separator and followed by the next character.
+auto GetCachedDirs = "SELECT directory, songs FROM dirdb WHERE directory > $lo AND directory < $hi";
+auto HasCachedDirs = "SELECT 1 FROM dirdb WHERE directory > $lo AND directory < $hi LIMIT 1";
+auto ForgetDirs = "DELETE FROM dirdb WHERE directory = $dir OR (directory > $lo AND directory < $hi)";
+
+auto SnapshotFiles = "SELECT id, filename, lastmodified FROM songfiledb ORDER BY id";
+auto SnapshotSongs = "SELECT id, songtitle, songauthor, songfilename, subtitle, songbackground, previewtime FROM songdb";
+auto SnapshotDiffs = "SELECT songid, diffid, name, duration, isvirtual, keys, level, fileid FROM diffdb ORDER BY diffid";
+auto SnapshotDirs = "SELECT directory, signature, songs FROM dirdb";
+
+// A directory's song IDs are kept as one comma separated column.
+std::string JoinSongIDs(const std::vector<int> &IDs)
+{
+    std::string Out;
+    for (auto ID : IDs)
+        Out += (Out.length() ? "," : "") + std::to_string(ID);
+    return Out;
+}
+
+// The bounds of everything under Dir, for the queries above.
+void GetDirectoryRange(std::filesystem::path Dir, std::string &Low, std::string &High)
+{
+    std::string u8p = Utility::ToU8(std::filesystem::absolute(Dir).wstring());
+    auto Separator = char(std::filesystem::path::preferred_separator);
+
+    Low = u8p + Separator;
+    High = u8p + char(Separator + 1);
+}
+
+std::vector<int> SplitSongIDs(const char* Text)
+{
+    std::vector<int> Out;
+    if (!Text) return Out;
+
+    for (auto &ID : Utility::TokenSplit(Text, ",", true))
+        Out.push_back(atoi(ID.c_str()));
+    return Out;
+}
+
 #define SC(x) \
 {ret=x; if(ret!=SQLITE_OK && ret != SQLITE_DONE) \
 {Log::Printf("sqlite: %ls (code %d)\n",Utility::Widen(sqlite3_errmsg(db)).c_str(), ret); Utility::DebugBreak(); }}
@@ -106,6 +183,10 @@ auto GetGenre = "SELECT genre FROM diffdb WHERE diffid=$did";
 
 SongDatabase::SongDatabase(std::string Database)
 {
+    readDb = nullptr;
+    InBatch = false;
+    BatchWrites = 0;
+
     int ret = sqlite3_open_v2(Database.c_str(), &db, SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
 
     if (ret != SQLITE_OK)
@@ -114,7 +195,10 @@ SongDatabase::SongDatabase(std::string Database)
     {
         char* err; // Do the "create tables" query.
         const char* tail;
+        SC(sqlite3_exec(db, DatabaseConfiguration, NULL, NULL, &err));
         SC(sqlite3_exec(db, DatabaseQuery, NULL, NULL, &err));
+        sqlite3_busy_timeout(db, DatabaseBusyTimeout);
+        Migrate();
 
         // And not just that, also the statements.
         SC(sqlite3_prepare_v2(db, InsertSongQuery, strlen(InsertSongQuery), &st_SngInsertQuery, &tail));
@@ -128,18 +212,44 @@ SongDatabase::SongDatabase(std::string Database)
         SC(sqlite3_prepare_v2(db, UpdateLMT, strlen(UpdateLMT), &st_UpdateLMT, &tail));
         SC(sqlite3_prepare_v2(db, GetDiffIDFileID, strlen(GetDiffIDFileID), &st_GetDiffIDFile, &tail));
         SC(sqlite3_prepare_v2(db, UpdateDiff, strlen(UpdateDiff), &st_DiffUpdateQuery, &tail));
-        SC(sqlite3_prepare_v2(db, GetDiffFilename, strlen(GetDiffFilename), &st_GetDiffFilename, &tail));
         SC(sqlite3_prepare_v2(db, GetSongIDFromFilename, strlen(GetSongIDFromFilename), &st_GetSIDFromFilename, &tail));
         SC(sqlite3_prepare_v2(db, GetLatestSongID, strlen(GetLatestSongID), &st_GetLastSongID, &tail));
-        SC(sqlite3_prepare_v2(db, GetAuthorOfDifficulty, strlen(GetAuthorOfDifficulty), &st_GetDiffAuthor, &tail));
-        SC(sqlite3_prepare_v2(db, GetPreviewOfSong, strlen(GetPreviewOfSong), &st_GetPreviewInfo, &tail));
-        SC(sqlite3_prepare_v2(db, sGetStageFile, strlen(sGetStageFile), &st_GetStageFile, &tail));
-		SC(sqlite3_prepare_v2(db, GetGenre, strlen(GetGenre), &st_GetDiffGenre, &tail));
+        SC(sqlite3_prepare_v2(db, TouchFile, strlen(TouchFile), &st_TouchFile, &tail));
+        SC(sqlite3_prepare_v2(db, GetDirSignature, strlen(GetDirSignature), &st_GetDirSignature, &tail));
+        SC(sqlite3_prepare_v2(db, SetDirSignature, strlen(SetDirSignature), &st_SetDirSignature, &tail));
+        SC(sqlite3_prepare_v2(db, ForgetDirs, strlen(ForgetDirs), &st_ForgetDirs, &tail));
+
+        // Song select's lookups get a connection of their own, so they don't wait on a scan.
+        SC(sqlite3_open_v2(Database.c_str(), &readDb, SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_READONLY, NULL));
+        sqlite3_busy_timeout(readDb, DatabaseBusyTimeout);
+
+        SC(sqlite3_prepare_v2(readDb, GetDiffFilename, strlen(GetDiffFilename), &st_GetDiffFilename, &tail));
+        SC(sqlite3_prepare_v2(readDb, GetAuthorOfDifficulty, strlen(GetAuthorOfDifficulty), &st_GetDiffAuthor, &tail));
+        SC(sqlite3_prepare_v2(readDb, GetPreviewOfSong, strlen(GetPreviewOfSong), &st_GetPreviewInfo, &tail));
+        SC(sqlite3_prepare_v2(readDb, sGetStageFile, strlen(sGetStageFile), &st_GetStageFile, &tail));
+		SC(sqlite3_prepare_v2(readDb, GetGenre, strlen(GetGenre), &st_GetDiffGenre, &tail));
+        SC(sqlite3_prepare_v2(readDb, GetCachedDirs, strlen(GetCachedDirs), &st_GetCachedDirs, &tail));
+        SC(sqlite3_prepare_v2(readDb, HasCachedDirs, strlen(HasCachedDirs), &st_HasCachedDirs, &tail));
     }
 }
 
 SongDatabase::~SongDatabase()
 {
+    if (InBatch)
+        EndTransaction();
+
+    if (readDb)
+    {
+        sqlite3_finalize(st_GetDiffFilename);
+        sqlite3_finalize(st_GetDiffAuthor);
+        sqlite3_finalize(st_GetDiffGenre);
+        sqlite3_finalize(st_GetPreviewInfo);
+        sqlite3_finalize(st_GetStageFile);
+        sqlite3_finalize(st_GetCachedDirs);
+        sqlite3_finalize(st_HasCachedDirs);
+        sqlite3_close(readDb);
+    }
+
     if (db)
     {
         sqlite3_finalize(st_SngInsertQuery);
@@ -152,14 +262,60 @@ SongDatabase::~SongDatabase()
         sqlite3_finalize(st_UpdateLMT);
         sqlite3_finalize(st_GetDiffIDFile);
         sqlite3_finalize(st_DiffUpdateQuery);
-        sqlite3_finalize(st_GetDiffFilename);
         sqlite3_finalize(st_GetSIDFromFilename);
         sqlite3_finalize(st_GetLastSongID);
-        sqlite3_finalize(st_GetDiffAuthor);
+        sqlite3_finalize(st_TouchFile);
+        sqlite3_finalize(st_GetDirSignature);
+        sqlite3_finalize(st_SetDirSignature);
+        sqlite3_finalize(st_ForgetDirs);
         sqlite3_close(db);
     }
 }
 
+void SongDatabase::Migrate()
+{
+    int ret;
+    int Version = 0;
+    sqlite3_stmt *st;
+
+    SC(sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &st, NULL));
+    if (sqlite3_step(st) == SQLITE_ROW)
+        Version = sqlite3_column_int(st, 0);
+    SC(sqlite3_finalize(st));
+
+    if (Version >= DatabaseVersion)
+        return;
+
+    // 1: Files get a fingerprint instead of hash (their SHA-256), which is no longer filled in.
+    // A new database has the column already.
+    if (Version < 1)
+    {
+        bool HasFingerprint = sqlite3_prepare_v2(db, "SELECT fingerprint FROM songfiledb", -1, &st, NULL) == SQLITE_OK;
+        sqlite3_finalize(st);
+
+        if (!HasFingerprint)
+        {
+            Log::Printf("SongDatabase: Adding file fingerprints to the song cache.\n");
+            SC(sqlite3_exec(db, "ALTER TABLE songfiledb ADD COLUMN fingerprint varchar(16);", NULL, NULL, NULL));
+        }
+    }
+
+    auto SetVersion = "PRAGMA user_version=" + std::to_string(DatabaseVersion) + ";";
+    SC(sqlite3_exec(db, SetVersion.c_str(), NULL, NULL, NULL));
+}
+
+// The fingerprint CacheNeedsRenewal already took for this file, or a fresh one.
+std::string SongDatabase::TakeFingerprint(const std::string &u8p, std::filesystem::path Fn)
+{
+    auto Checked = CheckedFingerprints.find(u8p);
+    if (Checked == CheckedFingerprints.end())
+        return Fingerprint::ForFile(Fn);
+
+    auto Fp = std::move(Checked->second);
+    CheckedFingerprints.erase(Checked);
+    return Fp;
+}
+
 // Inserts a filename, if it already exists, updates it.
 // Returns the ID of the filename.
 int SongDatabase::InsertFilename(std::filesystem::path Fn)
@@ -178,18 +334,18 @@ int SongDatabase::InsertFilename(std::filesystem::path Fn)
 
         int lastLmt = Utility::GetLastModifiedTime(Fn);
 
-        // Update the last-modified-time of this file, and its hash if it has changed.
+        // Update the last-modified-time of this file, and its fingerprint if it has changed.
         if (lmt != lastLmt)
         {
-            std::string Hash = Utility::GetSha256ForFile(Fn);
+            std::string Fp = TakeFingerprint(u8p, Fn);
             
 			SC(sqlite3_bind_int(st_UpdateLMT, 
 				sqlite3_bind_parameter_index(st_UpdateLMT, "$lmt"), 
 				lastLmt));
 
             SC(sqlite3_bind_text(st_UpdateLMT, 
-				sqlite3_bind_parameter_index(st_UpdateLMT, "$hash"), 
-				Hash.c_str(), Hash.length(), SQLITE_STATIC));
+				sqlite3_bind_parameter_index(st_UpdateLMT, "$fp"), 
+				Fp.c_str(), Fp.length(), SQLITE_STATIC));
 
             SC(sqlite3_bind_text(st_UpdateLMT, 
 				sqlite3_bind_parameter_index(st_UpdateLMT, "$fn"), 
@@ -201,7 +357,7 @@ int SongDatabase::InsertFilename(std::filesystem::path Fn)
     }
     else
     {
-        std::string Hash = Utility::GetSha256ForFile(Fn);
+        std::string Fp = TakeFingerprint(u8p, Fn);
 
         // There's no entry, got to insert it.
         SC(sqlite3_bind_text(st_FilenameInsertQuery, 
@@ -213,8 +369,8 @@ int SongDatabase::InsertFilename(std::filesystem::path Fn)
 			Utility::GetLastModifiedTime(Fn)));
 
         SC(sqlite3_bind_text(st_FilenameInsertQuery, 
-			sqlite3_bind_parameter_index(st_FilenameInsertQuery, "$hash"), 
-			Hash.c_str(), Hash.length(), SQLITE_STATIC));
+			sqlite3_bind_parameter_index(st_FilenameInsertQuery, "$fp"), 
+			Fp.c_str(), Fp.length(), SQLITE_STATIC));
 
 		// This should not fail. Otherwise, there are bigger problems to worry about...
         SCS(sqlite3_step(st_FilenameInsertQuery)); 
@@ -237,6 +393,7 @@ int SongDatabase::InsertFilename(std::filesystem::path Fn)
 // remove all difficulties associated to this ID
 void SongDatabase::ClearDifficulties(int SongID)
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
     int ret;
     SC(sqlite3_bind_int(st_DelDiffsQuery, 1, SongID));
     SCS(sqlite3_step(st_DelDiffsQuery));
@@ -320,6 +477,14 @@ void SongDatabase::UpdateDiffInternal(int &ret, int DiffID, Game::Song::Difficul
 // Adds a difficulty to the database, or updates it if it already exists.
 void SongDatabase::AddDifficulty(int SongID, std::filesystem::path Filename, Game::Song::Difficulty* Diff)
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    char* tail;
+
+    // Outside a batch, commit this difficulty's few statements at once rather than each on its own.
+    bool OwnTransaction = !InBatch;
+    if (OwnTransaction)
+        sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, &tail);
+
     int FileID = InsertFilename(Filename);
     int DiffID;
     int ret;
@@ -338,10 +503,16 @@ void SongDatabase::AddDifficulty(int SongID, std::filesystem::path Filename, Gam
     }
 
     Diff->ID = DiffID;
+
+    if (OwnTransaction)
+        sqlite3_exec(db, "COMMIT;", NULL, NULL, &tail);
+    else
+        CountBatchWrite();
 }
 
 int SongDatabase::AddSongToDatabase(Game::VSRG::Song * Song)
 {
+	std::unique_lock<std::mutex> lock(WriteMutex);
 	int ret = 0;
 	auto u8sfn = Utility::ToU8(Song->SongFilename.wstring());
 	auto u8bfn = Utility::ToU8(Song->BackgroundFilename.wstring());
@@ -384,6 +555,7 @@ int SongDatabase::AddSongToDatabase(Game::VSRG::Song * Song)
 	int Out = sqlite3_column_int(st_GetLastSongID, 0);
 	sqlite3_reset(st_GetLastSongID);
 
+	CountBatchWrite();
 	return Out;
 }
 
@@ -445,21 +617,29 @@ void SongDatabase::InsertDiffInternal(int &ret, int SongID, int FileID, Game::So
 
 std::filesystem::path SongDatabase::GetDifficultyFilename(int ID)
 {
+	std::unique_lock<std::mutex> lock(ReadMutex);
 	int ret;
+	std::filesystem::path out;
+
 	SC(sqlite3_bind_int(st_GetDiffFilename, 1, ID));
-	SCS(sqlite3_step(st_GetDiffFilename));
 
+	if (StepReader(st_GetDiffFilename))
+	{
 #ifdef _WIN32
-	std::filesystem::path out = Utility::Widen((char*)sqlite3_column_text(st_GetDiffFilename, 0));
+		out = Utility::Widen((char*)sqlite3_column_text(st_GetDiffFilename, 0));
 #else
-	std::filesystem::path out = (char*)sqlite3_column_text(st_GetDiffFilename, 0);
+		out = (char*)sqlite3_column_text(st_GetDiffFilename, 0);
 #endif
+	}
+
 	SC(sqlite3_reset(st_GetDiffFilename));
 	return out;
 }
 
 bool SongDatabase::CacheNeedsRenewal(std::filesystem::path Dir)
 {
+	std::unique_lock<std::mutex> lock(WriteMutex);
+
 	// must match what we put at InsertFilename time, so turn into absolute path on both places!
 	std::string u8p = Utility::ToU8(std::filesystem::absolute(Dir).wstring());
 	int CurLMT = Utility::GetLastModifiedTime(Dir);
@@ -472,11 +652,16 @@ bool SongDatabase::CacheNeedsRenewal(std::filesystem::path Dir)
 
 	res = sqlite3_step(stGetLMTQuery);
 
+	std::string OldFp;
+
 	if (res == SQLITE_ROW) // entry exists
 	{
 		int OldLMT = sqlite3_column_int(stGetLMTQuery, 0);
 		bool IsLMTCurrent = (CurLMT == OldLMT); // file was not modified since last time
 		NeedsRenewal = !IsLMTCurrent;
+
+		auto fp = (const char*)sqlite3_column_text(stGetLMTQuery, 1);
+		if (fp) OldFp = fp;
 	}
 	else
 	{
@@ -484,33 +669,298 @@ bool SongDatabase::CacheNeedsRenewal(std::filesystem::path Dir)
     }
 
     SC(sqlite3_reset(stGetLMTQuery));
+
+    // Touched, copied or unpacked again, but the same contents: keep what we have and remember the new time.
+    std::string Fp;
+    if (NeedsRenewal && OldFp.length())
+        Fp = Fingerprint::ForFile(Dir);
+
+    if (Fp.length() && Fp == OldFp)
+    {
+        SC(sqlite3_bind_int(st_TouchFile,
+            sqlite3_bind_parameter_index(st_TouchFile, "$lmt"),
+            CurLMT));
+
+        SC(sqlite3_bind_text(st_TouchFile,
+            sqlite3_bind_parameter_index(st_TouchFile, "$fn"),
+            u8p.c_str(), u8p.length(), SQLITE_STATIC));
+
+        SCS(sqlite3_step(st_TouchFile));
+        SC(sqlite3_reset(st_TouchFile));
+        CountBatchWrite();
+
+        NeedsRenewal = false;
+    }
+
+    // The contents did change, so InsertFilename is coming for this file.
+    if (NeedsRenewal && Fp.length())
+        CheckedFingerprints[u8p] = Fp;
+
     return NeedsRenewal;
 }
 
+bool SongDatabase::GetDirectorySignature(std::filesystem::path Dir, std::string &Signature, std::vector<int> &SongIDs)
+{
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    int ret;
+    std::string u8p = Utility::ToU8(std::filesystem::absolute(Dir).wstring());
+    bool Found = false;
+
+    SC(sqlite3_bind_text(st_GetDirSignature,
+        sqlite3_bind_parameter_index(st_GetDirSignature, "$dir"),
+        u8p.c_str(), u8p.length(), SQLITE_STATIC));
+
+    if (sqlite3_step(st_GetDirSignature) == SQLITE_ROW)
+    {
+        auto sig = (const char*)sqlite3_column_text(st_GetDirSignature, 0);
+        Signature = sig ? sig : "";
+        SongIDs = SplitSongIDs((const char*)sqlite3_column_text(st_GetDirSignature, 1));
+        Found = true;
+    }
+
+    SC(sqlite3_reset(st_GetDirSignature));
+    return Found;
+}
+
+void SongDatabase::SetDirectorySignature(std::filesystem::path Dir, const std::string &Signature, const std::vector<int> &SongIDs)
+{
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    int ret;
+    std::string u8p = Utility::ToU8(std::filesystem::absolute(Dir).wstring());
+    std::string Songs = JoinSongIDs(SongIDs);
+
+    SC(sqlite3_bind_text(st_SetDirSignature,
+        sqlite3_bind_parameter_index(st_SetDirSignature, "$dir"),
+        u8p.c_str(), u8p.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_SetDirSignature,
+        sqlite3_bind_parameter_index(st_SetDirSignature, "$sig"),
+        Signature.c_str(), Signature.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_SetDirSignature,
+        sqlite3_bind_parameter_index(st_SetDirSignature, "$songs"),
+        Songs.c_str(), Songs.length(), SQLITE_STATIC));
+
+    SCS(sqlite3_step(st_SetDirSignature));
+    SC(sqlite3_reset(st_SetDirSignature));
+    CountBatchWrite();
+}
+
+std::vector<CachedDirectory> SongDatabase::GetCachedDirectories(std::filesystem::path Dir)
+{
+    std::vector<CachedDirectory> Out;
+    std::string Low, High;
+    int ret;
+
+    GetDirectoryRange(Dir, Low, High);
+
+    // Whatever a scan has written so far.
+    FlushBatch();
+
+    std::unique_lock<std::mutex> lock(ReadMutex);
+
+    SC(sqlite3_bind_text(st_GetCachedDirs,
+        sqlite3_bind_parameter_index(st_GetCachedDirs, "$lo"),
+        Low.c_str(), Low.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_GetCachedDirs,
+        sqlite3_bind_parameter_index(st_GetCachedDirs, "$hi"),
+        High.c_str(), High.length(), SQLITE_STATIC));
+
+    while (sqlite3_step(st_GetCachedDirs) == SQLITE_ROW)
+    {
+        CachedDirectory Entry;
+
+        try {
+#ifdef _WIN32
+            Entry.Directory = Utility::Widen((char*)sqlite3_column_text(st_GetCachedDirs, 0));
+#else
+            Entry.Directory = (char*)sqlite3_column_text(st_GetCachedDirs, 0);
+#endif
+        }
+        catch (std::exception &e) {
+            Log::Printf("SongDatabase::GetCachedDirectories: %s\n", e.what());
+            continue;
+        }
+
+        Entry.SongIDs = SplitSongIDs((const char*)sqlite3_column_text(st_GetCachedDirs, 1));
+        Out.push_back(Entry);
+    }
+
+    SC(sqlite3_reset(st_GetCachedDirs));
+    return Out;
+}
+
+bool SongDatabase::HasCachedDirectories(std::filesystem::path Dir)
+{
+    std::string Low, High;
+    int ret;
+
+    GetDirectoryRange(Dir, Low, High);
+
+    std::unique_lock<std::mutex> lock(ReadMutex);
+
+    SC(sqlite3_bind_text(st_HasCachedDirs,
+        sqlite3_bind_parameter_index(st_HasCachedDirs, "$lo"),
+        Low.c_str(), Low.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_HasCachedDirs,
+        sqlite3_bind_parameter_index(st_HasCachedDirs, "$hi"),
+        High.c_str(), High.length(), SQLITE_STATIC));
+
+    bool Found = sqlite3_step(st_HasCachedDirs) == SQLITE_ROW;
+    SC(sqlite3_reset(st_HasCachedDirs));
+    return Found;
+}
+
+std::unordered_map<int, SongSummary> SongDatabase::GetSongSummaries(const std::vector<int> &IDs)
+{
+    std::unordered_map<int, SongSummary> Out;
+    int ret;
+
+    // Whatever a scan has written so far.
+    FlushBatch();
+
+    std::unique_lock<std::mutex> lock(ReadMutex);
+
+    for (size_t First = 0; First < IDs.size(); First += SummaryBatchSize)
+    {
+        std::string IDList;
+        for (size_t i = First; i < std::min(First + SummaryBatchSize, IDs.size()); i++)
+        {
+            if (IDList.length())
+                IDList += ",";
+            IDList += std::to_string(IDs[i]);
+        }
+
+        sqlite3_stmt *st;
+        auto Query = GetSongSummariesQuery + IDList + ") GROUP BY songdb.id";
+        SC(sqlite3_prepare_v2(readDb, Query.c_str(), -1, &st, NULL));
+
+        auto Text = [&](int Column) {
+            auto t = (const char*)sqlite3_column_text(st, Column);
+            return std::string(t ? t : "");
+        };
+
+        while (sqlite3_step(st) == SQLITE_ROW)
+        {
+            SongSummary Summary;
+            Summary.ID = sqlite3_column_int(st, 0);
+            Summary.Title = Text(1);
+            Summary.Author = Text(2);
+            Summary.Difficulties = sqlite3_column_int(st, 3);
+            Summary.MinLevel = sqlite3_column_int(st, 4);
+            Summary.MaxLevel = sqlite3_column_int(st, 5);
+            Summary.Keys = sqlite3_column_int(st, 6);
+            Summary.MaxNPS = sqlite3_column_double(st, 7);
+            Summary.Length = sqlite3_column_double(st, 8);
+            Out[Summary.ID] = Summary;
+        }
+
+        SC(sqlite3_finalize(st));
+    }
+
+    return Out;
+}
+
+void SongDatabase::ForgetDirectory(std::filesystem::path Dir)
+{
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    std::string u8p = Utility::ToU8(std::filesystem::absolute(Dir).wstring());
+    std::string Low, High;
+    int ret;
+
+    GetDirectoryRange(Dir, Low, High);
+
+    SC(sqlite3_bind_text(st_ForgetDirs,
+        sqlite3_bind_parameter_index(st_ForgetDirs, "$dir"),
+        u8p.c_str(), u8p.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_ForgetDirs,
+        sqlite3_bind_parameter_index(st_ForgetDirs, "$lo"),
+        Low.c_str(), Low.length(), SQLITE_STATIC));
+
+    SC(sqlite3_bind_text(st_ForgetDirs,
+        sqlite3_bind_parameter_index(st_ForgetDirs, "$hi"),
+        High.c_str(), High.length(), SQLITE_STATIC));
+
+    SCS(sqlite3_step(st_ForgetDirs));
+    SC(sqlite3_reset(st_ForgetDirs));
+    CountBatchWrite();
+}
+
 void SongDatabase::StartTransaction()
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
     char* tail;
     sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, &tail);
+
+    InBatch = true;
+    BatchWrites = 0;
+    BatchStart = std::chrono::steady_clock::now();
 }
 
 void SongDatabase::EndTransaction()
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
     char* tail;
     sqlite3_exec(db, "COMMIT;", NULL, NULL, &tail);
+
+    InBatch = false;
+    CheckedFingerprints.clear(); // Left by charts that didn't load.
+}
+
+void SongDatabase::CountBatchWrite()
+{
+    if (!InBatch)
+        return;
+
+    BatchWrites++;
+    if (BatchWrites < BatchMaxWrites && std::chrono::steady_clock::now() - BatchStart < BatchMaxAge)
+        return;
+
+    char* tail;
+    sqlite3_exec(db, "COMMIT; BEGIN TRANSACTION;", NULL, NULL, &tail);
+    BatchWrites = 0;
+    BatchStart = std::chrono::steady_clock::now();
+}
+
+bool SongDatabase::FlushBatch()
+{
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    if (!InBatch || !BatchWrites)
+        return false;
+
+    char* tail;
+    sqlite3_exec(db, "COMMIT; BEGIN TRANSACTION;", NULL, NULL, &tail);
+    BatchWrites = 0;
+    BatchStart = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool SongDatabase::StepReader(sqlite3_stmt *st)
+{
+    if (sqlite3_step(st) == SQLITE_ROW)
+        return true;
+
+    if (!FlushBatch())
+        return false;
+
+    // Bindings survive the reset.
+    sqlite3_reset(st);
+    return sqlite3_step(st) == SQLITE_ROW;
 }
 
 std::string SongDatabase::GetArtistForDifficulty(int ID)
 {
-    int rs;
+    std::unique_lock<std::mutex> lock(ReadMutex);
     std::string out;
 
     sqlite3_bind_int(st_GetDiffAuthor, 
 		sqlite3_bind_parameter_index(st_GetDiffAuthor, "$did"),
 		ID);
 
-    rs = sqlite3_step(st_GetDiffAuthor);
-
-    if (rs == SQLITE_ROW)
+    if (StepReader(st_GetDiffAuthor) && sqlite3_column_text(st_GetDiffAuthor, 0))
         out = (char*)sqlite3_column_text(st_GetDiffAuthor, 0);
 
     sqlite3_reset(st_GetDiffAuthor);
@@ -519,13 +969,14 @@ std::string SongDatabase::GetArtistForDifficulty(int ID)
 
 std::string SongDatabase::GetGenreForDifficulty(int DiffID)
 {
+	std::unique_lock<std::mutex> lock(ReadMutex);
 	std::string out;
 
 	sqlite3_bind_int(st_GetDiffGenre, 
 		sqlite3_bind_parameter_index(st_GetDiffGenre, "$did"), 
 		DiffID);
 
-	if (sqlite3_step(st_GetDiffGenre) == SQLITE_ROW)
+	if (StepReader(st_GetDiffGenre) && sqlite3_column_text(st_GetDiffGenre, 0))
 		out = (char*)sqlite3_column_text(st_GetDiffGenre, 0);
 
 	sqlite3_reset(st_GetDiffGenre);
@@ -540,6 +991,7 @@ std::string SongDatabase::GetGenreForDifficulty(int DiffID)
 
 void SongDatabase::GetSongInformation(int ID, Game::VSRG::Song* Out)
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
     int ret;
     
 	SC(sqlite3_bind_int(stGetSongInfo, 
@@ -623,8 +1075,168 @@ void SongDatabase::GetSongInformation(int ID, Game::VSRG::Song* Out)
     SC(sqlite3_reset(stGetDiffInfo));
 }
 
+std::unique_ptr<SongCacheSnapshot> SongDatabase::LoadCacheSnapshot()
+{
+    std::unique_lock<std::mutex> lock(WriteMutex);
+    int ret;
+    auto Out = std::make_unique<SongCacheSnapshot>();
+    std::unordered_map<int, std::string> FileNames; // by file ID
+    sqlite3_stmt *st;
+
+    // Unlike sqlite3_column_text, never null.
+    auto Text = [&](int Column) {
+        auto t = (const char*)sqlite3_column_text(st, Column);
+        return std::string(t ? t : "");
+    };
+
+    SC(sqlite3_prepare_v2(db, SnapshotFiles, -1, &st, NULL));
+    while (sqlite3_step(st) == SQLITE_ROW)
+    {
+        const char* fn = (const char*)sqlite3_column_text(st, 1);
+        if (!fn) continue;
+
+        FileNames[sqlite3_column_int(st, 0)] = fn;
+
+        // Filename lookups take the first row with that name.
+        Out->Files.emplace(fn, SongCacheSnapshot::FileInfo{ sqlite3_column_int(st, 2), -1 });
+    }
+    SC(sqlite3_finalize(st));
+
+    SC(sqlite3_prepare_v2(db, SnapshotSongs, -1, &st, NULL));
+    while (sqlite3_step(st) == SQLITE_ROW)
+    {
+        auto Song = new Game::VSRG::Song;
+
+        try {
+            Song->ID = sqlite3_column_int(st, 0);
+            Song->SongName = Text(1);
+            Song->SongAuthor = Text(2);
+            Song->SongFilename = _W(Text(3).c_str());
+            Song->Subtitle = Text(4);
+            Song->BackgroundFilename = _W(Text(5).c_str());
+            Song->PreviewTime = sqlite3_column_double(st, 6);
+        }
+        catch (std::exception &e) {
+            // This one is left to GetSongInformation.
+            Log::Printf("SongDatabase::LoadCacheSnapshot: Song %d: %s\n", Song->ID, e.what());
+            delete Song;
+            continue;
+        }
+
+        Out->Songs[Song->ID] = Song;
+    }
+    SC(sqlite3_finalize(st));
+
+    // Difficulties go in the same order GetSongInformation reads them.
+    SC(sqlite3_prepare_v2(db, SnapshotDiffs, -1, &st, NULL));
+    while (sqlite3_step(st) == SQLITE_ROW)
+    {
+        int SongID = sqlite3_column_int(st, 0);
+        int FileID = sqlite3_column_int(st, 7);
+        auto Filename = FileNames.find(FileID);
+        if (Filename == FileNames.end())
+            continue;
+
+        auto File = Out->Files.find(Filename->second);
+        if (File != Out->Files.end() && File->second.SongID == -1)
+            File->second.SongID = SongID;
+
+        auto Song = Out->Songs.find(SongID);
+        if (Song == Out->Songs.end())
+            continue;
+
+        auto Diff = std::make_shared<Game::VSRG::Difficulty>();
+        Diff->ID = sqlite3_column_int(st, 1);
+        Diff->Name = Text(2);
+        Diff->Duration = sqlite3_column_double(st, 3);
+        Diff->IsVirtual = (sqlite3_column_int(st, 4) == 1);
+        Diff->Channels = sqlite3_column_int(st, 5);
+        Diff->Level = sqlite3_column_int(st, 6);
+
+        try {
+#ifdef _WIN32
+            Diff->Filename = Utility::Widen(Filename->second);
+#else
+            Diff->Filename = Filename->second;
+#endif
+        }
+        catch (std::exception &) {
+            // Leave the whole song to GetSongInformation, which reports it.
+            delete Song->second;
+            Out->Songs.erase(Song);
+            continue;
+        }
+
+        Song->second->Difficulties.push_back(Diff);
+    }
+    SC(sqlite3_finalize(st));
+
+    SC(sqlite3_prepare_v2(db, SnapshotDirs, -1, &st, NULL));
+    while (sqlite3_step(st) == SQLITE_ROW)
+    {
+        const char* dir = (const char*)sqlite3_column_text(st, 0);
+        if (!dir) continue;
+
+        auto &Dir = Out->Directories[dir];
+        Dir.Signature = Text(1);
+        Dir.SongIDs = SplitSongIDs((const char*)sqlite3_column_text(st, 2));
+    }
+    SC(sqlite3_finalize(st));
+
+    Log::LogPrintf("SongDatabase: Read %d files, %d songs and %d directories from the cache.\n",
+        int(Out->Files.size()), int(Out->Songs.size()), int(Out->Directories.size()));
+    return Out;
+}
+
+SongCacheSnapshot::~SongCacheSnapshot()
+{
+    for (auto &Song : Songs)
+        delete Song.second;
+}
+
+bool SongCacheSnapshot::NeedsRenewal(std::filesystem::path File) const
+{
+    auto Entry = Files.find(Utility::ToU8(std::filesystem::absolute(File).wstring()));
+    if (Entry == Files.end())
+        return true;
+
+    return Utility::GetLastModifiedTime(File) != Entry->second.LastModified;
+}
+
+bool SongCacheSnapshot::GetDirectorySignature(std::filesystem::path Dir, std::string &Signature, std::vector<int> &SongIDs) const
+{
+    auto Entry = Directories.find(Utility::ToU8(std::filesystem::absolute(Dir).wstring()));
+    if (Entry == Directories.end())
+        return false;
+
+    Signature = Entry->second.Signature;
+    SongIDs = Entry->second.SongIDs;
+    return true;
+}
+
+int SongCacheSnapshot::GetSongIDForFile(std::filesystem::path File) const
+{
+    auto Entry = Files.find(Utility::ToU8(std::filesystem::absolute(File).wstring()));
+    if (Entry == Files.end())
+        return -1;
+
+    return Entry->second.SongID;
+}
+
+Game::VSRG::Song* SongCacheSnapshot::TakeSong(int ID)
+{
+    auto Song = Songs.find(ID);
+    if (Song == Songs.end())
+        return nullptr;
+
+    auto Out = Song->second;
+    Songs.erase(Song);
+    return Out;
+}
+
 int SongDatabase::GetSongIDForFile(std::filesystem::path File)
 {
+    std::unique_lock<std::mutex> lock(WriteMutex);
     int ret;
     int Out = -1;
 	std::string u8path = Utility::ToU8(std::filesystem::absolute(File).wstring());
@@ -646,16 +1258,19 @@ int SongDatabase::GetSongIDForFile(std::filesystem::path File)
 
 std::string SongDatabase::GetStageFile(int DiffID)
 {
+    std::unique_lock<std::mutex> lock(ReadMutex);
     int ret;
     
 	SC(sqlite3_bind_int(st_GetStageFile, 
 		sqlite3_bind_parameter_index(st_GetStageFile, "$did"), 
 		DiffID));
 
-    SCS(sqlite3_step(st_GetStageFile));
-
-    const char* sOut = (const char*)sqlite3_column_text(st_GetStageFile, 0);
-    std::string Out = sOut ? sOut : "";
+    std::string Out;
+    if (StepReader(st_GetStageFile))
+    {
+        const char* sOut = (const char*)sqlite3_column_text(st_GetStageFile, 0);
+        Out = sOut ? sOut : "";
+    }
 
     SC(sqlite3_reset(st_GetStageFile));
     return Out;
@@ -663,17 +1278,20 @@ std::string SongDatabase::GetStageFile(int DiffID)
 
 void SongDatabase::GetPreviewInfo(int SongID, std::string &Filename, float &PreviewStart)
 {
+    std::unique_lock<std::mutex> lock(ReadMutex);
     int ret;
     SC(sqlite3_bind_int(st_GetPreviewInfo, 
 		sqlite3_bind_parameter_index(st_GetPreviewInfo, "$sid"), 
 		SongID));
 
-    SCS(sqlite3_step(st_GetPreviewInfo));
-
-    const char* sOut = (const char*)sqlite3_column_text(st_GetPreviewInfo, 0);
-    float fOut = sqlite3_column_double(st_GetPreviewInfo, 1);
-
-    std::string Out = sOut ? sOut : "";
+    std::string Out;
+    float fOut = 0;
+    if (StepReader(st_GetPreviewInfo))
+    {
+        const char* sOut = (const char*)sqlite3_column_text(st_GetPreviewInfo, 0);
+        fOut = sqlite3_column_double(st_GetPreviewInfo, 1);
+        Out = sOut ? sOut : "";
+    }
 
     SC(sqlite3_reset(st_GetPreviewInfo));
     Filename = Out;
@@ -10,10 +10,76 @@ namespace Game {
 	}
 }
 
+// A song directory in the cache, and the songs that were read from it.
+struct CachedDirectory
+{
+    std::filesystem::path Directory;
+    std::vector<int> SongIDs;
+};
+
+// What GetSongSummaries reads of a song: enough to list and sort it by, without its difficulties.
+struct SongSummary
+{
+    int ID;
+    std::string Title, Author;
+    double Length; // Of the first difficulty.
+    int MinLevel, MaxLevel;
+    double MaxNPS;
+    int Keys; // The most any difficulty has.
+    int Difficulties;
+};
+
+// The cache read in bulk, so a scan can validate and load many directories without a query per file.
+class SongCacheSnapshot
+{
+    friend class SongDatabase;
+
+    struct FileInfo
+    {
+        int LastModified;
+        int SongID;
+    };
+
+    struct DirectoryInfo
+    {
+        std::string Signature;
+        std::vector<int> SongIDs;
+    };
+
+    // By absolute UTF-8 filename, as the database stores them.
+    std::unordered_map<std::string, FileInfo> Files;
+    std::unordered_map<std::string, DirectoryInfo> Directories;
+    std::unordered_map<int, Game::VSRG::Song*> Songs;
+
+public:
+    ~SongCacheSnapshot();
+
+    // Like SongDatabase::CacheNeedsRenewal, GetDirectorySignature and GetSongIDForFile, as of when the snapshot was taken.
+    bool NeedsRenewal(std::filesystem::path File) const;
+    bool GetDirectorySignature(std::filesystem::path Dir, std::string &Signature, std::vector<int> &SongIDs) const;
+    int GetSongIDForFile(std::filesystem::path File) const;
+
+    // The song as GetSongInformation would fill it, now owned by the caller.
+    // nullptr if it's not in the snapshot or was taken already.
+    Game::VSRG::Song* TakeSong(int ID);
+};
+
+/*
+    Scans write through one connection and song select reads through another, which in WAL mode
+    doesn't wait on a scan's transaction. Between StartTransaction and EndTransaction, writes are committed
+    in batches so readers see new songs as the scan goes; a reader that misses commits the batch early.
+*/
 class SongDatabase
 {
 private:
-    sqlite3 *db;
+    sqlite3 *db, *readDb;
+    std::mutex WriteMutex; // db's statements and the batch.
+    std::mutex ReadMutex; // readDb's statements.
+
+    bool InBatch;
+    int BatchWrites;
+    std::chrono::steady_clock::time_point BatchStart;
+
     sqlite3_stmt *st_IDQuery,
         *st_SngInsertQuery,
         *st_DiffInsertQuery,
@@ -34,7 +100,20 @@ private:
         *st_GetDiffAuthor,
 		*st_GetDiffGenre,
         *st_GetPreviewInfo,
-        *st_GetStageFile;
+        *st_GetStageFile,
+        *st_TouchFile,
+        *st_GetDirSignature,
+        *st_SetDirSignature,
+        *st_GetCachedDirs,
+        *st_HasCachedDirs,
+        *st_ForgetDirs;
+
+    // Bring a database from an older version up to date.
+    void Migrate();
+
+    // Fingerprints CacheNeedsRenewal took of changed files, by absolute UTF-8 path, so InsertFilename needn't take them again.
+    std::map<std::string, std::string> CheckedFingerprints;
+    std::string TakeFingerprint(const std::string &u8p, std::filesystem::path Fn);
 
     // Returns the ID.
     int InsertFilename(std::filesystem::path Fn);
@@ -42,6 +121,15 @@ private:
 
 	void UpdateDiffInternal(int &ret, int DiffID, Game::Song::Difficulty * Diff);
 	void InsertDiffInternal(int &ret, int SongID, int FileID, Game::Song::Difficulty * Diff);
+
+    // With WriteMutex held. Commits and opens the next transaction if the batch is big or old enough.
+    void CountBatchWrite();
+
+    // Commit what the batch has so far. Returns whether there was anything to commit.
+    bool FlushBatch();
+
+    // Step a readDb statement. A miss may be a row that's still in the batch, so that's committed and it's tried again.
+    bool StepReader(sqlite3_stmt *st);
 public:
 
     SongDatabase(std::string Database);
@@ -63,8 +151,26 @@ public:
 
     int GetSongIDForFile(std::filesystem::path File);
 
+    // The signature stored for a song directory when its songs were last cached, and those songs' IDs.
+    // False if there's none.
+    bool GetDirectorySignature(std::filesystem::path Dir, std::string &Signature, std::vector<int> &SongIDs);
+    void SetDirectorySignature(std::filesystem::path Dir, const std::string &Signature, const std::vector<int> &SongIDs);
+
+    // The song directories cached anywhere under Dir, for lists that are read from the cache.
+    std::vector<CachedDirectory> GetCachedDirectories(std::filesystem::path Dir);
+    bool HasCachedDirectories(std::filesystem::path Dir);
+
+    // Drop Dir and everything under it from the directory cache, once it's gone.
+    void ForgetDirectory(std::filesystem::path Dir);
+
     void GetSongInformation(int ID, Game::VSRG::Song* Out);
 
+    // Summaries by ID for as many of IDs as are cached with a difficulty, a query per few hundred.
+    std::unordered_map<int, SongSummary> GetSongSummaries(const std::vector<int> &IDs);
+
+    // Read every file, song and difficulty at once.
+    std::unique_ptr<SongCacheSnapshot> LoadCacheSnapshot();
+
     void StartTransaction();
     void EndTransaction();
 };
\ No newline at end of file
@@ -5,15 +5,89 @@
 #include "Song7K.h"
 #include "SongList.h"
 
+#include "SongDatabase.h"
 #include "SongLoader.h"
+#include "SongMetadata.h"
+#include "SongScanner.h"
 
 ListEntry::ListEntry() {
 	Kind = Directory;
+	Row = 0;
+}
+
+int ListEntry::GetSongID() const
+{
+	if (Metadata)
+		return Metadata->GetID(Row);
+	return static_cast<Game::Song*>(Data.get())->ID;
+}
+
+const std::filesystem::path& ListEntry::GetSongDirectory() const
+{
+	if (Metadata)
+		return Metadata->GetDirectory(Row);
+	return static_cast<Game::Song*>(Data.get())->SongDirectory;
+}
+
+namespace
+{
+	// What songs sort by, from their row when they're listed from the cache.
+	const std::string& GetTitle(const ListEntry &Entry)
+	{
+		if (Entry.Metadata)
+			return Entry.Metadata->GetTitle(Entry.Row);
+		return static_cast<Game::Song*>(Entry.Data.get())->SongName;
+	}
+
+	const std::string& GetAuthor(const ListEntry &Entry)
+	{
+		if (Entry.Metadata)
+			return Entry.Metadata->GetAuthor(Entry.Row);
+		return static_cast<Game::Song*>(Entry.Data.get())->SongAuthor;
+	}
+
+	float GetLength(const ListEntry &Entry)
+	{
+		if (Entry.Metadata)
+			return Entry.Metadata->GetLength(Entry.Row);
+
+		auto dif = static_cast<Game::VSRG::Song*>(Entry.Data.get())->GetDifficulty(0);
+		if (dif) return dif->Duration;
+
+		return 0.0;
+	}
+
+	int GetMinLevel(const ListEntry &Entry)
+	{
+		if (Entry.Metadata)
+			return Entry.Metadata->GetMinLevel(Entry.Row);
+
+		auto minlevel = 10000000;
+		for (auto &diff : static_cast<Game::VSRG::Song*>(Entry.Data.get())->Difficulties)
+			minlevel = std::min(minlevel, diff->Level);
+
+		return minlevel;
+	}
+
+	int GetMaxLevel(const ListEntry &Entry)
+	{
+		if (Entry.Metadata)
+			return Entry.Metadata->GetMaxLevel(Entry.Row);
+
+		auto maxlevel = -10000000;
+		for (auto &diff : static_cast<Game::VSRG::Song*>(Entry.Data.get())->Difficulties)
+			maxlevel = std::max(maxlevel, diff->Level);
+
+		return maxlevel;
+	}
 }
 
 SongList::SongList(SongList* Parent)
     : mParent(Parent)
 	, IsInUse(false)
+	, mSource(nullptr)
+	, mFetched(false)
+	, mSort(SORT_UNKNOWN)
 {
 }
 
@@ -42,8 +116,9 @@ void SongList::ClearEmpty()
 		bool increase = true;
 
 		if (it->Kind == it->Directory) {
+			// A list that hasn't been read from the cache has songs, or it wouldn't be there.
 			auto list = std::static_pointer_cast<SongList>(it->Data);
-			if (list->GetNumEntries() == 0 && !list->InUse()) {
+			if (list->IsPopulated() && list->GetNumEntries() == 0 && !list->InUse()) {
 				it = mChildren.erase(it);
 				increase = false;
 			}
@@ -54,6 +129,207 @@ void SongList::ClearEmpty()
 	}
 }
 
+void SongList::SetDirectory(std::filesystem::path Dir)
+{
+	mDirectory = Dir;
+}
+
+const std::filesystem::path& SongList::GetDirectory() const
+{
+	return mDirectory;
+}
+
+std::shared_ptr<SongList> SongList::GetDirectoryEntry(const std::filesystem::path &Dir)
+{
+	for (auto &Entry : mChildren) {
+		if (Entry.Kind != ListEntry::Directory) continue;
+
+		auto List = std::static_pointer_cast<SongList>(Entry.Data);
+		if (List->GetDirectory() == Dir)
+			return List;
+	}
+
+	return nullptr;
+}
+
+SongList* SongList::FindDirectory(const std::filesystem::path &Dir)
+{
+	if (mDirectory == Dir)
+		return this;
+
+	for (auto &Entry : mChildren) {
+		if (Entry.Kind != ListEntry::Directory) continue;
+
+		auto Found = std::static_pointer_cast<SongList>(Entry.Data)->FindDirectory(Dir);
+		if (Found)
+			return Found;
+	}
+
+	return nullptr;
+}
+
+void SongList::RemoveSongsFrom(const std::filesystem::path &Dir)
+{
+	mChildren.erase(std::remove_if(mChildren.begin(), mChildren.end(), [&](const ListEntry &Entry) {
+		return Entry.Kind == ListEntry::Song && Entry.GetSongDirectory() == Dir;
+	}), mChildren.end());
+}
+
+void SongList::RemoveDirectory(const std::filesystem::path &Dir)
+{
+	mChildren.erase(std::remove_if(mChildren.begin(), mChildren.end(), [&](const ListEntry &Entry) {
+		if (Entry.Kind == ListEntry::Song)
+			return Entry.GetSongDirectory() == Dir;
+
+		auto List = std::static_pointer_cast<SongList>(Entry.Data);
+		return List->GetDirectory() == Dir && !List->InUse();
+	}), mChildren.end());
+}
+
+std::set<std::filesystem::path> SongList::RemoveMissing()
+{
+	std::set<std::filesystem::path> Gone;
+
+	mChildren.erase(std::remove_if(mChildren.begin(), mChildren.end(), [&](const ListEntry &Entry) {
+		if (Entry.Kind == ListEntry::Song) {
+			auto &Dir = Entry.GetSongDirectory();
+			if (std::filesystem::exists(Dir))
+				return false;
+
+			Gone.insert(Dir);
+			return true;
+		}
+
+		auto List = std::static_pointer_cast<SongList>(Entry.Data);
+		if (List->GetDirectory().empty() || std::filesystem::exists(List->GetDirectory()))
+			return false;
+
+		Gone.insert(List->GetDirectory());
+		return !List->InUse();
+	}), mChildren.end());
+
+	return Gone;
+}
+
+void SongList::AddCachedDirectory(SongDatabase* DB, std::filesystem::path Dir, std::string Name)
+{
+	Dir = std::filesystem::absolute(Dir);
+	if (!DB->HasCachedDirectories(Dir))
+		return;
+
+	SongList* NewList = new SongList(this);
+	NewList->mSource = DB;
+	NewList->mDirectory = Dir;
+
+	ListEntry NewEntry;
+	NewEntry.EntryName = Name;
+	NewEntry.Kind = ListEntry::Directory;
+	NewEntry.Data = std::shared_ptr<void>(NewList);
+
+	mChildren.push_back(NewEntry);
+}
+
+bool SongList::IsPopulated() const
+{
+	return !mSource || mFetched;
+}
+
+void SongList::Populate()
+{
+	if (IsPopulated())
+		return;
+
+	mFetched = true;
+	Fetch();
+
+	if (mSort != SORT_UNKNOWN)
+		SortBy(mSort);
+}
+
+// Adds what the cache has under mDirectory that isn't here yet: lists for the directories right under it,
+// to be read in turn when they're opened, and the songs of the song directories right under it.
+void SongList::Fetch()
+{
+	std::set<std::filesystem::path> Present;
+	for (auto &Entry : mChildren) {
+		if (Entry.Kind == ListEntry::Directory)
+			Present.insert(std::static_pointer_cast<SongList>(Entry.Data)->GetDirectory());
+		else
+			Present.insert(Entry.GetSongDirectory());
+	}
+
+	// The songs are only listed; each is loaded when it's asked for.
+	std::vector<std::pair<std::filesystem::path, std::vector<int>>> SongDirectories;
+
+	for (auto &Cached : mSource->GetCachedDirectories(mDirectory)) {
+		auto Dir = Cached.Directory;
+		while (Dir.has_parent_path() && Dir.parent_path() != mDirectory)
+			Dir = Dir.parent_path();
+
+		if (!Present.insert(Dir).second)
+			continue;
+
+		if (Dir != Cached.Directory) {
+			SongList* NewList = new SongList(this);
+			NewList->mSource = mSource;
+			NewList->mDirectory = Dir;
+			NewList->mSort = mSort;
+
+			ListEntry NewEntry;
+			NewEntry.EntryName = Utility::ToU8(Dir.filename().wstring());
+			NewEntry.Kind = ListEntry::Directory;
+			NewEntry.Data = std::shared_ptr<void>(NewList);
+			mChildren.push_back(NewEntry);
+			continue;
+		}
+
+		SongDirectories.push_back(std::make_pair(Cached.Directory, Cached.SongIDs));
+	}
+
+	if (SongDirectories.empty())
+		return;
+
+	// One query for the lot, rather than one per song.
+	std::vector<int> IDs;
+	for (auto &Dir : SongDirectories)
+		IDs.insert(IDs.end(), Dir.second.begin(), Dir.second.end());
+
+	auto Metadata = std::make_shared<SongMetadata>(mSource, SongDirectories, mSource->GetSongSummaries(IDs));
+	for (SongMetadata::Row R = 0; R < Metadata->GetRowCount(); R++) {
+		ListEntry NewEntry;
+		NewEntry.Kind = ListEntry::Song;
+		NewEntry.Metadata = Metadata;
+		NewEntry.Row = R;
+		mChildren.push_back(NewEntry);
+	}
+}
+
+bool SongList::UpdateFromCache(const std::filesystem::path &SongDir, const std::vector<Game::VSRG::Song*> &Songs)
+{
+	if (!IsPopulated())
+		return false;
+
+	if (SongDir.parent_path() == mDirectory) {
+		RemoveSongsFrom(SongDir);
+		for (auto Song : Songs)
+			AddSong(std::shared_ptr<Game::Song>(Song));
+		return true;
+	}
+
+	auto Dir = SongDir;
+	while (Dir.has_parent_path() && Dir.parent_path() != mDirectory)
+		Dir = Dir.parent_path();
+
+	auto Child = GetDirectoryEntry(Dir);
+	if (Child)
+		return Child->UpdateFromCache(SongDir, Songs);
+
+	// New here; it's read like the rest when it's opened.
+	if (mSource)
+		Fetch();
+	return false;
+}
+
 void SongList::AddSong(std::shared_ptr<Game::Song> Song)
 {
     ListEntry NewEntry;
@@ -70,6 +346,7 @@ void SongList::AddEntry(ListEntry entry)
 
 const std::vector<ListEntry>& SongList::GetEntries()
 {
+	Populate();
 	return mChildren;
 }
 
@@ -79,79 +356,9 @@ void SongList::AddNamedDirectory(
 	std::filesystem::path Dir, 
 	std::string Name)
 {
-    bool EntryWasPushed = false;
-    SongList* NewList = new SongList(this);
-
-    ListEntry NewEntry;
-
-    NewEntry.EntryName = Name;
-    NewEntry.Kind = ListEntry::Directory;
-    NewEntry.Data = std::shared_ptr<void>(NewList);
-
-    std::vector<Game::VSRG::Song*> Songs7K;
-    std::vector<std::string> Listing;
-
-	// boost throws with nonexisting directories
-	if (!std::filesystem::exists(Dir)) return;
-
-	for (auto i : std::filesystem::directory_iterator (Dir))
-    {
-        if (i == "." || i == "..") continue;
-
-		if (!std::filesystem::is_directory(i.path())) continue;
-
-		Loader->LoadSong7KFromDir(i, Songs7K);
-
-        if (!Songs7K.size()) // No songs, so, time to recursively search.
-        {
-            if (!EntryWasPushed)
-            {
-                std::unique_lock<std::mutex> lock(loadMutex);
-                mChildren.push_back(NewEntry);
-                EntryWasPushed = true;
-            }
-
-            NewList->AddDirectory(loadMutex, Loader, i);
-
-            {
-                std::unique_lock<std::mutex> lock(loadMutex);
-                if (!NewList->GetNumEntries() && !NewList->InUse())
-                {
-                    if (mChildren.size())
-                        mChildren.erase(mChildren.end() - 1);
-                    EntryWasPushed = false;
-                }
-            }
-        }
-        else
-        {
-            auto tSize = Songs7K.size();
-
-            if (Songs7K.size())
-            {
-                std::unique_lock<std::mutex> lock(loadMutex);
-
-                for (auto j = Songs7K.begin();
-                j != Songs7K.end();
-                    ++j)
-                {
-                    NewList->AddSong(std::shared_ptr<Game::Song>(*j));
-                }
-
-                Songs7K.clear();
-            }
-
-            if (tSize > 0) // There's a song in here.
-            {
-                if (!EntryWasPushed)
-                {
-                    std::unique_lock<std::mutex> lock(loadMutex);
-                    mChildren.push_back(NewEntry);
-                    EntryWasPushed = true;
-                }
-            }
-        }
-    }
+	SongScanner Scanner(Loader, loadMutex);
+	Scanner.AddNamedDirectory(this, Dir, Name);
+	Scanner.Finish();
 }
 
 void SongList::AddDirectory(std::mutex &loadMutex, SongLoader *Loader, std::filesystem::path Dir)
@@ -183,30 +390,34 @@ bool SongList::IsDirectory(unsigned int Entry) const
 
 std::shared_ptr<SongList> SongList::GetListEntry(unsigned int Entry)
 {
+    Populate();
     assert(IsDirectory(Entry));
     return std::static_pointer_cast<SongList> (mChildren[Entry].Data);
 }
 
 std::shared_ptr<Game::VSRG::Song> SongList::GetSongEntry(unsigned int Entry)
 {
-    if (!IsDirectory(Entry))
-        return std::static_pointer_cast<Game::VSRG::Song> (mChildren[Entry].Data);
-    else
+    Populate();
+    if (IsDirectory(Entry))
         return nullptr;
+
+    auto &Song = mChildren[Entry];
+    if (Song.Metadata)
+        return Song.Metadata->GetSong(Song.Row);
+
+    return std::static_pointer_cast<Game::VSRG::Song> (Song.Data);
 }
 
 std::string SongList::GetEntryTitle(unsigned int Entry)
 {
+    Populate();
     if (Entry >= mChildren.size())
         return "";
 
     if (mChildren[Entry].Kind == ListEntry::Directory)
         return mChildren[Entry].EntryName;
     else
-    {
-        std::shared_ptr<Game::Song> Song = std::static_pointer_cast<Game::Song>(mChildren[Entry].Data);
-        return Song->SongName;
-    }
+        return GetTitle(mChildren[Entry]);
 }
 
 unsigned int SongList::GetNumEntries() const
@@ -247,86 +458,42 @@ void SongList::SortByFn(std::function<bool(const ListEntry&, const ListEntry&)>
 
 void SongList::SortBy(ESortCriteria criteria)
 {
+	mSort = criteria;
+
+	// Sorted when it's read.
+	if (!IsPopulated())
+		return;
+
 	switch (criteria)
 	{
 	case SORT_TITLE:
 		SortByFn([](const ListEntry&A, const ListEntry&B)
 		{
-			auto a = std::static_pointer_cast<Game::Song>(A.Data);
-			auto b = std::static_pointer_cast<Game::Song>(B.Data);
-			return a->SongName < b->SongName;
+			return GetTitle(A) < GetTitle(B);
 		});
 		break;
 	case SORT_AUTHOR:
 		SortByFn([](const ListEntry&A, const ListEntry&B)
 		{
-			auto a = std::static_pointer_cast<Game::Song>(A.Data);
-			auto b = std::static_pointer_cast<Game::Song>(B.Data);
-			return a->SongAuthor < b->SongAuthor;
+			return GetAuthor(A) < GetAuthor(B);
 		});
 		break;
 	case SORT_LENGTH:
 		SortByFn([](const ListEntry&A, const ListEntry&B)
 		{
-			auto dur = [](std::shared_ptr<Game::Song> a)
-			{
-				auto sng = std::static_pointer_cast<Game::VSRG::Song>(a);
-				auto dif = sng->GetDifficulty(0);
-				if (dif) return dif->Duration;
-				
-				return 0.0;
-			};
-
-			auto a = std::static_pointer_cast<Game::Song>(A.Data);
-			auto b = std::static_pointer_cast<Game::Song>(B.Data);
-			float lena = dur(a);
-			float lenb = dur(b);
-		
-			return lena < lenb;
+			return GetLength(A) < GetLength(B);
 		});
 		break;
 	case SORT_MINLEVEL:
 		SortByFn([](const ListEntry&A, const ListEntry&B)
 		{
-			auto nps = [](std::shared_ptr<Game::Song> a)
-			{
-				auto sng = std::static_pointer_cast<Game::VSRG::Song>(a);
-				auto minnps = 10000000;
-				for (auto diff : sng->Difficulties) {
-					minnps = std::min(minnps, diff->Level);
-				}
-
-				return minnps;
-			};
-
-			auto a = std::static_pointer_cast<Game::Song>(A.Data);
-			auto b = std::static_pointer_cast<Game::Song>(B.Data);
-			float npsa = nps(a);
-			float npsb = nps(b);
-		
-			return npsa < npsb;
+			return GetMinLevel(A) < GetMinLevel(B);
 		});
 		break;
 	case SORT_MAXLEVEL:
 		SortByFn([](const ListEntry&A, const ListEntry&B)
 		{
-			auto nps = [](std::shared_ptr<Game::Song> a)
-			{
-				auto sng = std::static_pointer_cast<Game::VSRG::Song>(a);
-				auto maxnps = -10000000;
-				for (auto diff : sng->Difficulties) {
-					maxnps = std::max(maxnps, diff->Level);
-				}
-
-				return maxnps;
-			};
-
-			auto a = std::static_pointer_cast<Game::Song>(A.Data);
-			auto b = std::static_pointer_cast<Game::Song>(B.Data);
-			float npsa = nps(a);
-			float npsb = nps(b);
-		
-			return npsa < npsb;
+			return GetMaxLevel(A) < GetMaxLevel(B);
 		});
 		break;
 	default:
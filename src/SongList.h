@@ -1,6 +1,8 @@
 #pragma once
 
+class SongDatabase;
 class SongLoader;
+class SongMetadata;
 
 struct ListEntry
 {
@@ -11,7 +13,16 @@ struct ListEntry
     } Kind;
     std::shared_ptr<void> Data;
     std::string EntryName;
+
+	// Songs listed from the cache have a row in Metadata instead of a song in Data;
+	// SongList::GetSongEntry loads it.
+	std::shared_ptr<SongMetadata> Metadata;
+	uint32_t Row;
+
 	ListEntry();
+
+	int GetSongID() const;
+	const std::filesystem::path& GetSongDirectory() const;
 };
 
 enum ESortCriteria
@@ -29,7 +40,16 @@ class SongList
 {
     SongList* mParent;
     std::vector<ListEntry> mChildren;
+	std::filesystem::path mDirectory;
 	std::atomic<bool> IsInUse;
+
+	// Lists from the cache read their entries from mSource the first time they're asked for them.
+	SongDatabase* mSource;
+	bool mFetched;
+	ESortCriteria mSort; // To sort by once fetched.
+
+	void Populate();
+	void Fetch();
 	void SortByFn(std::function<bool(const ListEntry&, const ListEntry&)> fn);
 
 public:
@@ -43,6 +63,33 @@ public:
 
 	void ClearEmpty();
 
+	// The (absolute) directory this list was scanned from, if any.
+	void SetDirectory(std::filesystem::path Dir);
+	const std::filesystem::path& GetDirectory() const;
+
+	// The list scanned from Dir, among this one's entries or anywhere under them.
+	std::shared_ptr<SongList> GetDirectoryEntry(const std::filesystem::path &Dir);
+	SongList* FindDirectory(const std::filesystem::path &Dir);
+
+	// Take out the songs loaded from Dir. RemoveDirectory also takes out the list scanned from it, unless it's in use.
+	void RemoveSongsFrom(const std::filesystem::path &Dir);
+	void RemoveDirectory(const std::filesystem::path &Dir);
+
+	// Take out songs and lists whose directories are gone, except lists in use. Returns those directories.
+	std::set<std::filesystem::path> RemoveMissing();
+
+	/*
+		Add Dir as a directory called Name whose entries, and theirs, are read from the cache the first time
+		they're needed rather than now. Nothing is added if the cache has nothing under Dir.
+		Until then GetNumEntries and IsDirectory only go by what's been read.
+	*/
+	void AddCachedDirectory(SongDatabase* DB, std::filesystem::path Dir, std::string Name);
+	bool IsPopulated() const;
+
+	// The cache changed for SongDir, somewhere under this list. If the list its songs go in has been read,
+	// swap them for Songs and return true; otherwise pick up any directory that's new on the way there.
+	bool UpdateFromCache(const std::filesystem::path &SongDir, const std::vector<Game::VSRG::Song*> &Songs);
+
     void AddNamedDirectory(std::mutex &loadMutex, SongLoader *Loader, std::filesystem::path Dir, std::string Name);
     void AddDirectory(std::mutex &loadMutex, SongLoader *Loader, std::filesystem::path Dir);
     void AddVirtualDirectory(std::string NewEntryName, Game::Song* List, int Count);
@@ -3,6 +3,7 @@
 #include "GameGlobal.h"
 #include "Logging.h"
 
+#include "Fingerprint.h"
 #include "Song.h"
 #include "SongDatabase.h"
 #include "Song7K.h"
@@ -31,6 +32,27 @@ struct loaderVSRGEntry_t
 SongLoader::SongLoader(SongDatabase* Database)
 {
     DB = Database;
+
+    // Read here rather than per chart, since charts may be parsed on several threads.
+    GroupFiles = !Configuration::GetConfigf("NoFileGrouping");
+    SeparateBySubtitle = Configuration::GetConfigf("SeparateBySubtitle") != 0;
+
+    // Reading a missing setting writes its default, so make sure the ones the loaders read exist.
+    Configuration::GetConfigf("OsuLoader", "Debug");
+}
+
+SongLoader::~SongLoader()
+{
+}
+
+void SongLoader::PreloadCache()
+{
+    Cache = DB->LoadCacheSnapshot();
+}
+
+void SongLoader::ReleaseCache()
+{
+    Cache = nullptr;
 }
 
 bool VSRGValidExtension(std::wstring Ext)
@@ -75,11 +97,10 @@ std::shared_ptr<Game::VSRG::Song> LoadSong7KFromFilename(const std::filesystem::
     {
         if (filename.extension() == LoadersVSRG[i].Ext)
         {
-            Log::LogPrintf("Load %s from disk...", Utility::ToU8(filename.wstring()).c_str());
             try
             {
                 LoadersVSRG[i].LoadFunc(filename, Sng);
-                Log::LogPrintf(" ok\n");
+                Log::LogPrintf("Load %s from disk... ok\n", Utility::ToU8(filename.wstring()).c_str());
             }
             catch (std::exception &e)
             {
@@ -122,15 +143,14 @@ std::shared_ptr<Game::VSRG::Song> LoadSong7KFromFilename(std::filesystem::path F
     {
         if (Ext == LoadersVSRG[i].Ext)
         {
-            Log::LogPrintf("SongLoader: Load %s from disk...", fn.string().c_str());
             try
             {
                 LoadersVSRG[i].LoadFunc(fn, Sng);
-                Log::LogPrintf(" ok\n");
+                Log::LogPrintf("SongLoader: Load %s from disk... ok\n", fn.string().c_str());
             }
             catch (std::exception &e)
             {
-                Log::LogPrintf("SongLoader: Failure loading. Reason: %s \n", e.what());
+                Log::LogPrintf("SongLoader: Failure loading %s. Reason: %s \n", fn.string().c_str(), e.what());
             }
             break;
         }
@@ -174,13 +194,17 @@ void AddSongToList(std::vector<Game::VSRG::Song*> &VecOut, Game::VSRG::Song* Sng
         delete Sng;
 }
 
+void SongLoader::PushSong7KToDatabase(Game::VSRG::Song *Song)
+{
+    PushSongToDatabase(DB, Song);
+}
+
 void SongLoader::LoadSong7KFromDir(std::filesystem::path songPath, std::vector<Game::VSRG::Song*> &VecOut)
 {
 	if (!std::filesystem::is_directory(songPath))
 		return;
 
     std::vector<std::filesystem::path> Listing = Utility::GetFileListing(songPath);
-    std::filesystem::path SongDirectory = std::filesystem::absolute(songPath);
 
     /*
         Procedure:
@@ -190,8 +214,134 @@ void SongLoader::LoadSong7KFromDir(std::filesystem::path songPath, std::vector<G
         4.- If it does not need to be renewed or created, just read the metadata and leave it like that.
     */
 
-    bool RenewCache = false;
+    // Nothing in the directory changed since it was cached, so there's no need to look at each file.
+    auto Signature = GetDirectorySignature(songPath, Listing);
+    if (LoadSong7KFromSignature(songPath, Signature, VecOut))
+        return;
+
+    std::vector<Game::VSRG::Song*> Songs;
+
+    // Files were modified- we have to reload the charts.
+    if (DirectoryNeedsRenewal(Listing))
+    {
+        ParseSong7KFromDir(songPath, Listing, Songs);
+
+        for (auto Song : Songs)
+            PushSongToDatabase(DB, Song);
+    }
+    else // We can reload from cache. We do this on a per-file basis.
+        LoadSong7KFromCache(songPath, Listing, Songs);
+
+    StoreDirectorySignature(songPath, Signature, Songs);
+    VecOut.insert(VecOut.end(), Songs.begin(), Songs.end());
+}
+
+std::string SongLoader::GetDirectorySignature(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing)
+{
+    std::vector<std::filesystem::path> Charts;
+    for (auto &File : Listing)
+    {
+        if (VSRGValidExtension(File.extension().wstring()))
+            Charts.push_back(File);
+    }
+
+    // Listings come in no particular order.
+    std::sort(Charts.begin(), Charts.end());
+
+    std::string Key = std::to_string(Utility::GetLastModifiedTime(songPath));
+    for (auto &File : Charts)
+    {
+        Key += "|" + Utility::ToU8(File.filename().wstring());
+        Key += "|" + std::to_string(std::filesystem::file_size(File));
+        Key += "|" + std::to_string(Utility::GetLastModifiedTime(File));
+    }
+
+    return Fingerprint::ToString(Fingerprint::Hash(Key.data(), Key.length()));
+}
+
+bool SongLoader::GetStoredSignature(std::filesystem::path songPath, const std::string &Signature, std::vector<int> &IDList)
+{
+    std::string Stored;
+
+    bool Found = Cache ? Cache->GetDirectorySignature(songPath, Stored, IDList) : DB->GetDirectorySignature(songPath, Stored, IDList);
+    return Found && Stored == Signature && !IDList.empty();
+}
+
+bool SongLoader::IsDirectoryCurrent(std::filesystem::path songPath, const std::string &Signature)
+{
+    std::vector<int> IDList;
+    return GetStoredSignature(songPath, Signature, IDList);
+}
+
+bool SongLoader::LoadSong7KFromSignature(std::filesystem::path songPath, const std::string &Signature, std::vector<Game::VSRG::Song*> &VecOut)
+{
+    std::vector<int> IDList;
+    if (!GetStoredSignature(songPath, Signature, IDList))
+        return false;
+
+    std::vector<Game::VSRG::Song*> Songs;
+    if (!LoadSongsFromCache(songPath, IDList, Songs))
+    {
+        // Leave it to the per-file checks.
+        for (auto Song : Songs)
+            delete Song;
+        return false;
+    }
+
+    VecOut.insert(VecOut.end(), Songs.begin(), Songs.end());
+    return true;
+}
+
+std::vector<std::filesystem::path> SongLoader::GetCachedDirectories(std::filesystem::path Dir)
+{
+    std::vector<std::filesystem::path> Out;
+    for (auto &Cached : DB->GetCachedDirectories(Dir))
+        Out.push_back(Cached.Directory);
+
+    return Out;
+}
+
+void SongLoader::ForgetDirectory(std::filesystem::path Dir)
+{
+    DB->ForgetDirectory(Dir);
+}
+
+void SongLoader::StoreDirectorySignature(std::filesystem::path songPath, const std::string &Signature, const std::vector<Game::VSRG::Song*> &Songs)
+{
+    if (Signature.empty())
+        return;
+
+    // A directory that gave nothing is looked at again next time, in case that was a fluke.
+    if (Songs.empty())
+    {
+        DB->ForgetDirectory(songPath);
+        return;
+    }
+
+    std::vector<int> IDList;
+    for (auto Song : Songs)
+    {
+        if (Song->ID <= 0)
+            return;
+        IDList.push_back(Song->ID);
+    }
 
+    DB->SetDirectorySignature(songPath, Signature, IDList);
+}
+
+bool SongLoader::IsSongDirectory(const std::vector<std::filesystem::path> &Listing)
+{
+    for (auto &File : Listing)
+    {
+        if (VSRGValidExtension(File.extension().wstring()))
+            return true;
+    }
+
+    return false;
+}
+
+bool SongLoader::DirectoryNeedsRenewal(const std::vector<std::filesystem::path> &Listing)
+{
     /*
         We want the following:
         All BMS must be packed together.
@@ -217,168 +367,183 @@ void SongLoader::LoadSong7KFromDir(std::filesystem::path songPath, std::vector<G
         */
         std::string Fname = File.filename().string();
 
+		// The snapshot only compares modification times; the database also looks at whether a changed file's contents did.
 		if (VSRGValidExtension(Ext) &&
 			Fname.length() &&
-			DB->CacheNeedsRenewal(File))
-				RenewCache = true;
+			(!Cache || Cache->NeedsRenewal(File)) && DB->CacheNeedsRenewal(File))
+				return true;
     }
 
-    // Files were modified- we have to reload the charts.
-    if (RenewCache)
-    {
-		CfgVar NoFileGrouping("NoFileGrouping");
-        // First, pack BMS charts together.
-        std::map<std::string, Game::VSRG::Song*> bmsk;
-        Game::VSRG::Song *BMSSong = new Game::VSRG::Song;
+    return false;
+}
 
-        // Every OJN gets its own Song object.
-        Game::VSRG::Song *OJNSong = new Game::VSRG::Song;
-        OJNSong->SongDirectory = SongDirectory;
+void SongLoader::ParseSong7KFromDir(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing, std::vector<Game::VSRG::Song*> &VecOut)
+{
+    std::filesystem::path SongDirectory = std::filesystem::absolute(songPath);
 
-        // osu!mania charts are packed together, with FTB charts.
-        Game::VSRG::Song *osuSong = new Game::VSRG::Song;
-        osuSong->SongDirectory = SongDirectory;
+    // First, pack BMS charts together.
+    std::map<std::string, Game::VSRG::Song*> bmsk;
+    Game::VSRG::Song *BMSSong = new Game::VSRG::Song;
 
-        // Stepmania charts get their own song objects too.
-        Game::VSRG::Song *smSong = new Game::VSRG::Song;
-        smSong->SongDirectory = SongDirectory;
+    // Every OJN gets its own Song object.
+    Game::VSRG::Song *OJNSong = new Game::VSRG::Song;
+    OJNSong->SongDirectory = SongDirectory;
 
-        for (auto File : Listing)
+    // osu!mania charts are packed together, with FTB charts.
+    Game::VSRG::Song *osuSong = new Game::VSRG::Song;
+    osuSong->SongDirectory = SongDirectory;
+
+    // Stepmania charts get their own song objects too.
+    Game::VSRG::Song *smSong = new Game::VSRG::Song;
+    smSong->SongDirectory = SongDirectory;
+
+    for (auto File : Listing)
+    {
+        std::wstring Ext = File.extension().wstring();
+		File = File.filename();
+
+        // We want to group charts with the same title together.
+        if (ValidBMSExtension(Ext) || Ext == L".bmson")
         {
-            std::wstring Ext = File.extension().wstring();
-			File = File.filename();
+            BMSSong->SongDirectory = SongDirectory;
 
-            // We want to group charts with the same title together.
-            if (ValidBMSExtension(Ext) || Ext == L".bmson")
+            try
             {
-                BMSSong->SongDirectory = SongDirectory;
-
-                try
-                {
-                    LoadSong7KFromFilename(File, SongDirectory, BMSSong);
-                }
-                catch (std::exception &ex)
-                {
-                    Log::Logf("\nSongLoader::LoadSong7KFromDir(): Exception \"%s\" occurred while loading file \"%s\"\n",
-                        ex.what(), File.filename().c_str());
-                    Utility::DebugBreak();
-                }
-
-                // We found a chart with the same title (and subtitle) already.
-
-				if (!NoFileGrouping) {
-					std::string key;
-					if (Configuration::GetConfigf("SeparateBySubtitle"))
-						key = BMSSong->SongName + BMSSong->Subtitle;
-					else
-						key = BMSSong->SongName;
-
-					if (bmsk.find(key) != bmsk.end())
-					{
-						Game::VSRG::Song *oldSng = bmsk[key];
-
-						if (BMSSong->Difficulties.size()) // BMS charts don't have more than one difficulty anyway.
-							oldSng->Difficulties.push_back(BMSSong->Difficulties[0]);
-
-						BMSSong->Difficulties.clear();
-						delete BMSSong;
-					}
-					else // Ah then, don't delete it.
-					{
-						bmsk[key] = BMSSong;
-					}
-
-					BMSSong = new Game::VSRG::Song;
-				} else
-				{
-					PushSongToDatabase(DB, BMSSong);
-					AddSongToList(VecOut, BMSSong);
-					BMSSong = new Game::VSRG::Song;
-				}
+                LoadSong7KFromFilename(File, SongDirectory, BMSSong);
             }
-
-            if (Ext == L".ojn")
+            catch (std::exception &ex)
             {
-                LoadSong7KFromFilename(File, SongDirectory, OJNSong);
-                PushSongToDatabase(DB, OJNSong);
-                AddSongToList(VecOut, OJNSong);
-                OJNSong = new VSRG::Song;
-                OJNSong->SongDirectory = SongDirectory;
+                Log::Logf("\nSongLoader::ParseSong7KFromDir(): Exception \"%s\" occurred while loading file \"%s\"\n",
+                    ex.what(), File.filename().c_str());
+                Utility::DebugBreak();
             }
 
-            if (Ext == L".osu" || Ext == L".fcf")
-                LoadSong7KFromFilename(File, SongDirectory, osuSong);
+            // We found a chart with the same title (and subtitle) already.
 
-            if (Ext == L".sm" || Ext == L".ssc")
-            {
-                LoadSong7KFromFilename(File, SongDirectory, smSong);
-                PushSongToDatabase(DB, smSong);
-                AddSongToList(VecOut, smSong);
-                smSong = new VSRG::Song;
-                smSong->SongDirectory = SongDirectory;
-            }
+			if (GroupFiles) {
+				std::string key;
+				if (SeparateBySubtitle)
+					key = BMSSong->SongName + BMSSong->Subtitle;
+				else
+					key = BMSSong->SongName;
+
+				if (bmsk.find(key) != bmsk.end())
+				{
+					Game::VSRG::Song *oldSng = bmsk[key];
+
+					if (BMSSong->Difficulties.size()) // BMS charts don't have more than one difficulty anyway.
+						oldSng->Difficulties.push_back(BMSSong->Difficulties[0]);
+
+					BMSSong->Difficulties.clear();
+					delete BMSSong;
+				}
+				else // Ah then, don't delete it.
+				{
+					bmsk[key] = BMSSong;
+				}
+
+				BMSSong = new Game::VSRG::Song;
+			} else
+			{
+				AddSongToList(VecOut, BMSSong);
+				BMSSong = new Game::VSRG::Song;
+			}
         }
 
-        // PushVSRGSong() handles the cleanup.
-        for (auto i = bmsk.begin();
-        i != bmsk.end(); ++i)
+        if (Ext == L".ojn")
         {
-            PushSongToDatabase(DB, i->second);
-            AddSongToList(VecOut, i->second);
+            LoadSong7KFromFilename(File, SongDirectory, OJNSong);
+            AddSongToList(VecOut, OJNSong);
+            OJNSong = new VSRG::Song;
+            OJNSong->SongDirectory = SongDirectory;
         }
 
-        PushSongToDatabase(DB, OJNSong);
-        AddSongToList(VecOut, OJNSong);
-
-        PushSongToDatabase(DB, osuSong);
-        AddSongToList(VecOut, osuSong);
+        if (Ext == L".osu" || Ext == L".fcf")
+            LoadSong7KFromFilename(File, SongDirectory, osuSong);
 
-        PushSongToDatabase(DB, smSong);
-        AddSongToList(VecOut, smSong);
+        if (Ext == L".sm" || Ext == L".ssc")
+        {
+            LoadSong7KFromFilename(File, SongDirectory, smSong);
+            AddSongToList(VecOut, smSong);
+            smSong = new VSRG::Song;
+            smSong->SongDirectory = SongDirectory;
+        }
     }
-    else // We can reload from cache. We do this on a per-file basis.
-    {
-        // We need to get the song IDs for every file; it's guaranteed that they exist, in theory.
-        int ID = -1;
-        std::vector<int> IDList;
 
-        for (auto File : Listing)
+    // The last BMS song object was never used.
+    delete BMSSong;
+
+    for (auto i = bmsk.begin();
+    i != bmsk.end(); ++i)
+        AddSongToList(VecOut, i->second);
+
+    AddSongToList(VecOut, OJNSong);
+    AddSongToList(VecOut, osuSong);
+    AddSongToList(VecOut, smSong);
+}
+
+void SongLoader::LoadSong7KFromCache(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing, std::vector<Game::VSRG::Song*> &VecOut)
+{
+    std::filesystem::path SongDirectory = std::filesystem::absolute(songPath);
+
+    // We need to get the song IDs for every file; it's guaranteed that they exist, in theory.
+    int ID = -1;
+    std::vector<int> IDList;
+
+    for (auto File : Listing)
+    {
+        std::wstring Ext = File.extension().wstring();
+        if (VSRGValidExtension(Ext))
         {
-            std::wstring Ext = File.extension().wstring();
-            if (VSRGValidExtension(Ext))
+            int CurrentID = Cache ? Cache->GetSongIDForFile(File) : DB->GetSongIDForFile(File);
+            if (CurrentID != ID)
             {
-                int CurrentID = DB->GetSongIDForFile(File);
-                if (CurrentID != ID)
-                {
-                    ID = CurrentID;
-                    IDList.push_back(ID);
-                }
+                ID = CurrentID;
+                IDList.push_back(ID);
             }
         }
+    }
 
-        // So now we have our list with song IDs that are present on the current directory.
-        // Time to load from cache.
-        for (auto i = IDList.begin();
-        i != IDList.end();
-            ++i)
-        {
-            VSRG::Song *New = new VSRG::Song;
-            Log::Logf("Song ID %d load from cache...", *i);
-			try {
-				DB->GetSongInformation(*i, New);
-				New->SongDirectory = SongDirectory;
+    // So now we have our list with song IDs that are present on the current directory.
+    // Time to load from cache.
+    LoadSongsFromCache(SongDirectory, IDList, VecOut);
+}
 
-				// make sure it's a well-formed directory on debug
-				assert(std::filesystem::exists(New->SongDirectory));
+bool SongLoader::LoadSongsFromCache(std::filesystem::path SongDirectory, const std::vector<int> &IDList, std::vector<Game::VSRG::Song*> &VecOut)
+{
+    bool AllLoaded = true;
 
-				AddSongToList(VecOut, New);
-				Log::Logf(" ok\n");
-			}
-			catch (std::exception &e) {
-				Log::Logf("Error loading from cache: %s\n", e.what());
+    for (auto i = IDList.begin();
+    i != IDList.end();
+        ++i)
+    {
+        VSRG::Song *New = Cache ? Cache->TakeSong(*i) : nullptr;
+		try {
+			if (!New)
+			{
+				New = new VSRG::Song;
+				DB->GetSongInformation(*i, New);
 			}
-        }
+
+			New->SongDirectory = SongDirectory;
+
+			// make sure it's a well-formed directory on debug
+			assert(std::filesystem::exists(New->SongDirectory));
+
+			if (!New->Difficulties.size())
+				AllLoaded = false;
+
+			AddSongToList(VecOut, New);
+			Log::Logf("Song ID %d load from cache... ok\n", *i);
+		}
+		catch (std::exception &e) {
+			Log::Logf("Song ID %d: Error loading from cache: %s\n", *i, e.what());
+			delete New;
+			AllLoaded = false;
+		}
     }
+
+    return AllLoaded;
 }
 
 void SongLoader::GetSongList7K(std::vector<VSRG::Song*> &OutVec,std::filesystem::path Dir)
@@ -1,15 +1,55 @@
 #pragma once
 
 class SongDatabase;
+class SongCacheSnapshot;
 
 class SongLoader
 {
     SongDatabase* DB;
+    std::unique_ptr<SongCacheSnapshot> Cache;
+    bool GroupFiles, SeparateBySubtitle;
+
+    // Whether Signature is the one stored for songPath, and the songs that were stored with it.
+    bool GetStoredSignature(std::filesystem::path songPath, const std::string &Signature, std::vector<int> &IDList);
+
+    // Read songs back by ID into VecOut. Returns whether every one of them loaded.
+    bool LoadSongsFromCache(std::filesystem::path SongDirectory, const std::vector<int> &IDList, std::vector<Game::VSRG::Song*> &VecOut);
 
 public:
     SongLoader(SongDatabase* usedDatabase);
+    ~SongLoader();
+
+    // While preloaded, cache checks and loads are answered from a snapshot of the database
+    // rather than a few queries per file. Only for the length of a scan, as the snapshot isn't updated.
+    void PreloadCache();
+    void ReleaseCache();
 
     void LoadSong7KFromDir(std::filesystem::path songPath, std::vector<Game::VSRG::Song*> &VecOut);
+
+    /*
+        The steps of LoadSong7KFromDir, for loading several directories at once.
+        ParseSong7KFromDir doesn't touch the database and may run on any number of threads;
+        the rest use the database and must not run concurrently with each other.
+    */
+    bool IsSongDirectory(const std::vector<std::filesystem::path> &Listing);
+    bool DirectoryNeedsRenewal(const std::vector<std::filesystem::path> &Listing);
+    void LoadSong7KFromCache(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing, std::vector<Game::VSRG::Song*> &VecOut);
+    void ParseSong7KFromDir(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing, std::vector<Game::VSRG::Song*> &VecOut);
+    void PushSong7KToDatabase(Game::VSRG::Song *Song);
+
+    /*
+        A digest of the directory's time and every chart's name, size and time. While it matches the one
+        stored with the directory's songs, LoadSong7KFromSignature reads them back with one lookup rather
+        than checking each file. Store it once the songs are in the database.
+    */
+    std::string GetDirectorySignature(std::filesystem::path songPath, const std::vector<std::filesystem::path> &Listing);
+    bool IsDirectoryCurrent(std::filesystem::path songPath, const std::string &Signature);
+    bool LoadSong7KFromSignature(std::filesystem::path songPath, const std::string &Signature, std::vector<Game::VSRG::Song*> &VecOut);
+    void StoreDirectorySignature(std::filesystem::path songPath, const std::string &Signature, const std::vector<Game::VSRG::Song*> &Songs);
+
+    // The song directories the cache has under Dir, and dropping Dir from it once it's gone.
+    std::vector<std::filesystem::path> GetCachedDirectories(std::filesystem::path Dir);
+    void ForgetDirectory(std::filesystem::path Dir);
     void GetSongList7K(std::vector<Game::VSRG::Song*> &OutVec, std::filesystem::path Dir);
     std::shared_ptr<Game::VSRG::Song> LoadFromMeta(const Game::VSRG::Song* Meta, std::shared_ptr<Game::VSRG::Difficulty> CurrentDiff, std::filesystem::path& FilenameOut, uint8_t& Index);
 };
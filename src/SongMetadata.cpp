@@ -0,0 +1,147 @@
+#include "pch.h"
+
+#include "Logging.h"
+#include "Song7K.h"
+#include "SongDatabase.h"
+#include "SongMetadata.h"
+
+// Enough to cover what's on screen, so those aren't read again every frame.
+const size_t KeptSongs = 64;
+
+namespace
+{
+	std::mutex InternMutex;
+	std::unordered_set<std::string> Interned;
+
+	// Strings are never taken out, so the pointer stays good.
+	const std::string* Intern(const std::string &Str)
+	{
+		std::unique_lock<std::mutex> lock(InternMutex);
+		return &*Interned.insert(Str).first;
+	}
+
+	std::mutex KeptMutex;
+	std::deque<std::shared_ptr<Game::VSRG::Song>> Kept;
+
+	// Most recently asked for first.
+	void Keep(std::shared_ptr<Game::VSRG::Song> Song)
+	{
+		std::unique_lock<std::mutex> lock(KeptMutex);
+
+		auto Found = std::find(Kept.begin(), Kept.end(), Song);
+		if (Found != Kept.end())
+			Kept.erase(Found);
+
+		Kept.push_front(Song);
+		if (Kept.size() > KeptSongs)
+			Kept.pop_back();
+	}
+}
+
+SongMetadata::SongMetadata(SongDatabase* source, const std::vector<std::pair<std::filesystem::path, std::vector<int>>> &SongDirectories,
+	const std::unordered_map<int, SongSummary> &Summaries)
+{
+	Source = source;
+
+	for (auto &Dir : SongDirectories)
+	{
+		Directories.push_back(Dir.first);
+
+		for (auto ID : Dir.second)
+		{
+			auto Found = Summaries.find(ID);
+			if (Found == Summaries.end() || !Found->second.Difficulties)
+				continue;
+
+			auto &Summary = Found->second;
+
+			DirectoryIndex.push_back(Directories.size() - 1);
+			IDs.push_back(ID);
+			Titles.push_back(Intern(Summary.Title));
+			Authors.push_back(Intern(Summary.Author));
+			Lengths.push_back(Summary.Length);
+			MaxNPS.push_back(Summary.MaxNPS);
+			MinLevels.push_back(Summary.MinLevel);
+			MaxLevels.push_back(Summary.MaxLevel);
+			Keys.push_back(Summary.Keys);
+		}
+	}
+
+	Songs.resize(IDs.size());
+}
+
+SongMetadata::Row SongMetadata::GetRowCount() const
+{
+	return IDs.size();
+}
+
+int SongMetadata::GetID(Row R) const
+{
+	return IDs[R];
+}
+
+const std::filesystem::path& SongMetadata::GetDirectory(Row R) const
+{
+	return Directories[DirectoryIndex[R]];
+}
+
+const std::string& SongMetadata::GetTitle(Row R) const
+{
+	return *Titles[R];
+}
+
+const std::string& SongMetadata::GetAuthor(Row R) const
+{
+	return *Authors[R];
+}
+
+float SongMetadata::GetLength(Row R) const
+{
+	return Lengths[R];
+}
+
+int SongMetadata::GetMinLevel(Row R) const
+{
+	return MinLevels[R];
+}
+
+int SongMetadata::GetMaxLevel(Row R) const
+{
+	return MaxLevels[R];
+}
+
+float SongMetadata::GetMaxNPS(Row R) const
+{
+	return MaxNPS[R];
+}
+
+int SongMetadata::GetKeys(Row R) const
+{
+	return Keys[R];
+}
+
+std::shared_ptr<Game::VSRG::Song> SongMetadata::GetSong(Row R)
+{
+	std::unique_lock<std::mutex> lock(SongMutex);
+	auto Song = Songs[R].lock();
+
+	if (!Song)
+	{
+		Song = std::make_shared<Game::VSRG::Song>();
+
+		try {
+			Source->GetSongInformation(IDs[R], Song.get());
+		}
+		catch (std::exception &e) {
+			// What was read still gives a song to show.
+			Log::Printf("SongMetadata: Song ID %d: Error loading from cache: %s\n", IDs[R], e.what());
+		}
+
+		Song->SongDirectory = GetDirectory(R);
+		Songs[R] = Song;
+	}
+
+	lock.unlock();
+	Keep(Song);
+	return Song;
+}
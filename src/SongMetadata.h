@@ -0,0 +1,55 @@
+#pragma once
+
+class SongDatabase;
+struct SongSummary;
+
+namespace Game {
+	namespace VSRG
+	{
+		class Song;
+	}
+}
+
+/*
+	What song select lists and sorts songs by, for songs that haven't been loaded: a column per field,
+	with titles and authors interned so each is kept once however many songs share it.
+	A table is filled as it's made and not changed after, so lists and their copies share it without locking.
+	GetSong reads a song from the cache as it's asked for; the ones asked for last are kept loaded.
+*/
+class SongMetadata
+{
+	SongDatabase* Source;
+
+	std::vector<std::filesystem::path> Directories;
+	std::vector<uint32_t> DirectoryIndex;
+	std::vector<int> IDs;
+	std::vector<const std::string*> Titles, Authors;
+	std::vector<float> Lengths, MaxNPS;
+	std::vector<int> MinLevels, MaxLevels;
+	std::vector<uint8_t> Keys;
+
+	std::mutex SongMutex;
+	std::vector<std::weak_ptr<Game::VSRG::Song>> Songs;
+
+public:
+	typedef uint32_t Row;
+
+	// A row for each song in SongDirectories that's in Summaries with a difficulty; the rest are left out.
+	// Source is where GetSong reads songs from.
+	SongMetadata(SongDatabase* Source, const std::vector<std::pair<std::filesystem::path, std::vector<int>>> &SongDirectories,
+		const std::unordered_map<int, SongSummary> &Summaries);
+
+	Row GetRowCount() const;
+
+	int GetID(Row R) const;
+	const std::filesystem::path& GetDirectory(Row R) const;
+	const std::string& GetTitle(Row R) const;
+	const std::string& GetAuthor(Row R) const;
+	float GetLength(Row R) const;
+	int GetMinLevel(Row R) const;
+	int GetMaxLevel(Row R) const;
+	float GetMaxNPS(Row R) const;
+	int GetKeys(Row R) const;
+
+	std::shared_ptr<Game::VSRG::Song> GetSong(Row R);
+};
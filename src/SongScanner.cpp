@@ -0,0 +1,397 @@
+#include "pch.h"
+
+#include "GameGlobal.h"
+#include "Logging.h"
+#include "Song.h"
+#include "Song7K.h"
+#include "SongLoader.h"
+#include "SongScanner.h"
+
+CfgVar SongScanThreads("SongScanThreads");
+
+SongScanner::SongScanner(SongLoader* loader, std::mutex &listMutex, bool preload)
+	: ListMutex(listMutex)
+{
+	Loader = loader;
+	Preload = preload;
+	Queued = 0;
+	Unfinished = 0;
+	NextWrite = 0;
+	Stop = false;
+
+	int Threads = SongScanThreads > 0 ? int(SongScanThreads) : int(std::thread::hardware_concurrency());
+
+	Checker = std::thread(&SongScanner::Check, this);
+	Writer = std::thread(&SongScanner::Write, this);
+	for (int i = 0; i < std::max(Threads, 1); i++)
+		Workers.push_back(std::thread(&SongScanner::Parse, this));
+}
+
+SongScanner::~SongScanner()
+{
+	Finish();
+
+	QueueMutex.lock();
+	Stop = true;
+	QueueMutex.unlock();
+
+	CheckCondition.notify_all();
+	ParseCondition.notify_all();
+	WriteCondition.notify_all();
+
+	Checker.join();
+	Writer.join();
+	for (auto &t : Workers)
+		t.join();
+
+	Loader->ReleaseCache();
+}
+
+void SongScanner::AddNamedDirectory(SongList* Parent, std::filesystem::path Dir, std::string Name)
+{
+	// filesystem throws with nonexisting directories
+	if (!std::filesystem::exists(Dir)) return;
+
+	SongList* NewList = new SongList(Parent);
+	NewList->SetDirectory(std::filesystem::absolute(Dir));
+
+	PendingDirectory Pending;
+	Pending.Parent = Parent;
+	Pending.Entry.EntryName = Name;
+	Pending.Entry.Kind = ListEntry::Directory;
+	Pending.Entry.Data = std::shared_ptr<void>(NewList);
+
+	{
+		std::unique_lock<std::mutex> lock(ListMutex);
+		PendingDirectories[NewList] = Pending;
+	}
+
+	for (auto &i : std::filesystem::directory_iterator(Dir))
+	{
+		if (!std::filesystem::is_directory(i.path())) continue;
+
+		auto Listing = Utility::GetFileListing(i.path());
+
+		// No charts, so, time to recursively search.
+		if (!Loader->IsSongDirectory(Listing))
+		{
+			AddNamedDirectory(NewList, i.path(), Utility::ToU8(i.path().filename().wstring()));
+			continue;
+		}
+
+		QueueJob(NewList, i.path(), std::move(Listing), false);
+	}
+}
+
+void SongScanner::RefreshDirectory(SongList* Parent, std::filesystem::path Dir, std::string Name)
+{
+	Dir = std::filesystem::absolute(Dir);
+
+	if (!std::filesystem::is_directory(Dir))
+	{
+		{
+			std::unique_lock<std::mutex> lock(ListMutex);
+			Parent->RemoveDirectory(Dir);
+		}
+
+		std::unique_lock<std::mutex> dblock(DatabaseMutex);
+		Loader->ForgetDirectory(Dir);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(ListMutex);
+		if (!Parent->IsPopulated())
+		{
+			lock.unlock();
+			ValidateDirectory(Parent, Dir);
+			return;
+		}
+	}
+
+	auto Listing = Utility::GetFileListing(Dir);
+	if (Loader->IsSongDirectory(Listing))
+	{
+		QueueJob(Parent, Dir, std::move(Listing), true);
+		return;
+	}
+
+	std::shared_ptr<SongList> Existing;
+	std::set<std::filesystem::path> Gone;
+	{
+		std::unique_lock<std::mutex> lock(ListMutex);
+		Parent->RemoveSongsFrom(Dir);
+
+		Existing = Parent->GetDirectoryEntry(Dir);
+		if (Existing && Existing->IsPopulated())
+			Gone = Existing->RemoveMissing();
+	}
+
+	if (Gone.size())
+	{
+		std::unique_lock<std::mutex> dblock(DatabaseMutex);
+		for (auto &Missing : Gone)
+			Loader->ForgetDirectory(Missing);
+	}
+
+	if (!Existing)
+	{
+		AddNamedDirectory(Parent, Dir, Name);
+		return;
+	}
+
+	if (!Existing->IsPopulated())
+	{
+		ValidateDirectory(Existing.get(), Dir);
+		return;
+	}
+
+	for (auto &i : std::filesystem::directory_iterator(Dir))
+	{
+		if (std::filesystem::is_directory(i.path()))
+			RefreshDirectory(Existing.get(), i.path(), Utility::ToU8(i.path().filename().wstring()));
+	}
+}
+
+void SongScanner::ValidateDirectory(SongList* List, std::filesystem::path Dir)
+{
+	std::set<std::filesystem::path> SongDirectories;
+	ValidateTree(List, Dir, SongDirectories);
+
+	std::unique_lock<std::mutex> dblock(DatabaseMutex);
+	for (auto &Cached : Loader->GetCachedDirectories(Dir))
+	{
+		if (!SongDirectories.count(Cached))
+			Loader->ForgetDirectory(Cached);
+	}
+}
+
+void SongScanner::ValidateTree(SongList* List, std::filesystem::path Dir, std::set<std::filesystem::path> &SongDirectories)
+{
+	auto Listing = Utility::GetFileListing(Dir);
+	if (Loader->IsSongDirectory(Listing))
+	{
+		SongDirectories.insert(Dir);
+		QueueJob(List, Dir, std::move(Listing), false, true);
+		return;
+	}
+
+	for (auto &i : std::filesystem::directory_iterator(Dir))
+	{
+		if (std::filesystem::is_directory(i.path()))
+			ValidateTree(List, std::filesystem::absolute(i.path()), SongDirectories);
+	}
+}
+
+void SongScanner::QueueJob(SongList* List, std::filesystem::path Dir, std::vector<std::filesystem::path> Listing, bool Replace, bool CacheOnly)
+{
+	auto Job = std::make_unique<ScanJob>();
+	Job->Directory = Dir;
+	Job->Listing = std::move(Listing);
+	Job->List = List;
+	Job->Parsed = false;
+	Job->Replace = Replace;
+	Job->CacheOnly = CacheOnly;
+
+	std::unique_lock<std::mutex> lock(QueueMutex);
+	Job->Sequence = Queued++;
+	CheckJobs.push_back(std::move(Job));
+	Unfinished++;
+	CheckCondition.notify_one();
+}
+
+void SongScanner::Finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		DoneCondition.wait(lock, [&]() { return Unfinished == 0; });
+	}
+
+	// Whatever's still pending never got a song.
+	std::unique_lock<std::mutex> lock(ListMutex);
+	PendingDirectories.clear();
+}
+
+void SongScanner::Check()
+{
+	// Read the cache in bulk while the directories are walked, rather than a few queries per file.
+	if (Preload)
+	{
+		std::unique_lock<std::mutex> dblock(DatabaseMutex);
+		Loader->PreloadCache();
+	}
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		CheckCondition.wait(lock, [&]() { return Stop || !CheckJobs.empty(); });
+
+		if (CheckJobs.empty())
+			return;
+
+		auto Job = std::move(CheckJobs.front());
+		CheckJobs.pop_front();
+		lock.unlock();
+
+		bool Renew = false;
+		try
+		{
+			// Only stats files, so it's done before taking the database.
+			Job->Signature = Loader->GetDirectorySignature(Job->Directory, Job->Listing);
+
+			std::unique_lock<std::mutex> dblock(DatabaseMutex);
+
+			// Nothing's been read from here yet, so if the cache is current there's nothing to do.
+			if (Job->CacheOnly && Loader->IsDirectoryCurrent(Job->Directory, Job->Signature))
+				Job->Signature.clear();
+			else if (Loader->LoadSong7KFromSignature(Job->Directory, Job->Signature, Job->Songs))
+				Job->Signature.clear();
+			else
+			{
+				Renew = Loader->DirectoryNeedsRenewal(Job->Listing);
+				if (!Renew)
+					Loader->LoadSong7KFromCache(Job->Directory, Job->Listing, Job->Songs);
+			}
+		}
+		catch (std::exception &e)
+		{
+			Log::LogPrintf("SongScanner: Error checking %s: %s\n", Utility::ToU8(Job->Directory.wstring()).c_str(), e.what());
+			Job->Signature.clear();
+		}
+
+		lock.lock();
+		if (Renew)
+		{
+			ParseJobs.push_back(std::move(Job));
+			ParseCondition.notify_one();
+		}
+		else
+		{
+			WriteJobs.push_back(std::move(Job));
+			WriteCondition.notify_one();
+		}
+	}
+}
+
+void SongScanner::Parse()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		ParseCondition.wait(lock, [&]() { return Stop || !ParseJobs.empty(); });
+
+		if (ParseJobs.empty())
+			return;
+
+		auto Job = std::move(ParseJobs.front());
+		ParseJobs.pop_front();
+		lock.unlock();
+
+		try
+		{
+			Loader->ParseSong7KFromDir(Job->Directory, Job->Listing, Job->Songs);
+			Job->Parsed = true;
+		}
+		catch (std::exception &e)
+		{
+			Log::LogPrintf("SongScanner: Error loading %s: %s\n", Utility::ToU8(Job->Directory.wstring()).c_str(), e.what());
+			Job->Signature.clear();
+		}
+
+		lock.lock();
+		WriteJobs.push_back(std::move(Job));
+		WriteCondition.notify_one();
+	}
+}
+
+void SongScanner::Write()
+{
+	while (true)
+	{
+		std::deque<std::unique_ptr<ScanJob>> Jobs;
+
+		{
+			std::unique_lock<std::mutex> lock(QueueMutex);
+			WriteCondition.wait(lock, [&]() { return Stop || !WriteJobs.empty(); });
+
+			if (WriteJobs.empty())
+				return;
+
+			// Take everything that's done, so the lists are locked once per batch rather than per directory.
+			for (auto &Job : WriteJobs)
+				Finished[Job->Sequence] = std::move(Job);
+			WriteJobs.clear();
+		}
+
+		// Workers finish out of order; hold on to what's ahead of a directory still being parsed.
+		while (Finished.size() && Finished.begin()->first == NextWrite)
+		{
+			Jobs.push_back(std::move(Finished.begin()->second));
+			Finished.erase(Finished.begin());
+			NextWrite++;
+		}
+
+		if (Jobs.empty())
+			continue;
+
+		{
+			std::unique_lock<std::mutex> dblock(DatabaseMutex);
+			for (auto &Job : Jobs)
+			{
+				if (Job->Parsed)
+				{
+					for (auto Song : Job->Songs)
+						Loader->PushSong7KToDatabase(Song);
+				}
+
+				Loader->StoreDirectorySignature(Job->Directory, Job->Signature, Job->Songs);
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(ListMutex);
+			for (auto &Job : Jobs)
+			{
+				if (Job->CacheOnly)
+				{
+					// Skip directories that are still as they were cached.
+					bool Changed = Job->Parsed || Job->Songs.size();
+					if (!Changed || !Job->List->UpdateFromCache(std::filesystem::absolute(Job->Directory), Job->Songs))
+					{
+						for (auto Song : Job->Songs)
+							delete Song;
+					}
+					continue;
+				}
+
+				if (Job->Replace)
+					Job->List->RemoveDirectory(std::filesystem::absolute(Job->Directory));
+
+				for (auto Song : Job->Songs)
+					Job->List->AddSong(std::shared_ptr<Game::Song>(Song));
+
+				if (Job->Songs.size())
+					LinkDirectory(Job->List);
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		Unfinished -= Jobs.size();
+		if (!Unfinished)
+			DoneCondition.notify_all();
+	}
+}
+
+void SongScanner::LinkDirectory(SongList* List)
+{
+	auto Pending = PendingDirectories.find(List);
+
+	while (Pending != PendingDirectories.end())
+	{
+		auto Parent = Pending->second.Parent;
+		Parent->AddEntry(Pending->second.Entry);
+		PendingDirectories.erase(Pending);
+
+		Pending = PendingDirectories.find(Parent);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "SongList.h"
+
+class SongLoader;
+
+/*
+	Fills song lists from song directories in stages. The calling thread walks the directories,
+	one thread checks each song directory against the cache and reads it back from there if it's current,
+	the workers parse the charts of the ones that aren't, and one thread writes those to the database and
+	puts every song in its list. Only the checker and the writer use the database, and never at the same time.
+	Directories are written in the order they were queued, whichever worker finishes first, so a list comes out
+	the same as a serial scan would have it.
+*/
+class SongScanner
+{
+	struct ScanJob
+	{
+		size_t Sequence; // Order it was queued in.
+		std::filesystem::path Directory;
+		std::vector<std::filesystem::path> Listing;
+		SongList* List;
+		std::vector<Game::VSRG::Song*> Songs;
+		bool Parsed;
+		bool Replace; // Take out the songs List had from Directory first.
+		bool CacheOnly; // List hasn't been read from the cache, so only the cache is brought up to date.
+		std::string Signature; // Stored with the songs once they're in the database; empty if there's nothing to store.
+	};
+
+	// A directory that's only added to its parent once a song turns up in it or under it.
+	struct PendingDirectory
+	{
+		SongList* Parent;
+		ListEntry Entry;
+	};
+
+	SongLoader* Loader;
+	bool Preload;
+	std::mutex &ListMutex;
+	std::mutex DatabaseMutex;
+
+	// Guarded by ListMutex.
+	std::map<SongList*, PendingDirectory> PendingDirectories;
+
+	// Shared with the stages.
+	std::mutex QueueMutex;
+	std::condition_variable CheckCondition, ParseCondition, WriteCondition, DoneCondition;
+	std::deque<std::unique_ptr<ScanJob>> CheckJobs, ParseJobs, WriteJobs;
+	size_t Queued, Unfinished;
+	bool Stop;
+
+	// Only the writer touches these: jobs that finished ahead of an earlier one, and the next one to write.
+	std::map<size_t, std::unique_ptr<ScanJob>> Finished;
+	size_t NextWrite;
+
+	std::thread Checker, Writer;
+	std::vector<std::thread> Workers;
+
+	void Check();
+	void Parse();
+	void Write();
+	void LinkDirectory(SongList* List);
+	void QueueJob(SongList* List, std::filesystem::path Dir, std::vector<std::filesystem::path> Listing, bool Replace, bool CacheOnly = false);
+
+	// RefreshDirectory for a Dir under a List that hasn't been read from the cache: directories that are
+	// as they were cached are left alone, the rest are loaded into the cache, and ones that are gone are dropped from it.
+	void ValidateDirectory(SongList* List, std::filesystem::path Dir);
+	void ValidateTree(SongList* List, std::filesystem::path Dir, std::set<std::filesystem::path> &SongDirectories);
+
+public:
+	// ListMutex guards the lists songs are added to. Preload reads the whole cache up front, which pays off
+	// for whole libraries but not for a few directories.
+	SongScanner(SongLoader* Loader, std::mutex &ListMutex, bool Preload = true);
+	~SongScanner();
+
+	// Walk Dir on the calling thread and queue every song directory under it. Like SongList::AddNamedDirectory,
+	// Dir shows up in Parent as a directory called Name, but only once it has a song.
+	void AddNamedDirectory(SongList* Parent, std::filesystem::path Dir, std::string Name);
+
+	// Bring what Parent has from Dir up to date with the disk, in place: song directories are loaded again,
+	// new directories are added and anything that's gone is taken out.
+	void RefreshDirectory(SongList* Parent, std::filesystem::path Dir, std::string Name);
+
+	// Wait until every song directory queued so far is in its list.
+	void Finish();
+};
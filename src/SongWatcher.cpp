@@ -0,0 +1,234 @@
+#include "pch.h"
+
+#include "GameGlobal.h"
+#include "Logging.h"
+#include "Song.h"
+#include "Song7K.h"
+#include "SongDatabase.h"
+#include "SongLoader.h"
+#include "SongScanner.h"
+#include "SongWatcher.h"
+
+#ifdef LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Copying a pack in makes a burst of events; wait for it to end before loading anything.
+const auto WatchSettleTime = std::chrono::seconds(2);
+
+namespace
+{
+	bool IsWithin(const std::filesystem::path &Path, const std::filesystem::path &Dir)
+	{
+		auto p = Path.begin();
+		for (auto d = Dir.begin(); d != Dir.end(); ++d, ++p)
+		{
+			if (p == Path.end() || *p != *d)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+SongWatcher::SongWatcher(SongDatabase* db, std::shared_ptr<SongList> root, std::mutex &listMutex, std::function<void()> onRefresh)
+	: ListMutex(listMutex)
+{
+	DB = db;
+	Root = root;
+	OnRefresh = onRefresh;
+	Notify = -1;
+	OutOfWatches = false;
+	Running = false;
+
+#ifdef LINUX
+	std::map<std::string, std::string> Directories;
+	Configuration::GetConfigListS("SongDirectories", Directories, "Songs");
+
+	Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Notify < 0)
+	{
+		Log::LogPrintf("SongWatcher: inotify unavailable, song directories won't be watched.\n");
+		return;
+	}
+
+	for (auto &Dir : Directories)
+	{
+		if (!std::filesystem::is_directory(Dir.second)) continue;
+
+		Libraries[Dir.first] = std::filesystem::absolute(Dir.second);
+		AddWatches(Libraries[Dir.first]);
+	}
+
+	Log::LogPrintf("SongWatcher: Watching %d directories.\n", int(Watches.size()));
+
+	Running = true;
+	Thread = std::thread(&SongWatcher::Run, this);
+#endif
+}
+
+SongWatcher::~SongWatcher()
+{
+	Running = false;
+	if (Thread.joinable())
+		Thread.join();
+
+#ifdef LINUX
+	if (Notify >= 0)
+		close(Notify);
+#endif
+}
+
+void SongWatcher::AddWatches(std::filesystem::path Dir)
+{
+#ifdef LINUX
+	const uint32_t Mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+	int wd = inotify_add_watch(Notify, Dir.c_str(), Mask);
+	if (wd < 0)
+	{
+		// Past fs.inotify.max_user_watches. Say so once; what's watched already still is.
+		if (errno == ENOSPC && !OutOfWatches)
+		{
+			Log::LogPrintf("SongWatcher: Out of inotify watches at %s, the rest won't be watched.\n", Dir.c_str());
+			OutOfWatches = true;
+		}
+		return;
+	}
+
+	Watches[wd] = Dir;
+
+	std::error_code ec;
+	for (auto &i : std::filesystem::directory_iterator(Dir, ec))
+	{
+		if (std::filesystem::is_directory(i.path()))
+			AddWatches(i.path());
+	}
+#endif
+}
+
+void SongWatcher::Run()
+{
+#ifdef LINUX
+	auto LastEvent = std::chrono::steady_clock::now();
+	alignas(inotify_event) char Buffer[16 * 1024];
+
+	while (Running)
+	{
+		pollfd pfd = { Notify, POLLIN, 0 };
+
+		if (poll(&pfd, 1, 250) > 0)
+		{
+			ssize_t Length;
+			while ((Length = read(Notify, Buffer, sizeof Buffer)) > 0)
+			{
+				for (char* p = Buffer; p < Buffer + Length; )
+				{
+					auto Event = reinterpret_cast<inotify_event*>(p);
+					p += sizeof(inotify_event) + Event->len;
+
+					// Events were lost; look over everything.
+					if (Event->mask & IN_Q_OVERFLOW)
+					{
+						for (auto &Library : Libraries)
+							Changed.insert(Library.second);
+						continue;
+					}
+
+					auto Watch = Watches.find(Event->wd);
+					if (Watch == Watches.end())
+						continue;
+
+					if (Event->mask & IN_IGNORED)
+					{
+						Watches.erase(Watch);
+						continue;
+					}
+
+					// A directory coming or going changes that directory; a file, the directory it's in.
+					if (Event->mask & IN_ISDIR)
+					{
+						auto Dir = Watch->second / Event->name;
+						if (Event->mask & (IN_CREATE | IN_MOVED_TO))
+							AddWatches(Dir);
+
+						Changed.insert(Dir);
+					}
+					else
+						Changed.insert(Watch->second);
+				}
+
+				LastEvent = std::chrono::steady_clock::now();
+			}
+		}
+
+		if (Changed.size() && std::chrono::steady_clock::now() - LastEvent >= WatchSettleTime)
+			Refresh();
+	}
+#endif
+}
+
+void SongWatcher::Refresh()
+{
+	SongLoader Loader(DB);
+
+	Log::LogPrintf("SongWatcher: Refreshing %d changed directories.\n", int(Changed.size()));
+	DB->StartTransaction();
+
+	{
+		SongScanner Scanner(&Loader, ListMutex, false);
+		std::filesystem::path Last;
+
+		// The set is sorted, so a directory comes right before everything under it, which its refresh covers.
+		for (auto &Dir : Changed)
+		{
+			if (!Last.empty() && IsWithin(Dir, Last))
+				continue;
+			Last = Dir;
+
+			for (auto &Library : Libraries)
+			{
+				if (!IsWithin(Dir, Library.second))
+					continue;
+
+				try
+				{
+					// Start from the closest directory that's in the list; the ones in between had no songs before.
+					auto Target = Dir;
+					SongList* Parent = nullptr;
+
+					while (Target != Library.second)
+					{
+						std::unique_lock<std::mutex> lock(ListMutex);
+						Parent = Root->FindDirectory(Target.parent_path());
+						if (Parent) break;
+
+						Target = Target.parent_path();
+					}
+
+					if (Parent)
+						Scanner.RefreshDirectory(Parent, Target, Utility::ToU8(Target.filename().wstring()));
+					else
+						Scanner.RefreshDirectory(Root.get(), Library.second, Library.first);
+				}
+				catch (std::exception &e)
+				{
+					// Most likely changed again while we were looking; that queues it once more.
+					Log::LogPrintf("SongWatcher: Error refreshing %s: %s\n", Utility::ToU8(Dir.wstring()).c_str(), e.what());
+				}
+
+				break;
+			}
+		}
+
+		Scanner.Finish();
+	}
+
+	DB->EndTransaction();
+	Changed.clear();
+
+	if (OnRefresh)
+		OnRefresh();
+}
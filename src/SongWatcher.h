@@ -0,0 +1,37 @@
+#pragma once
+
+class SongDatabase;
+class SongList;
+
+/*
+	Watches the song directories and refreshes the directories that changed in the song list,
+	once they've been quiet for a moment, so new or edited songs show up without a full rescan.
+	Uses inotify, so on other platforms it doesn't do anything.
+*/
+class SongWatcher
+{
+	SongDatabase* DB;
+	std::shared_ptr<SongList> Root;
+	std::mutex &ListMutex;
+	std::function<void()> OnRefresh;
+
+	// Name to absolute directory, as in SongDirectories.
+	std::map<std::string, std::filesystem::path> Libraries;
+
+	int Notify;
+	bool OutOfWatches;
+	std::map<int, std::filesystem::path> Watches;
+	std::set<std::filesystem::path> Changed;
+
+	std::atomic<bool> Running;
+	std::thread Thread;
+
+	void Run();
+	void AddWatches(std::filesystem::path Dir);
+	void Refresh();
+
+public:
+	// OnRefresh is called from the watcher's thread after the lists under Root have changed.
+	SongWatcher(SongDatabase* DB, std::shared_ptr<SongList> Root, std::mutex &ListMutex, std::function<void()> OnRefresh);
+	~SongWatcher();
+};
@@ -6,6 +6,8 @@
 #include "Song7K.h"
 #include "GameWindow.h"
 #include "SongLoader.h"
+#include "SongScanner.h"
+#include "SongWatcher.h"
 #include "GraphicalString.h"
 #include "Sprite.h"
 #include "SongWheel.h"
@@ -16,11 +18,16 @@
 
 using namespace Game;
 
+CfgVar NoSongWatch("NoSongWatch");
+CfgVar NoLazySongList("NoLazySongList");
+
 SongWheel::SongWheel()
 {
     IsInitialized = false;
     mLoadMutex = nullptr;
     mLoadThread = nullptr;
+    mWatcher = nullptr;
+    mListChanged = false;
     DifficultyIndex = 0;
 
 	DisplayStartIndex = 0;
@@ -76,12 +83,14 @@ class LoadThread
     SongDatabase* DB;
     std::shared_ptr<SongList> ListRoot;
     std::atomic<bool>& isLoading;
+    std::atomic<bool>& listChanged;
 public:
-    LoadThread(std::mutex* m, SongDatabase* d, std::shared_ptr<SongList> r, std::atomic<bool>& loadingstatus)
+    LoadThread(std::mutex* m, SongDatabase* d, std::shared_ptr<SongList> r, std::atomic<bool>& loadingstatus, std::atomic<bool>& changed)
         : mLoadMutex(m),
         DB(d),
         ListRoot(r),
-        isLoading(loadingstatus)
+        isLoading(loadingstatus),
+        listChanged(changed)
     {
         isLoading = true;
     }
@@ -93,17 +102,46 @@ public:
         Configuration::GetConfigListS("SongDirectories", Directories, "Songs");
 
         SongLoader Loader(DB);
+        bool Lazy = !NoLazySongList;
 
         Log::Printf("Started loading songs..\n");
-        DB->StartTransaction();
 
-        for (auto i = Directories.begin();
-        i != Directories.end();
-            ++i)
+        // What's cached can be browsed right away; each directory is read as it's opened.
+        // The scan then only has to look at what changed since.
+        if (Lazy)
+        {
+            std::unique_lock<std::mutex> lock(*mLoadMutex);
+            for (auto &Dir : Directories)
+            {
+                if (std::filesystem::exists(Dir.second))
+                    ListRoot->AddCachedDirectory(DB, Dir.second, Dir.first);
+            }
+
+            listChanged = true;
+        }
+
+        DB->StartTransaction();
 
         {
-            ListRoot->AddNamedDirectory(*mLoadMutex, &Loader, i->second, i->first);
-			SongWheel::GetInstance().ReapplyFilters();
+            // Reading the whole cache up front is what a lazy list avoids.
+            SongScanner Scanner(&Loader, *mLoadMutex, !Lazy);
+
+            for (auto i = Directories.begin();
+            i != Directories.end();
+                ++i)
+
+            {
+                if (!std::filesystem::exists(i->second))
+                    continue;
+
+                if (Lazy)
+                    Scanner.RefreshDirectory(ListRoot.get(), i->second, i->first);
+                else
+                    Scanner.AddNamedDirectory(ListRoot.get(), i->second, i->first);
+
+                Scanner.Finish();
+                listChanged = true;
+            }
         }
 
         DB->EndTransaction();
@@ -122,9 +160,16 @@ void SongWheel::Join()
     }
 }
 
+void SongWheel::StopWatching()
+{
+    delete mWatcher;
+    mWatcher = nullptr;
+}
+
 void SongWheel::ReloadSongs(SongDatabase* Database)
 {
     DB = Database;
+    StopWatching();
     Join();
 
     ListRoot = std::make_shared<SongList>();
@@ -133,7 +178,7 @@ void SongWheel::ReloadSongs(SongDatabase* Database)
     if (!mLoadMutex)
         mLoadMutex = new std::mutex;
 
-    LoadThread L(mLoadMutex, DB, ListRoot, mLoading);
+    LoadThread L(mLoadMutex, DB, ListRoot, mLoading, mListChanged);
     mLoadThread = new std::thread(&LoadThread::Load, L);
 }
 
@@ -322,6 +367,16 @@ void SongWheel::Update(float Delta)
         mLoadThread->join();
         delete mLoadThread;
         mLoadThread = nullptr;
+
+        // From here on, pick up songs as they're added or changed.
+        if (!NoSongWatch && !mWatcher)
+            mWatcher = new SongWatcher(DB, ListRoot, *mLoadMutex, [this]() { mListChanged = true; });
+    }
+
+    if (mListChanged.exchange(false))
+    {
+        std::unique_lock<std::mutex> lock(*mLoadMutex);
+        ReapplyFilters();
     }
 
     if (!CurrentList)
@@ -511,10 +566,15 @@ void SongWheel::ConfirmSelection()
     }
     else
     {
-        CurrentList = CurrentList->GetListEntry(SelectedBoundItem).get();
-		CurrentList->SetInUse(true);
+        {
+            // Opening a list may read it from the cache, which the scan could be adding to.
+            std::unique_lock<std::mutex> lock(*mLoadMutex);
+            CurrentList = CurrentList->GetListEntry(SelectedBoundItem).get();
+            CurrentList->SetInUse(true);
+
+            ReapplyFilters();
+        }
 
-		ReapplyFilters();
         SetSelectedItem(SelectedUnboundItem); // Update our selected item to new bounderies.
         OnSongTentativeSelect(GetSelectedSong(), DifficultyIndex);
     }
@@ -550,8 +610,7 @@ void Game::SongWheel::ReapplyFilters()
 		bool add = true;
 
 		if (entry.Kind == ListEntry::Song) {
-			auto song = std::static_pointer_cast<Game::Song>(entry.Data);
-			if (!GameState::GetInstance().IsSongUnlocked(song.get()))
+			if (!GameState::GetInstance().IsSongUnlocked(entry.GetSongID()))
 				continue;
 		}
 
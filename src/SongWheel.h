@@ -11,6 +11,7 @@ namespace Game {
 class BitmapFont;
 class Sprite;
 class SongDatabase;
+class SongWatcher;
 class TruetypeFont;
 class LuaManager;
 class GraphicalString;
@@ -49,6 +50,9 @@ namespace Game
         std::thread* mLoadThread;
         std::atomic<bool> mLoading;
 
+        SongWatcher* mWatcher;
+        std::atomic<bool> mListChanged; // The watcher changed the lists; filter them again on the main thread.
+
         SongDatabase* DB;
 
         std::shared_ptr<SongList> ListRoot;
@@ -107,6 +111,9 @@ namespace Game
 
         void Join();
 
+        // Stop picking up changes to the song directories. Done before shutting down.
+        void StopWatching();
+
         bool HandleInput(int32_t key, KeyEventType code, bool isMouseInput);
         bool HandleScrollInput(const double dx, const double dy);
         std::shared_ptr<VSRG::Song> GetSelectedSong();
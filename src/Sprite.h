@@ -43,6 +43,7 @@ private: // Transformations
     Texture* mTexture;
 
     void Construct(bool doInitTexture);
+    friend class SpriteBatch;
 protected:
 	Renderer::Shader *mShader;
     VBO *UvBuffer;
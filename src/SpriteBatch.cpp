@@ -0,0 +1,155 @@
+#include "pch.h"
+
+#include "Rendering.h"
+#include "Sprite.h"
+#include "SpriteBatch.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "VBO.h"
+
+SpriteBatch::SpriteBatch()
+{
+	mBuffer = nullptr;
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	delete mBuffer;
+}
+
+bool SpriteBatch::CanBatch(const Sprite& sprite)
+{
+	return sprite.mTexture && !sprite.mShader && !sprite.ColorInvert && !sprite.BlackToTransparent;
+}
+
+void SpriteBatch::Add(Sprite& sprite)
+{
+	if (sprite.Alpha == 0)
+		return;
+
+	if (!CanBatch(sprite))
+	{
+		Run r = { nullptr, 0, &sprite, 0, 0 };
+		mRuns.push_back(r);
+		return;
+	}
+
+	if (mRuns.empty() || mRuns.back().Single ||
+		mRuns.back().Image != sprite.mTexture || mRuns.back().BlendMode != sprite.BlendingMode)
+	{
+		Run r = { sprite.mTexture, sprite.BlendingMode, nullptr, uint32_t(mVertices.size()), 0 };
+		mRuns.push_back(r);
+	}
+
+	// Same as the shader and the colour uniform do for a single sprite.
+	float r = sprite.Red, g = sprite.Green, b = sprite.Blue;
+	if (sprite.Lighten)
+	{
+		auto lf = 1.0f + sprite.LightenFactor;
+		r *= lf; g *= lf; b *= lf;
+	}
+
+	r = l2gamma(r); g = l2gamma(g); b = l2gamma(b);
+
+	// Sprites that don't own their UVs use the default, whole-image ones.
+	float u1 = 0, v1 = 0, u2 = 1, v2 = 1;
+	if (sprite.DoTextureCleanup)
+	{
+		u1 = sprite.mCrop_x1; v1 = sprite.mCrop_y1;
+		u2 = sprite.mCrop_x2; v2 = sprite.mCrop_y2;
+	}
+
+	auto &mat = sprite.GetMatrix();
+	float offset = sprite.Centered ? -0.5f : 0;
+
+	// Corners in the order of the default quad, as two triangles of the fan.
+	const float corners[4][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { 0, 0 } };
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+
+	for (auto i : order)
+	{
+		auto p = mat * glm::vec4(corners[i][0] + offset, corners[i][1] + offset, 0, 1);
+
+		Vertex vtx = {
+			p.x, p.y, p.z,
+			u1 + (u2 - u1) * corners[i][0], v1 + (v2 - v1) * corners[i][1],
+			r, g, b, sprite.Alpha
+		};
+
+		mVertices.push_back(vtx);
+	}
+
+	mRuns.back().Count += 6;
+}
+
+void SpriteBatch::Upload()
+{
+	if (mVertices.empty())
+		return;
+
+	if (!mBuffer || mBuffer->GetElementCount() < mVertices.size())
+	{
+		uint32_t capacity = mBuffer ? mBuffer->GetElementCount() : 1024;
+		while (capacity < mVertices.size())
+			capacity *= 2;
+
+		delete mBuffer;
+		mBuffer = new VBO(VBO::Stream, capacity, sizeof(Vertex));
+		mVertices.reserve(capacity);
+	}
+
+	// AssignData copies the whole buffer.
+	mVertices.resize(mBuffer->GetElementCount());
+	mBuffer->Validate();
+	mBuffer->AssignData(mVertices.data());
+}
+
+void SpriteBatch::Render()
+{
+	using namespace Renderer;
+
+	Upload();
+
+	// Positions are already on screen space, colours are per vertex.
+	auto identity = glm::mat4(1.0f);
+	bool stateSet = false;
+
+	for (auto &run : mRuns)
+	{
+		if (run.Single)
+		{
+			run.Single->Render();
+			stateSet = false;
+			continue;
+		}
+
+		run.Image->Bind();
+		if (!run.Image->IsBound())
+			continue;
+
+		if (!stateSet)
+		{
+			SetShaderParameters(false, false, false);
+			DefaultShader::SetColor(1, 1, 1, 1);
+			SetCurrentObjectMatrix(identity);
+
+			mBuffer->Bind();
+			glVertexAttribPointer(Shader::EnableAttribArray(DefaultShader::GetUniform(A_POSITION)), 3, GL_FLOAT, GL_FALSE,
+				sizeof(Vertex), (void*)offsetof(Vertex, x));
+			glVertexAttribPointer(Shader::EnableAttribArray(DefaultShader::GetUniform(A_UV)), 2, GL_FLOAT, GL_FALSE,
+				sizeof(Vertex), (void*)offsetof(Vertex, u));
+			glVertexAttribPointer(Shader::EnableAttribArray(DefaultShader::GetUniform(A_COLOR)), 4, GL_FLOAT, GL_FALSE,
+				sizeof(Vertex), (void*)offsetof(Vertex, r));
+			stateSet = true;
+		}
+
+		SetBlendingMode(EBlendMode(run.BlendMode));
+		glDrawArrays(GL_TRIANGLES, run.First, run.Count);
+	}
+
+	if (stateSet)
+		FinalizeDraw();
+
+	mVertices.clear();
+	mRuns.clear();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+class VBO;
+class Sprite;
+class Texture;
+
+/*
+	Draws many sprites with few draw calls.
+	Quads are transformed on the CPU and written to a single vertex buffer with their colour,
+	then every run of consecutive sprites sharing a texture and blend mode is one draw.
+	Sprites are drawn in the order they were added.
+*/
+class SpriteBatch
+{
+	struct Vertex
+	{
+		float x, y, z;
+		float u, v;
+		float r, g, b, a;
+	};
+
+	struct Run
+	{
+		Texture* Image;
+		int BlendMode;
+		Sprite* Single; // Drawn on its own through Sprite::Render.
+		uint32_t First, Count;
+	};
+
+	std::vector<Vertex> mVertices;
+	std::vector<Run> mRuns;
+	VBO* mBuffer;
+
+	void Upload();
+public:
+	SpriteBatch();
+	~SpriteBatch();
+
+	// Can this sprite go in a run, or does it need its own shader state?
+	static bool CanBatch(const Sprite& sprite);
+
+	void Add(Sprite& sprite);
+	void Render();
+};
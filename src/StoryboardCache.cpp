@@ -0,0 +1,323 @@
+#include "pch.h"
+
+#include "Logging.h"
+#include "Song.h"
+#include "BackgroundAnimation.h"
+#include "osuBackgroundAnimation.h"
+#include "StoryboardCache.h"
+#include "MappedFile.h"
+
+CfgVar StoryboardCacheEnabled("StoryboardCache");
+CfgVar StoryboardCacheMessages("StoryboardCache", "Debug");
+
+namespace StoryboardCache
+{
+	const char CacheDirectory[] = "StoryboardCache";
+	const uint32_t CacheMagic = 0x42534452; // "RDSB"
+	const uint32_t CacheVersion = 3;
+
+	// Small storyboards parse fast enough. Keeps us from writing a file for every .osu's background.
+	const size_t MinimumSprites = 16;
+
+	// Charts sharing a storyboard can be stored from several parse threads at once.
+	std::atomic<uint32_t> TempFiles(0);
+
+	/*
+		Layout:
+		CacheHeader
+		uint32_t StringOffsets[StringCount + 1]
+		char Strings[StringBytes], padded to 4 bytes
+		PackedSprite Sprites[SpriteCount]
+		PackedGroup Groups[GroupCount]
+		osb::PackedEvent Events[EventCount]
+	*/
+	struct CacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t SpriteCount;
+		uint32_t StringCount;
+		uint32_t StringBytes;
+		uint32_t GroupCount;
+		uint32_t EventCount;
+	};
+
+	struct PackedSprite
+	{
+		uint32_t Image;
+		int32_t Origin;
+		int32_t Layer;
+		float X, Y;
+		uint32_t First[osb::EVT_COUNT];
+		uint32_t Count[osb::EVT_COUNT];
+		uint32_t FirstGroup, GroupCount;
+	};
+
+	// A sprite's loop or trigger.
+	struct PackedGroup
+	{
+		int32_t Type; // EVT_LOOP or EVT_TRIGGER
+		int32_t LoopCount;
+		int32_t Trigger, TriggerGroup;
+		float Time, EndTime;
+		uint32_t First[osb::EVT_COUNT];
+		uint32_t Count[osb::EVT_COUNT];
+	};
+
+	size_t Align4(size_t v)
+	{
+		return (v + 3) & ~size_t(3);
+	}
+
+	bool EventsInRange(const uint32_t first[osb::EVT_COUNT], const uint32_t count[osb::EVT_COUNT], uint32_t total)
+	{
+		for (int e = 0; e < osb::EVT_COUNT; e++)
+			if (size_t(first[e]) + count[e] > total)
+				return false;
+
+		return true;
+	}
+
+	std::filesystem::path GetCachePath(const std::string &key)
+	{
+		return std::filesystem::path(CacheDirectory) / (key + ".rdsb");
+	}
+
+	bool IsEnabled()
+	{
+		return StoryboardCacheEnabled;
+	}
+
+	std::string GetKey(const std::string &events)
+	{
+		SHA256 sha;
+		sha.add(events.c_str(), events.length());
+		return sha.getHash();
+	}
+
+	bool Fetch(const std::string &key, osb::SpriteList &out)
+	{
+		std::error_code ec;
+		auto path = GetCachePath(key);
+		if (!std::filesystem::exists(path, ec))
+			return false;
+
+		MappedFile file;
+		if (!file.Open(path))
+			return false;
+
+		auto data = file.GetData();
+		auto size = file.GetSize();
+
+		if (size < sizeof(CacheHeader))
+			return false;
+
+		auto hdr = reinterpret_cast<const CacheHeader*>(data);
+		if (hdr->Magic != CacheMagic || hdr->Version != CacheVersion)
+			return false;
+
+		size_t offsetsAt = sizeof(CacheHeader);
+		size_t stringsAt = offsetsAt + (size_t(hdr->StringCount) + 1) * sizeof(uint32_t);
+		size_t spritesAt = Align4(stringsAt + hdr->StringBytes);
+		size_t groupsAt = spritesAt + size_t(hdr->SpriteCount) * sizeof(PackedSprite);
+		size_t eventsAt = groupsAt + size_t(hdr->GroupCount) * sizeof(PackedGroup);
+
+		if (eventsAt + size_t(hdr->EventCount) * sizeof(osb::PackedEvent) != size)
+		{
+			Log::LogPrintf("StoryboardCache: \"%s\" is corrupt.\n", path.string().c_str());
+			return false;
+		}
+
+		auto offsets = reinterpret_cast<const uint32_t*>(data + offsetsAt);
+		auto strings = data + stringsAt;
+		auto sprites = reinterpret_cast<const PackedSprite*>(data + spritesAt);
+		auto groups = reinterpret_cast<const PackedGroup*>(data + groupsAt);
+		auto events = reinterpret_cast<const osb::PackedEvent*>(data + eventsAt);
+
+		std::vector<std::string> images;
+		images.reserve(hdr->StringCount);
+		for (uint32_t i = 0; i < hdr->StringCount; i++)
+		{
+			if (offsets[i] > offsets[i + 1] || offsets[i + 1] > hdr->StringBytes)
+				return false;
+
+			images.emplace_back(strings + offsets[i], strings + offsets[i + 1]);
+		}
+
+		osb::SpriteList list;
+		list.reserve(hdr->SpriteCount);
+		for (uint32_t i = 0; i < hdr->SpriteCount; i++)
+		{
+			auto &sp = sprites[i];
+			if (sp.Image >= images.size() ||
+				sp.Origin < osb::PP_TOPLEFT || sp.Origin > osb::PP_BOTTOMRIGHT ||
+				sp.Layer < osb::LAYER_SP_BACKGROUND || sp.Layer > osb::LAYER_FOREGROUND)
+				return false;
+
+			if (!EventsInRange(sp.First, sp.Count, hdr->EventCount) ||
+				size_t(sp.FirstGroup) + sp.GroupCount > hdr->GroupCount)
+				return false;
+
+			list.push_back(osb::BGASprite(images[sp.Image],
+				osb::EOrigin(sp.Origin),
+				Vec2(sp.X, sp.Y),
+				osb::ELayer(sp.Layer)));
+			list.back().UnpackEvents(events, sp.First, sp.Count);
+
+			for (uint32_t g = sp.FirstGroup; g < sp.FirstGroup + sp.GroupCount; g++)
+			{
+				auto &grp = groups[g];
+				if (!EventsInRange(grp.First, grp.Count, hdr->EventCount))
+					return false;
+
+				if (grp.Type == osb::EVT_LOOP)
+				{
+					osb::Loop loop(grp.LoopCount);
+					loop.SetTime(grp.Time);
+					loop.UnpackEvents(events, grp.First, grp.Count);
+					list.back().AddLoop(loop);
+				}
+				else if (grp.Type == osb::EVT_TRIGGER &&
+					grp.Trigger >= osb::TRIGGER_UNKNOWN && grp.Trigger <= osb::TRIGGER_FAILING)
+				{
+					osb::Trigger trigger(osb::ETrigger(grp.Trigger), grp.TriggerGroup);
+					trigger.SetTime(grp.Time);
+					trigger.SetEndTime(grp.EndTime);
+					trigger.UnpackEvents(events, grp.First, grp.Count);
+					list.back().AddTrigger(trigger);
+				}
+				else return false;
+			}
+		}
+
+		out = std::move(list);
+
+		if (StoryboardCacheMessages)
+			Log::LogPrintf("StoryboardCache: Hit for %s (%d sprites).\n", key.c_str(), int(hdr->SpriteCount));
+
+		return true;
+	}
+
+	void Store(const std::string &key, const osb::SpriteList &list)
+	{
+		if (list.size() < MinimumSprites)
+			return;
+
+		std::map<std::string, uint32_t> imageIndices;
+		std::vector<uint32_t> offsets = { 0 };
+		std::string strings;
+		std::vector<PackedSprite> sprites;
+		std::vector<PackedGroup> groups;
+		std::vector<osb::PackedEvent> events;
+
+		sprites.reserve(list.size());
+		for (auto &sp : list)
+		{
+			auto file = sp.GetImageFilename();
+			auto it = imageIndices.find(file);
+			if (it == imageIndices.end())
+			{
+				it = imageIndices.insert(std::make_pair(file, uint32_t(offsets.size() - 1))).first;
+				strings += file;
+				offsets.push_back(strings.size());
+			}
+
+			PackedSprite ps;
+			ps.Image = it->second;
+			ps.Origin = sp.GetOrigin();
+			ps.Layer = sp.GetLayer();
+			ps.X = sp.GetStartPosition().x;
+			ps.Y = sp.GetStartPosition().y;
+			sp.PackEvents(events, ps.First, ps.Count);
+
+			ps.FirstGroup = groups.size();
+			for (auto &loop : sp.GetLoops())
+			{
+				PackedGroup pg = {};
+				pg.Type = osb::EVT_LOOP;
+				pg.LoopCount = loop.GetLoopCount();
+				pg.Time = loop.GetTime();
+				loop.PackEvents(events, pg.First, pg.Count);
+				groups.push_back(pg);
+			}
+
+			for (auto &trigger : sp.GetTriggers())
+			{
+				PackedGroup pg = {};
+				pg.Type = osb::EVT_TRIGGER;
+				pg.Trigger = trigger.GetKind();
+				pg.TriggerGroup = trigger.GetGroup();
+				pg.Time = trigger.GetTime();
+				pg.EndTime = trigger.Event::GetEndTime();
+				trigger.PackEvents(events, pg.First, pg.Count);
+				groups.push_back(pg);
+			}
+			ps.GroupCount = groups.size() - ps.FirstGroup;
+
+			sprites.push_back(ps);
+		}
+
+		CacheHeader hdr;
+		hdr.Magic = CacheMagic;
+		hdr.Version = CacheVersion;
+		hdr.SpriteCount = sprites.size();
+		hdr.StringCount = offsets.size() - 1;
+		hdr.StringBytes = strings.size();
+		hdr.GroupCount = groups.size();
+		hdr.EventCount = events.size();
+
+		strings.resize(Align4(sizeof(CacheHeader) + offsets.size() * sizeof(uint32_t) + strings.size())
+			- sizeof(CacheHeader) - offsets.size() * sizeof(uint32_t));
+
+		// Parse workers call this; on a filesystem error, the storyboard just isn't cached.
+		std::error_code ec;
+		std::filesystem::create_directories(CacheDirectory, ec);
+		if (ec)
+			return;
+
+		// Write somewhere else first, so a half-written file is never picked up.
+		// Each writer gets its own, so one can't rename another's away half-written.
+		auto path = GetCachePath(key);
+		auto tmp = path;
+		tmp += "." + std::to_string(TempFiles++) + ".tmp";
+
+		{
+#ifdef _WIN32
+			std::ofstream of(tmp.wstring(), std::ios::binary);
+#else
+			std::ofstream of(tmp.string(), std::ios::binary);
+#endif
+			if (!of.is_open())
+			{
+				Log::LogPrintf("StoryboardCache: Unable to write \"%s\".\n", tmp.string().c_str());
+				return;
+			}
+
+			BinWrite(of, hdr);
+			of.write((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+			of.write(strings.data(), strings.size());
+			of.write((const char*)sprites.data(), sprites.size() * sizeof(PackedSprite));
+			of.write((const char*)groups.data(), groups.size() * sizeof(PackedGroup));
+			of.write((const char*)events.data(), events.size() * sizeof(osb::PackedEvent));
+
+			// Names aren't reused, so nothing else would clean this up.
+			if (!of)
+			{
+				of.close();
+				std::filesystem::remove(tmp, ec);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmp, path, ec);
+		if (ec)
+		{
+			Log::LogPrintf("StoryboardCache: Unable to write \"%s\": %s\n", path.string().c_str(), ec.message().c_str());
+			std::filesystem::remove(tmp, ec);
+			return;
+		}
+
+		if (StoryboardCacheMessages)
+			Log::LogPrintf("StoryboardCache: Wrote %s (%d sprites, %d events).\n", key.c_str(), int(hdr.SpriteCount), int(hdr.EventCount));
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace osb
+{
+	class BGASprite;
+	typedef std::vector<BGASprite> SpriteList;
+}
+
+/*
+	Compiled osu! storyboards.
+	The parsed and sorted events of every sprite and of its loops and triggers are written as flat arrays
+	next to an interned table of image filenames, keyed by a hash of the storyboard's text.
+	Loading one is a memory mapping and a copy into the sprites' event lists.
+*/
+namespace StoryboardCache
+{
+	bool IsEnabled();
+
+	// Key for a storyboard's [Events] text.
+	std::string GetKey(const std::string &events);
+
+	// Fill out with the compiled storyboard for key. False if there's none or it's unusable.
+	bool Fetch(const std::string &key, osb::SpriteList &out);
+
+	// Compile list and write it under key.
+	void Store(const std::string &key, const osb::SpriteList &list);
+}
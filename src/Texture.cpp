@@ -13,11 +13,13 @@ Texture::Texture(unsigned int texture, int w, int h) :
 {
     IsValid = false;
     TextureAssigned = true;
+    IsCompressed = false;
 }
 
 Texture::Texture()
 {
     TextureAssigned = false;
+    IsCompressed = false;
     IsValid = false;
     texture = -1;
     h = -1;
@@ -76,6 +78,8 @@ void Texture::Destroy() // Called at destruction time
 		/*if (ImageLoaderMessages)
 			Log::LogPrintf("Texture: Destroying image %s (Removing texture...)\n", fname.string().c_str());*/
 		glDeleteTextures(1, &texture);
+		if (LastBound == this)
+			LastBound = nullptr;
 		IsValid = false;
 		texture = -1;
 	}
@@ -87,6 +91,26 @@ void Texture::SetTextureData2D(ImageData &ImgInfo, bool Reassign)
 
 	CreateTexture(); // Make sure our texture exists.
 
+	if (ImgInfo.CompressedFormat && ImgInfo.CompressedData.size())
+	{
+		// Compressed storage is always regenerated. We don't generate mipmaps for it
+		// so make sure the sampler doesn't expect them either.
+		TextureAssigned = true;
+		IsCompressed = true;
+
+		Renderer::SetTextureParameters(ImgInfo.Filename.filename().string());
+		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+		glCompressedTexImage2D(GL_TEXTURE_2D, 0, ImgInfo.CompressedFormat, ImgInfo.Width, ImgInfo.Height, 0,
+			ImgInfo.CompressedData.size(), ImgInfo.CompressedData.data());
+
+		w = ImgInfo.Width;
+		h = ImgInfo.Height;
+		fname = ImgInfo.Filename;
+		return;
+	}
+
 	if (ImgInfo.Data.size() == 0 && !Reassign)
 	{
 		return;
@@ -94,8 +118,9 @@ void Texture::SetTextureData2D(ImageData &ImgInfo, bool Reassign)
 
 	auto img = ImgInfo.TempData ? ImgInfo.TempData : ImgInfo.Data.data();
 
-	if (!TextureAssigned || Reassign) // We haven't set any data to this texture yet, or we want to regenerate storage
+	if (!TextureAssigned || Reassign || IsCompressed) // We haven't set any data to this texture yet, or we want to regenerate storage
 	{
+		IsCompressed = false;
 		TextureAssigned = true;
 		auto Dir = ImgInfo.Filename.filename().string();
 
@@ -115,13 +140,13 @@ void Texture::SetTextureData2D(ImageData &ImgInfo, bool Reassign)
 	fname = ImgInfo.Filename;
 }
 
-void Texture::LoadFile(std::filesystem::path Filename, bool Regenerate)
+void Texture::LoadFile(std::filesystem::path Filename, bool Regenerate, bool Compressible)
 {
 	CreateTexture();
 
 	/*if (ImageLoaderMessages)
 		Log::LogPrintf("Texture: Assigning \"%s\"\n", Filename.string().c_str());*/
-	auto Ret = ImageLoader::GetDataForImage(Filename);
+	auto Ret = ImageLoader::GetDataForImage(Filename, Compressible);
 	SetTextureData2D(Ret, Regenerate);
 	fname = Filename;
 }
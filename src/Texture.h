@@ -9,11 +9,16 @@ struct ImageData
 	// If you can't copy into Data, then fill this pointer instead.
 	uint32_t* TempData;
 
+	// If CompressedFormat is set, the image is in CompressedData as blocks of that GL format instead.
+	unsigned int CompressedFormat;
+	std::vector<uint8_t> CompressedData;
+
     ImageData()
     {
 		Alignment = 1;
         Width = 0; Height = 0;
 		TempData = nullptr;
+		CompressedFormat = 0;
     }
 
 	ImageData(int w, int h, void* data, int align = 1) {
@@ -21,6 +26,7 @@ struct ImageData
 		Width = w; Height = h;
 		TempData = (uint32_t*)data;
 		Alignment = align;
+		CompressedFormat = 0;
 
 	}
 };
@@ -34,6 +40,7 @@ class Texture
 
 protected:
 	bool TextureAssigned;
+	bool IsCompressed;
     void CreateTexture();
 public:
     Texture(unsigned int texture, int w, int h);
@@ -42,7 +49,8 @@ public:
 
 	bool IsBound();
     void Bind();
-    void LoadFile(std::filesystem::path Filename, bool Regenerate = false);
+    // Compressible allows the image to come from (and go to) the compressed texture cache.
+    void LoadFile(std::filesystem::path Filename, bool Regenerate = false, bool Compressible = false);
     void SetTextureData2D(ImageData &Data, bool Reassign = false);
 
     // Utilitarian
@@ -0,0 +1,354 @@
+#include "pch.h"
+
+#include "Logging.h"
+#include "Texture.h"
+#include "TextureCache.h"
+
+CfgVar CompressedTextureCache("CompressedTextureCache");
+CfgVar TextureCacheMessages("TextureCache", "Debug");
+
+namespace TextureCache
+{
+	const char CacheDirectory[] = "TextureCache";
+	const uint32_t CacheMagic = 0x43544452; // "RDTC"
+	const uint32_t CacheVersion = 1;
+
+	// Anything smaller than this isn't worth the quality loss nor the file.
+	const int MinimumPixels = 256 * 256;
+
+	// Images are stored from whichever threads decoded them, the same one maybe twice at once.
+	std::atomic<uint32_t> TempFiles(0);
+
+	struct CacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		int64_t LastModified;
+		uint64_t SourceSize;
+		int32_t Width, Height;
+		uint32_t Format;
+		uint32_t DataSize;
+	};
+
+	std::filesystem::path GetCachePath(std::filesystem::path filename)
+	{
+		SHA256 sha;
+		auto key = std::filesystem::absolute(filename).u8string();
+		sha.add(key.c_str(), key.length());
+
+		return std::filesystem::path(CacheDirectory) / (sha.getHash() + ".rdtc");
+	}
+
+	// Size of the blocks for a width x height image in format, 0 if it's not a format we write.
+	uint64_t GetBlocksSize(uint32_t format, int32_t width, int32_t height)
+	{
+		uint64_t blockBytes;
+		if (format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT)
+			blockBytes = 8;
+		else if (format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT)
+			blockBytes = 16;
+		else
+			return 0;
+
+		if (width <= 0 || height <= 0)
+			return 0;
+
+		return ((uint64_t(width) + 3) / 4) * ((uint64_t(height) + 3) / 4) * blockBytes;
+	}
+
+	bool IsAvailable()
+	{
+		return CompressedTextureCache && GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+	}
+
+	bool Fetch(std::filesystem::path filename, ImageData &out)
+	{
+		// Loader and streamer threads call this; a filesystem error is just a miss.
+		std::error_code ec;
+		auto path = GetCachePath(filename);
+		auto cacheSize = std::filesystem::file_size(path, ec);
+		if (ec)
+			return false;
+
+#ifdef _WIN32
+		std::ifstream in(path.wstring(), std::ios::binary);
+#else
+		std::ifstream in(path.string(), std::ios::binary);
+#endif
+		if (!in.is_open())
+			return false;
+
+		CacheHeader hdr;
+		BinRead(in, hdr);
+
+		if (!in || hdr.Magic != CacheMagic || hdr.Version != CacheVersion)
+			return false;
+
+		// Don't trust a damaged or foreign file with an allocation or with the GL.
+		auto blocksSize = GetBlocksSize(hdr.Format, hdr.Width, hdr.Height);
+		if (!blocksSize || hdr.DataSize != blocksSize || cacheSize != sizeof(CacheHeader) + blocksSize)
+		{
+			if (TextureCacheMessages)
+				Log::LogPrintf("TextureCache: \"%s\" is damaged.\n", path.string().c_str());
+			return false;
+		}
+
+		auto sourceSize = std::filesystem::file_size(filename, ec);
+		if (ec || hdr.LastModified != Utility::GetLastModifiedTime(filename) || hdr.SourceSize != sourceSize)
+		{
+			if (TextureCacheMessages)
+				Log::LogPrintf("TextureCache: \"%s\" is stale.\n", filename.string().c_str());
+			return false;
+		}
+
+		out.CompressedData.resize(hdr.DataSize);
+		in.read((char*)out.CompressedData.data(), hdr.DataSize);
+
+		if (!in)
+		{
+			out.CompressedData.clear();
+			return false;
+		}
+
+		out.Data.clear();
+		out.Width = hdr.Width;
+		out.Height = hdr.Height;
+		out.CompressedFormat = hdr.Format;
+		out.Filename = filename;
+
+		if (TextureCacheMessages)
+			Log::LogPrintf("TextureCache: Hit for \"%s\".\n", filename.string().c_str());
+
+		return true;
+	}
+
+	void Store(std::filesystem::path filename, ImageData &img)
+	{
+		if (img.Width * img.Height < MinimumPixels || img.Data.size() == 0)
+			return;
+
+		Compress(img);
+
+		// Loader and streamer threads call this; on a filesystem error, the image just isn't cached.
+		std::error_code ec;
+		std::filesystem::create_directories(CacheDirectory, ec);
+		if (ec)
+			return;
+
+		auto sourceSize = std::filesystem::file_size(filename, ec);
+		if (ec)
+			return;
+
+		// Write somewhere else first, so a half-written file is never picked up.
+		// Each writer gets its own, so one can't rename another's away half-written.
+		auto path = GetCachePath(filename);
+		auto tmp = path;
+		tmp += "." + std::to_string(TempFiles++) + ".tmp";
+
+		CacheHeader hdr;
+		hdr.Magic = CacheMagic;
+		hdr.Version = CacheVersion;
+		hdr.LastModified = Utility::GetLastModifiedTime(filename);
+		hdr.SourceSize = sourceSize;
+		hdr.Width = img.Width;
+		hdr.Height = img.Height;
+		hdr.Format = img.CompressedFormat;
+		hdr.DataSize = img.CompressedData.size();
+
+		{
+#ifdef _WIN32
+			std::ofstream of(tmp.wstring(), std::ios::binary);
+#else
+			std::ofstream of(tmp.string(), std::ios::binary);
+#endif
+			if (!of.is_open())
+			{
+				Log::LogPrintf("TextureCache: Unable to write \"%s\".\n", tmp.string().c_str());
+				return;
+			}
+
+			BinWrite(of, hdr);
+			of.write((const char*)img.CompressedData.data(), img.CompressedData.size());
+
+			// Names aren't reused, so nothing else would clean this up.
+			if (!of)
+			{
+				of.close();
+				std::filesystem::remove(tmp, ec);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmp, path, ec);
+		if (ec)
+		{
+			Log::LogPrintf("TextureCache: Unable to write \"%s\": %s\n", path.string().c_str(), ec.message().c_str());
+			std::filesystem::remove(tmp, ec);
+		}
+	}
+
+	/*
+		The encoder is the usual bounding box approach: take the min/max of the block as
+		endpoints and pick the closest palette entry per pixel. It's nowhere near
+		optimal, but it's fast and exact for flat colours, which matters for BMS
+		BGAs that rely on pure black being keyed out.
+	*/
+	inline uint16_t To565(const uint8_t* c)
+	{
+		return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+	}
+
+	inline void From565(uint16_t v, int* c)
+	{
+		int r = (v >> 11) & 0x1F, g = (v >> 5) & 0x3F, b = v & 0x1F;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	void EncodeColorBlock(const uint8_t block[16][4], uint8_t* out)
+	{
+		uint8_t mn[3] = { 255, 255, 255 }, mx[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mn[c] = std::min(mn[c], block[i][c]);
+				mx[c] = std::max(mx[c], block[i][c]);
+			}
+		}
+
+		uint16_t c0 = To565(mx), c1 = To565(mn);
+		uint32_t indices = 0;
+
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		if (c0 != c1)
+		{
+			int pal[4][3];
+			From565(c0, pal[0]);
+			From565(c1, pal[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+				pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestDist = std::numeric_limits<int>::max();
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i][0] - pal[p][0];
+					int dg = block[i][1] - pal[p][1];
+					int db = block[i][2] - pal[p][2];
+					int dist = dr * dr + dg * dg + db * db;
+					if (dist < bestDist)
+					{
+						bestDist = dist;
+						best = p;
+					}
+				}
+
+				indices |= best << (i * 2);
+			}
+		}
+
+		out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+		out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+
+	void EncodeAlphaBlock(const uint8_t block[16][4], uint8_t* out)
+	{
+		uint8_t a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			a0 = std::max(a0, block[i][3]);
+			a1 = std::min(a1, block[i][3]);
+		}
+
+		uint64_t indices = 0;
+		if (a0 != a1)
+		{
+			// a0 > a1 selects the 8 alpha mode.
+			int pal[8] = { a0, a1 };
+			for (int p = 1; p < 7; p++)
+				pal[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestDist = 256;
+				for (int p = 0; p < 8; p++)
+				{
+					int dist = abs(block[i][3] - pal[p]);
+					if (dist < bestDist)
+					{
+						bestDist = dist;
+						best = p;
+					}
+				}
+
+				indices |= uint64_t(best) << (i * 3);
+			}
+		}
+
+		out[0] = a0;
+		out[1] = a1;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+
+	void Compress(ImageData &img)
+	{
+		if (img.Data.size() == 0)
+			return;
+
+		auto pixels = reinterpret_cast<const uint8_t*>(img.Data.data());
+		int w = img.Width, h = img.Height;
+
+		bool opaque = true;
+		for (size_t i = 0; i < img.Data.size() && opaque; i++)
+			opaque = pixels[i * 4 + 3] == 255;
+
+		int bw = (w + 3) / 4, bh = (h + 3) / 4;
+		size_t blockSize = opaque ? 8 : 16;
+
+		std::vector<uint8_t> out(size_t(bw) * bh * blockSize);
+		auto dst = out.data();
+
+		uint8_t block[16][4];
+		for (int by = 0; by < bh; by++)
+		{
+			for (int bx = 0; bx < bw; bx++)
+			{
+				// blocks hanging off the edge repeat the last row/column.
+				for (int y = 0; y < 4; y++)
+				{
+					int sy = std::min(by * 4 + y, h - 1);
+					for (int x = 0; x < 4; x++)
+					{
+						int sx = std::min(bx * 4 + x, w - 1);
+						memcpy(block[y * 4 + x], pixels + (size_t(sy) * w + sx) * 4, 4);
+					}
+				}
+
+				if (!opaque)
+				{
+					EncodeAlphaBlock(block, dst);
+					dst += 8;
+				}
+
+				EncodeColorBlock(block, dst);
+				dst += 8;
+			}
+		}
+
+		img.CompressedFormat = opaque ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		img.CompressedData = std::move(out);
+		img.Data.clear();
+		img.Data.shrink_to_fit();
+	}
+}
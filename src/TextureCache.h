@@ -0,0 +1,24 @@
+#pragma once
+
+struct ImageData;
+
+/*
+	On-disk cache of images pre-encoded into S3TC blocks.
+	Big backgrounds and BGA frames get encoded once on the CPU and are uploaded
+	with glCompressedTexImage2D from then on, skipping the decoder entirely.
+*/
+namespace TextureCache
+{
+	// Whether the cache is enabled and the GPU can take S3TC textures.
+	bool IsAvailable();
+
+	// Fill out with the cached blocks for filename. False if missing or stale.
+	bool Fetch(std::filesystem::path filename, ImageData &out);
+
+	// Encode img (RGBA pixels) and write it to the cache. Replaces img's contents with the compressed blocks.
+	// Small images are left alone.
+	void Store(std::filesystem::path filename, ImageData &img);
+
+	// Encode RGBA pixels into BC1 if opaque, BC3 otherwise.
+	void Compress(ImageData &img);
+}
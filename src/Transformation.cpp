@@ -5,7 +5,15 @@
 
 bool Transformation::IsMatrixDirty()
 {
-	return mDirtyMatrix || Chain;
+	if (mDirtyMatrix)
+		return true;
+
+	if (!Chain)
+		return false;
+
+	// Bring the chain up to date first, so its generation is current.
+	Chain->GetMatrix();
+	return Chain->GetGeneration() != mChainGeneration;
 }
 
 Transformation::Transformation()
@@ -17,6 +25,8 @@ Transformation::Transformation()
     Chain = NULL;
     mLayer = 0;
 	mDirtyMatrix = true;
+	mGeneration = 0;
+	mChainGeneration = 0;
 
     UpdateMatrix();
 }
@@ -217,14 +227,26 @@ void Transformation::UpdateMatrix()
     Mat4 Chn;
 
     if (Chain)
+    {
         Chn = Chain->GetMatrix();
+        mChainGeneration = Chain->GetGeneration();
+    }
 
     mMatrix = Chn * Pos * Rot * Scl;
     mDirtyMatrix = false;
+    mGeneration++;
+}
+
+uint32_t Transformation::GetGeneration() const
+{
+    return mGeneration;
 }
 
 void Transformation::ChainTransformation(Transformation *Other)
 {
     if (Other != this)
+    {
         Chain = Other;
+        mDirtyMatrix = true;
+    }
 }
\ No newline at end of file
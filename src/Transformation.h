@@ -11,6 +11,11 @@ class Transformation
     float mRotation;
     bool   mDirtyMatrix;
 
+    // Bumped every time mMatrix is rebuilt. We keep the chain's from our last rebuild,
+    // so we only rebuild when it or we changed.
+    uint32_t mGeneration;
+    uint32_t mChainGeneration;
+
 	bool IsMatrixDirty();
     Transformation* Chain;
 public:
@@ -59,4 +64,5 @@ public:
 
     const glm::mat4 &GetMatrix();
     void UpdateMatrix();
+    uint32_t GetGeneration() const;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Logging.h"
+#include "MappedFile.h"
 
 int b36toi(const char *txt)
 {
@@ -244,20 +245,13 @@ namespace Utility
     std::string GetSha256ForFile(std::filesystem::path Filename)
     {
         SHA256 SHA;
-		CreateIfstream(InStream, Filename);
-        unsigned char tmpbuf[256];
+        MappedFile File;
 
-        if (!InStream.is_open())
+        if (File.Open(Filename))
+            SHA.add(File.GetData(), File.GetSize());
+        else if (!std::filesystem::exists(Filename) || std::filesystem::file_size(Filename) != 0)
             return "";
 
-        while (!InStream.eof())
-        {
-            InStream.read((char*)tmpbuf, 256);
-            size_t cnt = InStream.gcount();
-
-            SHA.add(tmpbuf, cnt);
-        }
-
         return std::string(SHA.getHash());
     }
 
@@ -2,6 +2,8 @@
 
 #include "Texture.h"
 #include "VideoPlayback.h"
+#include "Rendering.h"
+#include "Shader.h"
 #include "Logging.h"
 
 extern "C" {
@@ -9,30 +11,79 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/pixdesc.h>
 }
 /*
 	Much of this implementation are a simplification of the tutorials found at
 	http://dranger.com/ffmpeg
 
 	* Differences: Frame queue is a ring buffer of frames rather than packets
-	* Frame buffers are stored in vectors
+	* Frames in the queue hold references to the decoder's own buffers (no copies)
 	* Variable frame queue size
-	* OpenGL
-	
+	* OpenGL: Y, U and V planes are uploaded through PBOs into their own textures
+	and turned into RGB by a shader, rendering into this texture.
+
+	* Decoding is done by a few workers shared between every video, and only
+	for videos that are displayed or getting ready to be (see VideoDecodeScheduler)
+
 	* No audio sync (external clock)
 
-	* Updating not using a thread timer, 
+	* Updating not using a thread timer,
 	but with an external clock (which may be on another thread. to be tested!)
 */
 
+CfgVar VideoFrameQueue("VideoFrameQueue");
+CfgVar VideoDecodeThreads("VideoDecodeThreads");
+CfgVar VideoDecodeWorkers("VideoDecodeWorkers");
+
+// Frames decoded ahead when VideoFrameQueue isn't set, and the most it may ask for.
+const uint32_t DefaultFrameQueueItems = 4;
+const uint32_t MaxFrameQueueItems = 256;
+
+// A video not updated for this long is considered hidden and stops decoding.
+const std::chrono::milliseconds VideoHiddenTimeout(250);
+
+// Jumping further ahead than this seeks instead of decoding every frame in between.
+const double VideoSeekThreshold = 1.0;
+
+const char* yuvShader = "#version 120\n"
+"varying vec2 texcoord;\n"
+"uniform sampler2D texY;\n"
+"uniform sampler2D texU;\n"
+"uniform sampler2D texV;\n"
+"uniform bool fullRange;\n"
+"uniform bool bt709;\n"
+"void main(void)\n"
+"{\n"
+"	float y = texture2D(texY, texcoord).r;\n"
+"	float u = texture2D(texU, texcoord).r - 0.5;\n"
+"	float v = texture2D(texV, texcoord).r - 0.5;\n"
+"	if (!fullRange) {\n"
+"		y = (y - 16.0 / 255.0) * (255.0 / 219.0);\n"
+"		u = u * (255.0 / 224.0);\n"
+"		v = v * (255.0 / 224.0);\n"
+"	}\n"
+"	vec3 rgb;\n"
+"	if (bt709)\n"
+"		rgb = vec3(y + 1.5748 * v, y - 0.1873 * u - 0.4681 * v, y + 1.8556 * u);\n"
+"	else\n"
+"		rgb = vec3(y + 1.402 * v, y - 0.344136 * u - 0.714136 * v, y + 1.772 * u);\n"
+"	gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+"}\n";
+
+// Shared by every video, created the first time one is displayed.
+Renderer::Shader* YUVConversionShader = nullptr;
+
 class VideoFrame {
 public:
 	AVFrame* frame;
 	double pts; // seconds
+	uint32_t generation; // frames from before the last seek are thrown away
 
 	VideoFrame() {
 		frame = nullptr;
 		pts = 0;
+		generation = 0;
 	}
 };
 
@@ -47,7 +98,7 @@ public:
 	AVCodec *Codec;
 
 	VideoFrame DisplayFrame;
-	
+
 	// contains pending AVFrame* to display
 	PaUtilRingBuffer mPendingFrameQueue;
 
@@ -57,24 +108,64 @@ public:
 	std::vector<char> PendingQueueData;
 	std::vector<char> CleanQueueData;
 
-	std::vector<char> DecodedFrameData;
-	std::vector<char> FrameData;
-
+	// Only used when the decoder output can't go straight to the GPU:
+	// converts into yuv420p when we can convert on the GPU, rgb24 otherwise.
 	SwsContext *sws_ctx;
+	AVPixelFormat OutputFormat;
+	bool GPUConvert;
 
 	AVFrame* DecodedFrame;
 
 	int videoStreamIndex;
 
-	std::mutex ringbuffer_mutex;
-	std::atomic<bool> CleanFrameAvailable;
-	std::condition_variable ringbuffer_has_space;
+	// GPU conversion state.
+	bool GLInitialized;
+	GLuint PlaneTextures[3];
+	GLuint PlanePBOs[3];
+	GLuint FBO;
+	int ChromaShiftW, ChromaShiftH;
+	bool FullRange;
+	bool BT709;
+
+	// Seeking. The main thread bumps Generation, the decoder catches up.
+	std::atomic<uint32_t> Generation;
+	std::atomic<uint32_t> DecodedGeneration;
+	std::atomic<double> SeekTarget;
+	double SkipUntil;
+
+	// Decoder side state.
+	bool Draining;
+	std::atomic<bool> AtEnd;
+
+	// Keep decoding until the queue is full, visible or not.
+	std::atomic<bool> Priming;
+
+	// Main thread side state.
+	double LastClock;
+	std::atomic<int64_t> LastShown;
 
 	VideoPlaybackData() {
 		AV = nullptr;
 		CodecCtx = nullptr;
+		UsableCodecCtx = nullptr;
 		Codec = nullptr;
 		sws_ctx = nullptr;
+		DecodedFrame = nullptr;
+		GPUConvert = false;
+		GLInitialized = false;
+		FBO = 0;
+		ChromaShiftW = ChromaShiftH = 0;
+		FullRange = false;
+		BT709 = false;
+		Generation = 0;
+		DecodedGeneration = 0;
+		SeekTarget = 0;
+		SkipUntil = 0;
+		Draining = false;
+		AtEnd = false;
+		Priming = true;
+		LastClock = 0;
+		LastShown = 0;
 	}
 
 	VideoFrame GetCleanFrame()
@@ -113,9 +204,89 @@ public:
 		}
 	}
 
+	bool HasSpace()
+	{
+		return PaUtil_GetRingBufferReadAvailable(&mCleanFrameQueue) > 0 &&
+			PaUtil_GetRingBufferWriteAvailable(&mPendingFrameQueue) > 0;
+	}
+
+	// Main thread: give a displayed or stale frame back to the decoder.
+	void RecycleFrame(VideoFrame &frame)
+	{
+		// The decoder can have its buffer back now.
+		if (!sws_ctx)
+			av_frame_unref(frame.frame);
+
+		PutCleanFrame(frame);
+		frame.frame = nullptr;
+	}
+
+	bool IsVisible()
+	{
+		auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		return now - LastShown < VideoHiddenTimeout.count();
+	}
+
+	void MarkVisible()
+	{
+		LastShown = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Worker side of a seek.
+	void SeekDecoder(uint32_t gen)
+	{
+		double target = SeekTarget;
+		auto tb = av_q2d(AV->streams[videoStreamIndex]->time_base);
+
+		av_seek_frame(AV, videoStreamIndex, int64_t(target / tb), AVSEEK_FLAG_BACKWARD);
+		avcodec_flush_buffers(UsableCodecCtx);
+
+		SkipUntil = target;
+		Draining = false;
+		AtEnd = false;
+		Priming = true;
+		DecodedGeneration = gen;
+	}
+
+	// Queue the frame in DecodedFrame. False if it was skipped.
+	bool QueueDecodedFrame(uint32_t gen)
+	{
+		auto df = DecodedFrame;
+		auto tb = av_q2d(AV->streams[videoStreamIndex]->time_base);
+		double pts = av_frame_get_best_effort_timestamp(df) * tb;
+		double duration = av_frame_get_pkt_duration(df) * tb;
+
+		// Seeking lands on the keyframe before the target.
+		if (pts + duration <= SkipUntil) {
+			av_frame_unref(df);
+			return false;
+		}
+
+		auto cf = GetCleanFrame();
+		cf.pts = pts;
+		cf.generation = gen;
+
+		if (sws_ctx) {
+			sws_scale(sws_ctx, (uint8_t const* const*)df->data,
+				df->linesize, 0, UsableCodecCtx->height, cf.frame->data, cf.frame->linesize);
+			av_frame_unref(df);
+		}
+		else {
+			// hold on to the decoder's buffer until it's displayed
+			av_frame_unref(cf.frame);
+			av_frame_move_ref(cf.frame, df);
+		}
+
+		PutPendingFrame(cf);
+		return true;
+	}
+
 	~VideoPlaybackData() {
 		av_frame_free(&DisplayFrame.frame);
-		
+		av_frame_free(&DecodedFrame);
+
 		AVFrame* f;
 		while ((f = GetCleanFrame().frame)) {
 			av_frame_free(&f);
@@ -125,6 +296,12 @@ public:
 			av_frame_free(&f);
 		}
 
+		if (GLInitialized) {
+			glDeleteTextures(3, PlaneTextures);
+			glDeleteBuffers(3, PlanePBOs);
+			glDeleteFramebuffers(1, &FBO);
+		}
+
 		avformat_free_context(AV);
 		avcodec_free_context(&UsableCodecCtx);
 		//avcodec_free_context(&CodecCtx);
@@ -132,30 +309,149 @@ public:
 		sws_freeContext(sws_ctx);
 	}
 
-	void InitializeBuffers(uint32_t framecnt, int w, int h) {
+	// False if the queues can't take framecnt frames, which has to be a power of two.
+	bool InitializeBuffers(uint32_t framecnt, int w, int h) {
 		// framecnt += 1;
 
 		auto mem = sizeof(VideoFrame) * framecnt;
 		CleanQueueData.assign(mem, 0);
 		PendingQueueData.assign(mem, 0);
 
-		PaUtil_InitializeRingBuffer(&mPendingFrameQueue, sizeof(VideoFrame), framecnt, PendingQueueData.data());
-		PaUtil_InitializeRingBuffer(&mCleanFrameQueue, sizeof(VideoFrame), framecnt, CleanQueueData.data());
-
-		auto framesize = avpicture_get_size(AV_PIX_FMT_RGB24, w, h) + AV_INPUT_BUFFER_PADDING_SIZE;
-
-		FrameData.assign(framesize * framecnt, 0);
+		if (PaUtil_InitializeRingBuffer(&mPendingFrameQueue, sizeof(VideoFrame), framecnt, PendingQueueData.data()) < 0 ||
+			PaUtil_InitializeRingBuffer(&mCleanFrameQueue, sizeof(VideoFrame), framecnt, CleanQueueData.data()) < 0)
+			return false;
 
 		for (uint32_t i = 0; i < framecnt; i++)
 		{
 			auto avframe = av_frame_alloc();
-			uint8_t *buf = (uint8_t*)(FrameData.data() + i * framesize);
-			avpicture_fill((AVPicture*)avframe, buf, AV_PIX_FMT_RGB24, w, h);
+
+			// frames that take the decoder's output by reference need no storage of their own.
+			if (sws_ctx) {
+				avframe->format = OutputFormat;
+				avframe->width = w;
+				avframe->height = h;
+				av_frame_get_buffer(avframe, 32);
+			}
 
 			VideoFrame vf;
 			vf.frame = avframe;
 			PaUtil_WriteRingBuffer(&mCleanFrameQueue, &vf, 1);
 		}
+
+		return true;
+	}
+
+	void InitializeGL(int w, int h, GLuint target) {
+		glGenTextures(3, PlaneTextures);
+		glGenBuffers(3, PlanePBOs);
+
+		for (int i = 0; i < 3; i++) {
+			int pw = i ? -((-w) >> ChromaShiftW) : w;
+			int ph = i ? -((-h) >> ChromaShiftH) : h;
+
+			glBindTexture(GL_TEXTURE_2D, PlaneTextures[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, pw, ph, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			Log::LogPrintf("VideoPlayback: Conversion framebuffer is incomplete.\n");
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		Texture::ForceRebind();
+
+		if (!YUVConversionShader) {
+			YUVConversionShader = new Renderer::Shader();
+			YUVConversionShader->Compile(yuvShader);
+		}
+
+		GLInitialized = true;
+	}
+
+	void UploadPlanes(AVFrame* frame, int w, int h) {
+		for (int i = 0; i < 3; i++) {
+			int pw = i ? -((-w) >> ChromaShiftW) : w;
+			int ph = i ? -((-h) >> ChromaShiftH) : h;
+			int stride = frame->linesize[i];
+			size_t size = size_t(abs(stride)) * ph;
+
+			// orphan the previous contents so we don't stall on a pending transfer
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PlanePBOs[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+			auto dst = (uint8_t*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+			if (dst) {
+				if (stride > 0)
+					memcpy(dst, frame->data[i], size);
+				else
+					for (int y = 0; y < ph; y++)
+						memcpy(dst + y * -stride, frame->data[i] + y * stride, -stride);
+
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			}
+
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, PlaneTextures[i]);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, abs(stride));
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pw, ph, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	void ConvertPlanes(int w, int h) {
+		auto sh = YUVConversionShader;
+		if (!sh->IsValid())
+			return;
+
+		GLint viewport[4], prevFBO;
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
+		bool blend = glIsEnabled(GL_BLEND);
+		bool srgb = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, w, h);
+
+		// Video output is already gamma-encoded, write it as-is like uploading rgb would.
+		glDisable(GL_BLEND);
+		glDisable(GL_FRAMEBUFFER_SRGB);
+
+		sh->Bind();
+
+		// map the unit quad to the whole framebuffer.
+		auto proj = glm::ortho<float>(0, 1, 0, 1);
+		auto mvp = Mat4();
+		Renderer::Shader::SetUniform(sh->GetUniform("projection"), &proj[0][0]);
+		Renderer::Shader::SetUniform(sh->GetUniform("mvp"), &mvp[0][0]);
+		Renderer::Shader::SetUniform(sh->GetUniform("centered"), 0);
+		Renderer::Shader::SetUniform(sh->GetUniform("texY"), 0);
+		Renderer::Shader::SetUniform(sh->GetUniform("texU"), 1);
+		Renderer::Shader::SetUniform(sh->GetUniform("texV"), 2);
+		Renderer::Shader::SetUniform(sh->GetUniform("fullRange"), FullRange);
+		Renderer::Shader::SetUniform(sh->GetUniform("bt709"), BT709);
+
+		Renderer::SetPrimitiveQuadVBO();
+		Renderer::DoQuadDraw();
+		Renderer::FinalizeDraw();
+
+		if (srgb) glEnable(GL_FRAMEBUFFER_SRGB);
+		if (blend) glEnable(GL_BLEND);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glActiveTexture(GL_TEXTURE0);
+
+		Renderer::DefaultShader::StaticBind();
+		Texture::ForceRebind();
 	}
 };
 
@@ -168,51 +464,206 @@ void InitializeFFMpeg()
 	}
 }
 
-void VideoPlayback::QueueFrame()
+bool IsGPUConvertibleFormat(AVPixelFormat fmt)
 {
-	if (!(PaUtil_GetRingBufferReadAvailable(&Context->mCleanFrameQueue) > 0 &&
-		PaUtil_GetRingBufferWriteAvailable(&Context->mPendingFrameQueue) > 0)) {
-		return;
+	switch (fmt) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return false;
 	}
+}
 
-	int gotframe;
-	AVPacket packet;
-	while (av_read_frame(Context->AV, &packet) >= 0) { 
-		
-		if (packet.stream_index == Context->videoStreamIndex) {
-			avcodec_decode_video2(Context->UsableCodecCtx, Context->DecodedFrame, &gotframe, &packet);
-			if (gotframe) {
-				auto cf = Context->GetCleanFrame();
+int GetVideoDecodeWorkerCount()
+{
+	if (VideoDecodeWorkers > 0)
+		return int(VideoDecodeWorkers);
 
-				sws_scale(Context->sws_ctx, (uint8_t const* const*)Context->DecodedFrame->data,
-					Context->DecodedFrame->linesize, 0, Context->UsableCodecCtx->height, cf.frame->data, cf.frame->linesize);
+	return Clamp<int>(std::thread::hardware_concurrency() / 2, 1, 4);
+}
 
+/*
+	Every video is decoded by the same few workers. A video gets decoded when it has room
+	in its queue and is either being displayed, catching up with a seek or filling its queue
+	after opening/seeking so it's ready to be shown. Anything else is paused where it is.
+*/
+class VideoDecodeScheduler
+{
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::vector<VideoPlayback*> Videos;
+	std::set<VideoPlayback*> Busy;
+	std::vector<std::thread> Workers;
 
-				cf.pts = av_frame_get_best_effort_timestamp(Context->DecodedFrame) * av_q2d(Context->AV->streams[Context->videoStreamIndex]->time_base);
-				Context->PutPendingFrame(cf);
-			} 
+	VideoDecodeScheduler()
+	{
+		int count = GetVideoDecodeWorkerCount();
+		for (int i = 0; i < count; i++)
+			Workers.push_back(std::thread(&VideoDecodeScheduler::Worker, this));
+	}
+
+	static bool NeedsDecoding(VideoPlayback* vid)
+	{
+		auto ctx = vid->Context;
+		if (ctx->Generation != ctx->DecodedGeneration)
+			return true;
+
+		return !ctx->AtEnd && ctx->HasSpace() && (ctx->Priming || ctx->IsVisible());
+	}
+
+	// Visible videos first, then whichever has the fewest frames ready.
+	VideoPlayback* Pick()
+	{
+		VideoPlayback* best = nullptr;
+		bool bestVisible = false;
+		ring_buffer_size_t bestQueued = 0;
+
+		for (auto vid : Videos) {
+			if (Busy.find(vid) != Busy.end() || !NeedsDecoding(vid))
+				continue;
+
+			bool visible = vid->Context->IsVisible();
+			auto queued = PaUtil_GetRingBufferReadAvailable(&vid->Context->mPendingFrameQueue);
+			if (!best || (visible && !bestVisible) || (visible == bestVisible && queued < bestQueued)) {
+				best = vid;
+				bestVisible = visible;
+				bestQueued = queued;
+			}
 		}
 
-		av_free_packet(&packet);
+		return best;
+	}
 
-		if (gotframe) break;
+	void Worker()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (true) {
+			auto vid = Pick();
+			if (!vid) {
+				// Visibility changes by time passing alone, so poll while there's anything to become visible.
+				// With no videos at all, Add wakes us.
+				if (Videos.empty())
+					Condition.wait(lock);
+				else
+					Condition.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+
+			Busy.insert(vid);
+			lock.unlock();
+
+			vid->QueueFrame();
+
+			lock.lock();
+			Busy.erase(vid);
+			Condition.notify_all();
+		}
+	}
+
+public:
+	// Never destroyed: videos may outlive static destruction order.
+	static VideoDecodeScheduler& Get()
+	{
+		static auto instance = new VideoDecodeScheduler();
+		return *instance;
+	}
+
+	void Add(VideoPlayback* vid)
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		Videos.push_back(vid);
+		Condition.notify_all();
+	}
+
+	// Waits for the workers to be done with vid.
+	void Remove(VideoPlayback* vid)
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		Condition.wait(lock, [&]() { return Busy.find(vid) == Busy.end(); });
+		Videos.erase(std::remove(Videos.begin(), Videos.end(), vid), Videos.end());
+	}
+
+	void Notify()
+	{
+		Condition.notify_one();
+	}
+};
+
+bool VideoPlayback::QueueFrame()
+{
+	auto ctx = Context;
+	uint32_t gen = ctx->Generation;
+	if (gen != ctx->DecodedGeneration)
+		ctx->SeekDecoder(gen);
+
+	if (!ctx->HasSpace()) {
+		ctx->Priming = false;
+		return true;
+	}
+
+	if (ctx->AtEnd)
+		return false;
+
+	AVPacket packet;
+	while (true) {
+		int gotframe = 0;
+
+		if (!ctx->Draining) {
+			if (av_read_frame(ctx->AV, &packet) < 0) {
+				ctx->Draining = true;
+				continue;
+			}
+
+			if (packet.stream_index == ctx->videoStreamIndex)
+				avcodec_decode_video2(ctx->UsableCodecCtx, ctx->DecodedFrame, &gotframe, &packet);
+
+			av_free_packet(&packet);
+		}
+		else {
+			// Get the frames still held by the decoder's threads out.
+			av_init_packet(&packet);
+			packet.data = nullptr;
+			packet.size = 0;
+
+			avcodec_decode_video2(ctx->UsableCodecCtx, ctx->DecodedFrame, &gotframe, &packet);
+			if (!gotframe) {
+				ctx->AtEnd = true;
+				ctx->Priming = false;
+				return false; // end of stream
+			}
+		}
+
+		if (gotframe && ctx->QueueDecodedFrame(gen))
+			return true;
 	}
 }
 
 VideoPlayback::VideoPlayback(uint32_t framequeueitems)
 {
 	InitializeFFMpeg();
-	mFrameQueueItems = framequeueitems;
+
+	if (!framequeueitems)
+		framequeueitems = VideoFrameQueue > 0 ? int(VideoFrameQueue) : DefaultFrameQueueItems;
+
+	// The frame queues only take powers of two. Past the cap it's only memory.
+	uint32_t items = 2;
+	while (items < framequeueitems && items < MaxFrameQueueItems)
+		items <<= 1;
+
+	mFrameQueueItems = items;
 	Context = nullptr;
-	mDecodeThread = nullptr;
+	Registered = false;
 }
 
 VideoPlayback::~VideoPlayback()
 {
-	if (mDecodeThread) {
-		RunDecodeThread = false;
-		mDecodeThread->join();
-	}
+	if (Registered)
+		VideoDecodeScheduler::Get().Remove(this);
 
 	if (Context)
 		delete Context;
@@ -253,37 +704,66 @@ bool VideoPlayback::Open(std::filesystem::path path)
 		return false;
 	}
 
+	// split the cores between the decode workers unless told otherwise,
+	// and keep references to its frames so they can sit in our queue.
+	int threads = std::thread::hardware_concurrency() / GetVideoDecodeWorkerCount();
+	newctx->UsableCodecCtx->thread_count = VideoDecodeThreads > 0 ? int(VideoDecodeThreads) : std::max(threads, 1);
+	newctx->UsableCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	newctx->UsableCodecCtx->refcounted_frames = 1;
+
 	// open context?
 	if (avcodec_open2(newctx->UsableCodecCtx, newctx->Codec, nullptr) < 0)
 		return false;
 
-	newctx->InitializeBuffers(mFrameQueueItems, newctx->UsableCodecCtx->width, newctx->UsableCodecCtx->height);
-
 	/*Log::Printf("Video delay (frames): %d\n", newctx->UsableCodecCtx->delay);
 	av_seek_frame(newctx->AV, newctx->videoStreamIndex, newctx->UsableCodecCtx->delay * 2, 0);*/
 
-	auto f = avpicture_get_size(newctx->UsableCodecCtx->pix_fmt, 
-		newctx->UsableCodecCtx->width, 
-		newctx->UsableCodecCtx->height) + AV_INPUT_BUFFER_PADDING_SIZE;
-	newctx->DecodedFrameData.assign(f, 0);
-
 	auto ucc = newctx->UsableCodecCtx;
 
 	w = ucc->width;
 	h = ucc->height;
 
-	auto avframe = av_frame_alloc();
-	uint8_t *buf = (uint8_t*)newctx->DecodedFrameData.data();
-	avpicture_fill((AVPicture*)avframe, buf, ucc->pix_fmt, w, h);
-	newctx->DecodedFrame = avframe;
+	newctx->DecodedFrame = av_frame_alloc();
+
+	// Without FBOs we're stuck converting to rgb on the CPU.
+	newctx->GPUConvert = GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object;
+
+	auto fmt = ucc->pix_fmt;
+	if (newctx->GPUConvert && !IsGPUConvertibleFormat(fmt))
+		newctx->OutputFormat = AV_PIX_FMT_YUV420P;
+	else if (!newctx->GPUConvert)
+		newctx->OutputFormat = AV_PIX_FMT_RGB24;
+	else
+		newctx->OutputFormat = fmt;
+
+	if (newctx->OutputFormat != fmt) {
+		newctx->sws_ctx = sws_getContext(w, h,
+			fmt,
+			w, h,
+			newctx->OutputFormat, SWS_BILINEAR,
+			nullptr, nullptr, nullptr);
+	}
 
-	newctx->sws_ctx = sws_getContext(w, h, 
-		ucc->pix_fmt, 
-		w, h, 
-		AV_PIX_FMT_RGB24, SWS_BILINEAR, 
-		nullptr, nullptr, nullptr);
+	av_pix_fmt_get_chroma_sub_sample(newctx->OutputFormat, &newctx->ChromaShiftW, &newctx->ChromaShiftH);
+	newctx->FullRange = ucc->color_range == AVCOL_RANGE_JPEG ||
+		fmt == AV_PIX_FMT_YUVJ420P || fmt == AV_PIX_FMT_YUVJ422P || fmt == AV_PIX_FMT_YUVJ444P;
+	newctx->BT709 = ucc->colorspace == AVCOL_SPC_BT709 ||
+		(ucc->colorspace == AVCOL_SPC_UNSPECIFIED && h >= 720);
+
+	if (!newctx->InitializeBuffers(mFrameQueueItems, w, h)) {
+		Log::LogPrintf("VideoPlayback: Unable to queue %u frames, using %u.\n", mFrameQueueItems, DefaultFrameQueueItems);
+		mFrameQueueItems = DefaultFrameQueueItems;
+
+		if (!newctx->InitializeBuffers(mFrameQueueItems, w, h))
+			return false;
+	}
 
 	// only assign on success
+	if (Registered) {
+		VideoDecodeScheduler::Get().Remove(this);
+		Registered = false;
+	}
+
 	if (Context) delete Context;
 	Context = newctx;;
 	return true;
@@ -293,45 +773,85 @@ void VideoPlayback::Reset()
 {
 }
 
-void VideoPlayback::StartDecodeThread()
+void VideoPlayback::StartDecoding()
 {
-	RunDecodeThread = true;
-	mDecodeThread = new std::thread([&]() {
-		while (RunDecodeThread) {
+	if (!Context || Registered)
+		return;
 
-			QueueFrame();
+	Registered = true;
+	VideoDecodeScheduler::Get().Add(this);
+}
 
-			while (!Context->CleanFrameAvailable) {
-				std::unique_lock<std::mutex> lock(Context->ringbuffer_mutex);
-				Context->ringbuffer_has_space.wait(lock);
-			}
-		}
-	});
+void VideoPlayback::Seek(double clock)
+{
+	if (!Context) return;
+
+	Context->SeekTarget = clock;
+	Context->Generation++;
+	Context->LastClock = clock;
+
+	// Whatever's queued is from before the seek.
+	if (Context->DisplayFrame.frame)
+		Context->RecycleFrame(Context->DisplayFrame);
+
+	VideoFrame frame;
+	while ((frame = Context->GetPendingFrame()).frame)
+		Context->RecycleFrame(frame);
+
+	if (Registered)
+		VideoDecodeScheduler::Get().Notify();
 }
 
-void VideoPlayback::UpdateClock(double clock)
+void VideoPlayback::Preroll(double clock)
 {
-	bool update = true;
+	if (!Context) return;
+
+	if (Context->LastClock != clock)
+		Seek(clock);
+}
 
+void VideoPlayback::UpdateClock(double clock)
+{
 	if (!Context) return;
-	if (clock < 0) return; 
-
-	while (update) {
-		if (Context->DisplayFrame.frame) {
-			if (Context->DisplayFrame.pts <= clock) {
-				UpdateVideoTexture(Context->DisplayFrame.frame);
-				Context->PutCleanFrame(Context->DisplayFrame);
-				Context->DisplayFrame.frame = nullptr;
-			}
-			else break;
-		}
-		else {
+	if (clock < 0) return;
+
+	Context->MarkVisible();
+
+	if (clock < Context->LastClock || clock > Context->LastClock + VideoSeekThreshold)
+		Seek(clock);
+
+	Context->LastClock = clock;
+
+	// Only the latest frame that's due gets uploaded, the ones before it are skipped.
+	VideoFrame due;
+	while (true) {
+		if (!Context->DisplayFrame.frame) {
 			Context->DisplayFrame = Context->GetPendingFrame();
-			Context->CleanFrameAvailable = true;
-			Context->ringbuffer_has_space.notify_one();
+			if (!Context->DisplayFrame.frame)
+				break;
 
-			if (!Context->DisplayFrame.frame) update = false;
+			if (Context->DisplayFrame.generation != Context->Generation) {
+				Context->RecycleFrame(Context->DisplayFrame);
+				continue;
+			}
 		}
+
+		if (Context->DisplayFrame.pts > clock)
+			break;
+
+		if (due.frame)
+			Context->RecycleFrame(due);
+
+		due = Context->DisplayFrame;
+		Context->DisplayFrame.frame = nullptr;
+	}
+
+	if (due.frame) {
+		UpdateVideoTexture(due.frame);
+		Context->RecycleFrame(due);
+
+		if (Registered)
+			VideoDecodeScheduler::Get().Notify();
 	}
 }
 
@@ -344,6 +864,8 @@ void VideoPlayback::UpdateVideoTexture(void * data)
 
 	if (IsValid) {
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (!Context->GPUConvert)
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[0] / 3);
 
 		if (!TextureAssigned) {
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -352,11 +874,24 @@ void VideoPlayback::UpdateVideoTexture(void * data)
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, frame->data[0]);
+			if (Context->GPUConvert) {
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				Context->InitializeGL(w, h, texture);
+			}
+			else
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, frame->data[0]);
+
 			TextureAssigned = true;
 		}
-		else {
+		else if (!Context->GPUConvert) {
 			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, frame->data[0]);
 		}
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+		if (Context->GPUConvert) {
+			Context->UploadPlanes(frame, w, h);
+			Context->ConvertPlanes(w, h);
+		}
 	}
 }
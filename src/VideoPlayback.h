@@ -7,14 +7,17 @@ class VideoPlayback : public Texture
 	double PlaybackTime;
 	uint32_t mFrameQueueItems;
 
-	std::thread *mDecodeThread;
-
-	std::atomic<bool> RunDecodeThread;
 	// I don't want to recompile this file too often
 	// I'm hiding the implementation in VideoPlayback.cpp
 	VideoPlaybackData* Context;
 
-	void QueueFrame(); // It's thread-safe so, go! Put on its own thread, though.
+	// Decoding is done by the shared decode workers.
+	friend class VideoDecodeScheduler;
+	bool Registered;
+
+	// It's thread-safe so, go! Put on its own thread, though.
+	// False once the stream has run out of frames.
+	bool QueueFrame();
 
 	// yeah don't state the type, let the implementation handle that.
 	void UpdateVideoTexture(void* data);
@@ -22,11 +25,22 @@ class VideoPlayback : public Texture
 	VideoPlayback(VideoPlayback&&) = delete;
 	VideoPlayback(VideoPlayback&) = delete;
 public:
-	VideoPlayback(uint32_t framequeueitems = 2);
+	// 0 frames uses the VideoFrameQueue setting.
+	VideoPlayback(uint32_t framequeueitems = 0);
 	~VideoPlayback();
 	bool Open(std::filesystem::path path);
 	void Reset();
 
-	void StartDecodeThread();
+	// Hand the video to the decode workers.
+	void StartDecoding();
+
+	// Drop queued frames and continue decoding from new_clock_time.
+	void Seek(double new_clock_time);
+
+	// Get ready to be displayed from new_clock_time soon, seeking if needed.
+	void Preroll(double new_clock_time);
+
+	// Display the frame due at new_clock_time. Calling this is what marks the video as visible;
+	// videos that aren't updated for a while stop being decoded.
 	void UpdateClock(double new_clock_time);
-};
\ No newline at end of file
+};
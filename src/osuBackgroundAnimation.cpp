@@ -11,6 +11,7 @@
 #include "Logging.h"
 
 #include "VideoPlayback.h"
+#include "StoryboardCache.h"
 
 const float OSB_WIDTH = 640;
 const float OSB_WIDTH_WIDE = 853;
@@ -35,28 +36,10 @@ pivot OriginPivots[] = {
 	{-1.f  , -1.f},
 };
 
-std::function<float(float)> EasingFuncs[] = {
-	ease_none,
-	ease_out,
-	ease_in,
-	ease_out,
-	ease_in,
-	ease_inout,
-	ease_3in,
-	ease_3out,
-	ease_3inout,
-	ease_4in,
-	ease_4out,
-	ease_4inout,
-	ease_5in,
-	ease_5out,
-	ease_5inout
-};
-
 
 namespace osb {
 	Event::Event(EEventType typ) :
-		mEvtType(typ), mEase(EASE_NONE)
+		mEvtType(typ), mEase(EASE_LINEAR)
 	{
 		Time = 0; EndTime = 0;
 	}
@@ -98,12 +81,12 @@ namespace osb {
 
 	void Event::SetEase(int val)
 	{
-		mEase = static_cast<EEase>(Clamp(val, static_cast<int>(EEase::EASE_NONE), static_cast<int>(EEase::EASE_COUNT) - 1));
+		mEase = static_cast<EEasing>(Clamp(val, static_cast<int>(EASE_LINEAR), static_cast<int>(EASE_COUNT) - 1));
 	}
 
 	float SingleValEvent::LerpValue(float At) const
 	{
-		return Lerp(Value, EndValue, EasingFuncs[GetEase()](Clamp((At - Time) / GetDuration(), 0.f, 1.f)));
+		return Lerp(Value, EndValue, ApplyEasing(GetEase(), Clamp((At - Time) / GetDuration(), 0.f, 1.f)));
 	}
 
 	float SingleValEvent::GetValue() const
@@ -148,7 +131,9 @@ namespace osb {
 
 	Vec2 TwoValEvent::LerpValue(float At) const
 	{
-		return Lerp(Value, EndValue, EasingFuncs[GetEase()](Clamp((At - Time) / GetDuration(), 0.f, 1.f)));
+		Vec2 out;
+		LerpEased(GetEase(), Clamp((At - Time) / GetDuration(), 0.f, 1.f), &Value.x, &EndValue.x, &out.x, 2);
+		return out;
 	}
 
 	Vec3 ColorizeEvent::GetValue() const
@@ -174,7 +159,9 @@ namespace osb {
 	Vec3 ColorizeEvent::LerpValue(float At) const
 	{
 		float factor = 1.f / 255.f;
-		return Lerp(Value, EndValue, EasingFuncs[GetEase()](Clamp((At - Time) / GetDuration(), 0.f, 1.f))) * factor;
+		Vec3 out;
+		LerpEased(GetEase(), Clamp((At - Time) / GetDuration(), 0.f, 1.f), &Value.x, &EndValue.x, &out.x, 3);
+		return out * factor;
 	}
 
 	BGASprite::BGASprite(std::string file, EOrigin origin, Vec2 start_pos, ELayer layer) : EventComponent(EVT_COUNT)
@@ -245,6 +232,27 @@ namespace osb {
 		});
 	}
 
+	// Same as GetEvent, but walks forward from where we were last time.
+	// The cursor is still good as long as it's within vec and the event before it starts before Time.
+	template <class T>
+	typename T::iterator GetEvent(float Time, T& vec, size_t &cursor)
+	{
+		auto begin = vec.begin(), end = vec.end();
+		if (cursor > vec.size() || (cursor > 0 && begin[cursor - 1].Time >= Time))
+		{
+			auto it = GetEvent(Time, vec);
+			cursor = it - begin;
+			return it;
+		}
+
+		auto it = begin + cursor;
+		while (it != end && it->Time < Time)
+			++it;
+
+		cursor = it - begin;
+		return it;
+	}
+
 	template <class T>
 	bool ValidateEventIterator(typename T::iterator &it, T& vec)
 	{
@@ -253,6 +261,108 @@ namespace osb {
 		return true;
 	}
 
+	// What ValidateEventIterator gives for events repeated count times, duration apart, from start on:
+	// the last to begin before At, or the first one if none has. first is when the first event begins.
+	// offset is set to the time the event's own times are relative to.
+	template <class T>
+	const T* GetIteratedEvent(float At, const std::vector<T> &vec, float start, float first, float duration, int count, float &offset)
+	{
+		if (vec.empty())
+			return nullptr;
+
+		float local = At - start;
+		int iter = 0;
+		if (duration > 0)
+			iter = int(Clamp(floor(double(local - first) / duration), 0.0, double(count - 1)));
+		else if (local > first)
+			iter = count - 1;
+
+		auto it = lower_bound(vec.begin(), vec.end(), local - duration * iter, [](const T& v, const float &TT)
+		{
+			return v.GetTime() < TT;
+		});
+
+		// Nothing in this iteration has begun yet, so it's the last event of the one before.
+		if (it == vec.begin())
+		{
+			if (iter == 0)
+			{
+				offset = start;
+				return &vec.front();
+			}
+
+			iter--;
+			it = vec.end();
+		}
+
+		offset = start + duration * iter;
+		return &*(it - 1);
+	}
+
+	template <class T>
+	const T* BGASprite::GetLoopedEvent(float Time, std::vector<T> EventComponent::*list, const T* own, float &offset)
+	{
+		const T* current = nullptr;
+		float current_start = 0;
+		bool started = false;
+		offset = 0;
+
+		// Whatever began last before Time wins. If nothing has, whatever begins first.
+		auto consider = [&](const T* evt, float evt_offset)
+		{
+			float evt_start = evt->GetTime() + evt_offset;
+			bool evt_started = evt_start < Time;
+			if (!current ||
+				(evt_started && (!started || evt_start >= current_start)) ||
+				(!evt_started && !started && evt_start < current_start))
+			{
+				current = evt;
+				current_start = evt_start;
+				started = evt_started;
+				offset = evt_offset;
+			}
+		};
+
+		if (own)
+			consider(own, 0);
+
+		float evt_offset;
+		for (auto &loop : mLoops)
+		{
+			auto evt = GetIteratedEvent(Time, loop.*list, loop.GetTime(), loop.GetStartTime(),
+				loop.GetIterationDuration(), loop.GetLoopCount(), evt_offset);
+			if (evt)
+				consider(evt, evt_offset);
+		}
+
+		for (auto &trigger : mTriggers)
+		{
+			if (trigger.GetFiredAt() > Time)
+				continue;
+
+			auto evt = GetIteratedEvent(Time, trigger.*list, trigger.GetFiredAt(), trigger.GetStartTime(), 0, 1, evt_offset);
+			if (evt)
+				consider(evt, evt_offset);
+		}
+
+		return current;
+	}
+
+	template <class T>
+	inline const T* BGASprite::GetCurrentEvent(float Time, std::vector<T> EventComponent::*list, size_t &cursor, float &offset)
+	{
+		auto &own = this->*list;
+		auto it = GetEvent(Time, own, cursor);
+		const T* evt = ValidateEventIterator(it, own) ? &*it : nullptr;
+
+		// Most sprites have neither loops nor triggers.
+		offset = 0;
+		if (mLoops.empty() && mTriggers.empty())
+			return evt;
+
+		return GetLoopedEvent(Time, list, evt, offset);
+	}
+
 	void BGASprite::Update(float Time)
 	{
 		assert (mSprite != nullptr);
@@ -260,20 +370,23 @@ namespace osb {
 		// Now get the values for all the different stuff.
 		
 		// Okay, a pretty long function follows. Fade first.
-		auto fade_evt = GetEvent(Time, evFade);
+		// Events from loops and triggers are relative to them, so they're evaluated at Time - offset.
+		float offset;
+		auto fade_evt = GetCurrentEvent(Time, &BGASprite::evFade, mCursors[EVT_FADE], offset);
 		
-		if (ValidateEventIterator(fade_evt, evFade)) {
+		if (fade_evt) {
 			if (WithinEvents(Time))
-					mSprite->Alpha = fade_evt->LerpValue(Time);
+					mSprite->Alpha = fade_evt->LerpValue(Time - offset);
 			else {
-				if (fade_evt->GetTime() == 0 && mLayer == LAYER_SP_BACKGROUND)
+				if (fade_evt->GetTime() + offset == 0 && mLayer == LAYER_SP_BACKGROUND)
 					mSprite->Alpha = 1;
 				else
 					mSprite->Alpha = 0;
 			}
 		}
 		else {
-			if (WithinEvents(Time))
+			// Sprites made only of triggers show up when one plays.
+			if (WithinEvents(Time) && (HasOwnEvents() || IsTriggered(Time)))
 				mSprite->Alpha = 1;
 			else
 				mSprite->Alpha = 0;
@@ -284,14 +397,14 @@ namespace osb {
 			return;
 
 		// Now position.	
-		auto movx_evt = GetEvent(Time, evMoveX);
-		if (ValidateEventIterator(movx_evt, evMoveX))
-			mTransform.SetPositionX(movx_evt->LerpValue(Time));
+		auto movx_evt = GetCurrentEvent(Time, &BGASprite::evMoveX, mCursors[EVT_MOVEX], offset);
+		if (movx_evt)
+			mTransform.SetPositionX(movx_evt->LerpValue(Time - offset));
 		else mTransform.SetPositionX(mStartPos.x);
 
-		auto movy_evt = GetEvent(Time, evMoveY);
-		if (ValidateEventIterator(movy_evt, evMoveY))
-			mTransform.SetPositionY(movy_evt->LerpValue(Time));
+		auto movy_evt = GetCurrentEvent(Time, &BGASprite::evMoveY, mCursors[EVT_MOVEY], offset);
+		if (movy_evt)
+			mTransform.SetPositionY(movy_evt->LerpValue(Time - offset));
 		else mTransform.SetPositionY(mStartPos.y);
 
 		// We already unpacked move events, so no need for this next snip.
@@ -301,9 +414,9 @@ namespace osb {
 
 		// Now scale and rotation.
 		float scale = 1;
-		auto scale_evt = GetEvent(Time, evScale);
-		if (ValidateEventIterator(scale_evt, evScale))
-			scale = scale_evt->LerpValue(Time);
+		auto scale_evt = GetCurrentEvent(Time, &BGASprite::evScale, mCursors[EVT_SCALE], offset);
+		if (scale_evt)
+			scale = scale_evt->LerpValue(Time - offset);
 		else if (mLayer == osb::LAYER_SP_BACKGROUND && mSprite->GetImage())
 			scale *= OSB_WIDTH_WIDE / mSprite->GetImage()->w;
 		else scale = 1;
@@ -313,15 +426,15 @@ namespace osb {
 		// Since scale is just applied to size straight up, we can use this extra scale
 		// defaulting at 1,1 to be our vector scale. That way they'll pile up.
 		Vec2 vscale;
-		auto vscale_evt = GetEvent(Time, evScaleVec);
-		if (ValidateEventIterator(vscale_evt, evScaleVec))
-			vscale = vscale_evt->LerpValue(Time);
+		auto vscale_evt = GetCurrentEvent(Time, &BGASprite::evScaleVec, mCursors[EVT_SCALEVEC], offset);
+		if (vscale_evt)
+			vscale = vscale_evt->LerpValue(Time - offset);
 		else vscale = Vec2(1, 1);
 
-		auto rot_evt = GetEvent(Time, evRotate);
+		auto rot_evt = GetCurrentEvent(Time, &BGASprite::evRotate, mCursors[EVT_ROTATE], offset);
 		float rot = 0;
-		if (ValidateEventIterator(rot_evt, evRotate)) {
-			rot = rot_evt->LerpValue(Time);
+		if (rot_evt) {
+			rot = rot_evt->LerpValue(Time - offset);
 			mTransform.SetRotation(glm::degrees(rot));
 		}
 		else mTransform.SetRotation(0);
@@ -337,34 +450,35 @@ namespace osb {
 			// Set active scales.
 			mTransform.SetSize(i->w * scale * vscale.x, i->h * scale * vscale.y);
 
+			// The video starts with the sprite, whose period takes in its loops and triggers,
+			// so this holds when the fades only come from those.
 			auto vid = dynamic_cast<VideoPlayback*>(i);
 			if (vid) {
-				vid->UpdateClock(Time - evFade.begin()->GetTime());
+				vid->UpdateClock(Time - GetStartTime());
 			}
 		}
 
 
-		auto colorization_evt = GetEvent(Time, evColorize);
-		if (ValidateEventIterator(colorization_evt, evColorize)) {
-			auto lerp = colorization_evt->LerpValue(Time);
+		auto colorization_evt = GetCurrentEvent(Time, &BGASprite::evColorize, mCursors[EVT_COLORIZE], offset);
+		if (colorization_evt) {
+			auto lerp = colorization_evt->LerpValue(Time - offset);
 			mSprite->Red = lerp.r;
 			mSprite->Green = lerp.g;
 			mSprite->Blue = lerp.b;
 		}
 
 		// The effects after this don't set values before they begin. (Parameter)
-		auto additive_evt = GetEvent(Time, evAdditive);
-		if (additive_evt != evAdditive.begin()
-			&& evAdditive.begin() != evAdditive.end()
-			&& (additive_evt - 1)->GetEndTime() <= Time)
+		auto additive_evt = GetCurrentEvent(Time, &BGASprite::evAdditive, mCursors[EVT_ADDITIVE], offset);
+		if (additive_evt
+			&& additive_evt->GetTime() + offset < Time
+			&& additive_evt->GetEndTime() + offset <= Time)
 			mSprite->SetBlendMode(BLEND_ADD);
 		else mSprite->SetBlendMode(BLEND_ALPHA);
 
-		auto hflip_evt = GetEvent(Time, evFlipH);
-		if (hflip_evt != evFlipH.begin() 
-			&& evFlipH.begin() != evFlipH.end())
+		auto hflip_evt = GetCurrentEvent(Time, &BGASprite::evFlipH, mCursors[EVT_HFLIP], offset);
+		if (hflip_evt && hflip_evt->GetTime() + offset < Time)
 		{
-			if ((hflip_evt - 1)->GetEndTime() <= Time)
+			if (hflip_evt->GetEndTime() + offset <= Time)
 			{
 				mFlip.SetScaleX(-1);
 				mFlip.SetPositionX(1);
@@ -375,11 +489,10 @@ namespace osb {
 			}
 		}
 
-		auto vflip_evt = GetEvent(Time, evFlipV);
-		if (vflip_evt != evFlipV.begin()
-			&& evFlipV.begin() != evFlipV.end())
+		auto vflip_evt = GetCurrentEvent(Time, &BGASprite::evFlipV, mCursors[EVT_VFLIP], offset);
+		if (vflip_evt && vflip_evt->GetTime() + offset < Time)
 		{
-			if ((vflip_evt - 1)->GetEndTime() <= Time)
+			if (vflip_evt->GetEndTime() + offset <= Time)
 			{
 				mFlip.SetScaleY(-1);
 				mFlip.SetPositionY(1);
@@ -401,6 +514,16 @@ namespace osb {
 		return mLayer;
 	}
 
+	EOrigin BGASprite::GetOrigin() const
+	{
+		return mOrigin;
+	}
+
+	Vec2 BGASprite::GetStartPosition() const
+	{
+		return mStartPos;
+	}
+
 	void BGASprite::SetParent(osuBackgroundAnimation* parent)
 	{
 		mParent = parent;
@@ -436,6 +559,7 @@ namespace osb {
 		SortEventList(evFlipV);
 		SortEventList(evAdditive);
 
+		ResetCursors();
 		GetDuration();
 	}
 
@@ -457,14 +581,128 @@ namespace osb {
 		evFlipV = ec.evFlipV;
 		evAdditive = ec.evAdditive;
 
+		ResetCursors();
 		GetDuration(); // recalc. start/end periods
 	}
 
+	// Conversion to and from the compiled storyboard's event records.
+	void PackValues(const Event &evt, PackedEvent &out) {}
+
+	void PackValues(const SingleValEvent &evt, PackedEvent &out)
+	{
+		out.Value[0] = evt.GetValue();
+		out.EndValue[0] = evt.GetEndValue();
+	}
+
+	void PackValues(const TwoValEvent &evt, PackedEvent &out)
+	{
+		out.Value[0] = evt.GetValue().x; out.Value[1] = evt.GetValue().y;
+		out.EndValue[0] = evt.GetEndValue().x; out.EndValue[1] = evt.GetEndValue().y;
+	}
+
+	void PackValues(const ColorizeEvent &evt, PackedEvent &out)
+	{
+		for (int i = 0; i < 3; i++) {
+			out.Value[i] = evt.GetValue()[i];
+			out.EndValue[i] = evt.GetEndValue()[i];
+		}
+	}
+
+	void UnpackValues(const PackedEvent &in, Event &evt) {}
+
+	void UnpackValues(const PackedEvent &in, SingleValEvent &evt)
+	{
+		evt.SetValue(in.Value[0]);
+		evt.SetEndValue(in.EndValue[0]);
+	}
+
+	void UnpackValues(const PackedEvent &in, TwoValEvent &evt)
+	{
+		evt.SetValue(Vec2(in.Value[0], in.Value[1]));
+		evt.SetEndValue(Vec2(in.EndValue[0], in.EndValue[1]));
+	}
+
+	void UnpackValues(const PackedEvent &in, ColorizeEvent &evt)
+	{
+		evt.SetValue(Vec3(in.Value[0], in.Value[1], in.Value[2]));
+		evt.SetEndValue(Vec3(in.EndValue[0], in.EndValue[1], in.EndValue[2]));
+	}
+
+	template <class T>
+	void PackEventList(const T& vec, EEventType type, std::vector<PackedEvent> &out, uint32_t first[], uint32_t count[])
+	{
+		first[type] = out.size();
+		count[type] = vec.size();
+
+		for (auto &evt : vec) {
+			PackedEvent pk = {};
+			pk.Time = evt.GetTime();
+			pk.EndTime = evt.GetEndTime();
+			pk.Ease = evt.GetEase();
+			PackValues(evt, pk);
+			out.push_back(pk);
+		}
+	}
+
+	template <class T>
+	void UnpackEventList(T& vec, EEventType type, const PackedEvent *events, const uint32_t first[], const uint32_t count[])
+	{
+		vec.resize(count[type]);
+
+		auto src = events + first[type];
+		for (auto &evt : vec) {
+			evt.SetTime(src->Time);
+			evt.SetEndTime(src->EndTime);
+			evt.SetEase(src->Ease);
+			UnpackValues(*src, evt);
+			src++;
+		}
+	}
+
+	void EventComponent::PackEvents(std::vector<PackedEvent> &out, uint32_t first[EVT_COUNT], uint32_t count[EVT_COUNT]) const
+	{
+		PackEventList(evMoveX, EVT_MOVEX, out, first, count);
+		PackEventList(evMoveY, EVT_MOVEY, out, first, count);
+		PackEventList(evScale, EVT_SCALE, out, first, count);
+		PackEventList(evScaleVec, EVT_SCALEVEC, out, first, count);
+		PackEventList(evRotate, EVT_ROTATE, out, first, count);
+		PackEventList(evColorize, EVT_COLORIZE, out, first, count);
+		PackEventList(evFade, EVT_FADE, out, first, count);
+		PackEventList(evAdditive, EVT_ADDITIVE, out, first, count);
+		PackEventList(evFlipH, EVT_HFLIP, out, first, count);
+		PackEventList(evFlipV, EVT_VFLIP, out, first, count);
+	}
+
+	void EventComponent::UnpackEvents(const PackedEvent *events, const uint32_t first[EVT_COUNT], const uint32_t count[EVT_COUNT])
+	{
+		UnpackEventList(evMoveX, EVT_MOVEX, events, first, count);
+		UnpackEventList(evMoveY, EVT_MOVEY, events, first, count);
+		UnpackEventList(evScale, EVT_SCALE, events, first, count);
+		UnpackEventList(evScaleVec, EVT_SCALEVEC, events, first, count);
+		UnpackEventList(evRotate, EVT_ROTATE, events, first, count);
+		UnpackEventList(evColorize, EVT_COLORIZE, events, first, count);
+		UnpackEventList(evFade, EVT_FADE, events, first, count);
+		UnpackEventList(evAdditive, EVT_ADDITIVE, events, first, count);
+		UnpackEventList(evFlipH, EVT_HFLIP, events, first, count);
+		UnpackEventList(evFlipV, EVT_VFLIP, events, first, count);
+
+		ResetCursors();
+		GetDuration();
+	}
+
 	EventComponent::EventComponent(EEventType evt): 
 		Event(evt), 
 		StartPeriod(std::numeric_limits<float>::infinity()), 
 		EndPeriod(-StartPeriod)
-	{}
+	{
+		ResetCursors();
+	}
+
+	void EventComponent::ResetCursors()
+	{
+		// Past the end of any list, which GetEvent takes as stale.
+		std::fill(mCursors, mCursors + EVT_COUNT, std::numeric_limits<size_t>::max());
+	}
 
 	float EventComponent::GetStartTime() const
 	{
@@ -554,6 +792,8 @@ namespace osb {
 		evFlipH.clear();
 		evFlipV.clear();
 		evAdditive.clear();
+
+		ResetCursors();
 	}
 
 	// super obtuse way: member functions.
@@ -605,44 +845,141 @@ namespace osb {
 		return max_end - min_end;
 	}
 
-	
-	template <class T>
-	void UnrollEvents(double iter_duration, double Time, uint32_t LoopCount, T& dst, T& src)
-	{
-		for (auto &evt : src) {
-			for (uint32_t i = 0; i < LoopCount; i++) {
-				auto el = evt;
-				el.SetTime(evt.GetTime() + iter_duration * i + Time);
-				el.SetEndTime(evt.GetEndTime() + iter_duration * i + Time);
 
-				// Add into the unrolled events list
-				dst.push_back(el);
-			}
-		}
+	int Loop::GetLoopCount() const
+	{
+		return LoopCount;
 	}
 
-	void Loop::Unroll(EventComponent *ec)
+	float Loop::GetIterationDuration() const
 	{
-		if (!ec) throw std::runtime_error("No event component to unroll to.");
-
-		double iter_duration = GetDuration();
-
-
 		// okay, osu loops are super funky.
 		// a loop's iteration is calculated by dur = last event's end time - first event's start time
 		// not just last event's end time, so events are repeated as soon as the last one of the previous one ends
 		// that means, the time of the next event is not loop start time + max last time of event * iter
 		// but that dur previously mentioned instead.
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evMoveX, evMoveX);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evMoveY, evMoveY);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evScale, evScale);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evScaleVec, evScaleVec);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evRotate, evRotate);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evColorize, evColorize);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evFade, evFade);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evFlipH, evFlipH);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evFlipV, evFlipV);
-		UnrollEvents(iter_duration, Time, LoopCount, ec->evAdditive, evAdditive);
+		return EndPeriod - StartPeriod;
+	}
+
+	Trigger::Trigger(ETrigger kind, int group) :
+		EventComponent(EVT_TRIGGER), mKind(kind), mGroup(group)
+	{
+		Reset();
+	}
+
+	ETrigger Trigger::GetKind() const
+	{
+		return mKind;
+	}
+
+	int Trigger::GetGroup() const
+	{
+		return mGroup;
+	}
+
+	float Trigger::GetFiredAt() const
+	{
+		return mFiredAt;
+	}
+
+	void Trigger::Fire(float Time)
+	{
+		mFiredAt = Time;
+	}
+
+	void Trigger::Reset()
+	{
+		mFiredAt = std::numeric_limits<float>::infinity();
+	}
+
+	void BGASprite::ExtendPeriod(float start, float end)
+	{
+		StartPeriod = std::min(StartPeriod, start);
+		EndPeriod = std::max(EndPeriod, end);
+	}
+
+	void BGASprite::AddLoop(const Loop& loop)
+	{
+		if (loop.GetStartTime() > loop.GetEndTime()) // No events.
+			return;
+
+		mLoops.push_back(loop);
+		ExtendPeriod(loop.GetTime() + loop.GetStartTime(),
+			loop.GetTime() + loop.GetStartTime() + loop.GetIterationDuration() * loop.GetLoopCount());
+	}
+
+	void BGASprite::AddTrigger(const Trigger& trigger)
+	{
+		if (trigger.GetStartTime() > trigger.GetEndTime())
+			return;
+
+		mTriggers.push_back(trigger);
+		ExtendPeriod(trigger.GetTime(), trigger.Event::GetEndTime() + trigger.GetEndTime());
+	}
+
+	const std::vector<Loop>& BGASprite::GetLoops() const
+	{
+		return mLoops;
+	}
+
+	const std::vector<Trigger>& BGASprite::GetTriggers() const
+	{
+		return mTriggers;
+	}
+
+	bool BGASprite::HasTriggers() const
+	{
+		return !mTriggers.empty();
+	}
+
+	void BGASprite::SortEvents()
+	{
+		EventComponent::SortEvents();
+
+		for (auto &loop : mLoops)
+			ExtendPeriod(loop.GetTime() + loop.GetStartTime(),
+				loop.GetTime() + loop.GetStartTime() + loop.GetIterationDuration() * loop.GetLoopCount());
+
+		for (auto &trigger : mTriggers)
+			ExtendPeriod(trigger.GetTime(), trigger.Event::GetEndTime() + trigger.GetEndTime());
+	}
+
+	void BGASprite::CopyEventsFrom(BGASprite &sp)
+	{
+		EventComponent::CopyEventsFrom(sp);
+		mLoops = sp.mLoops;
+		mTriggers = sp.mTriggers;
+		SortEvents();
+	}
+
+	void BGASprite::FireTriggers(ETrigger kind, float Time)
+	{
+		for (auto &trigger : mTriggers)
+		{
+			if (trigger.GetKind() != kind || Time < trigger.GetTime() || Time > trigger.Event::GetEndTime())
+				continue;
+
+			for (auto &other : mTriggers)
+				if (other.GetGroup() == trigger.GetGroup())
+					other.Reset();
+
+			trigger.Fire(Time);
+		}
+	}
+
+	bool BGASprite::HasOwnEvents() const
+	{
+		return !(evMoveX.empty() && evMoveY.empty() && evScale.empty() && evScaleVec.empty() && evRotate.empty() &&
+			evColorize.empty() && evFade.empty() && evFlipH.empty() && evFlipV.empty() && evAdditive.empty() && mLoops.empty());
+	}
+
+	bool BGASprite::IsTriggered(float Time) const
+	{
+		for (auto &trigger : mTriggers)
+			if (trigger.GetFiredAt() <= Time && Time <= trigger.GetFiredAt() + trigger.GetEndTime())
+				return true;
+
+		return false;
 	}
 }
 
@@ -664,6 +1001,18 @@ osb::EOrigin OriginFromString(std::string str)
 	return osb::PP_TOPLEFT;
 }
 
+osb::ETrigger TriggerFromString(std::string str)
+{
+	if (str == "hitsound") return osb::TRIGGER_HITSOUND;
+	if (str == "passing") return osb::TRIGGER_PASSING;
+	if (str == "failing") return osb::TRIGGER_FAILING;
+
+	// HitSound triggers filtered by sample set or addition never fire: hits don't tell us their hitsounds.
+	if (OSBDebug)
+		Log::LogPrintf("OSB: Unsupported trigger type: %s.\n", str.c_str());
+	return osb::TRIGGER_UNKNOWN;
+}
+
 osb::ELayer LayerFromString(std::string str)
 {
 	if (str == "background") return osb::LAYER_BACKGROUND;
@@ -676,16 +1025,38 @@ osb::ELayer LayerFromString(std::string str)
 	return osb::LAYER_BACKGROUND;
 }
 
+// Fields a line of this event type needs: the type, then easing, start and end times and the first value,
+// except for loops (type, start, count) and triggers (type, kind, start, end). 0 for types we don't know.
+size_t GetMinimumEventFields(const std::string &ks)
+{
+	if (ks == "L") return 3;
+	if (ks == "T") return 4;
+	if (ks == "M" || ks == "V") return 6;
+	if (ks == "C") return 7;
+	if (ks == "F" || ks == "S" || ks == "R" || ks == "MX" || ks == "MY" || ks == "P") return 5;
+	return 0;
+}
+
 std::shared_ptr<osb::Event> ParseEvent(std::vector<std::string> split)
 {
+	if (split.empty())
+		return nullptr;
+
 	auto ks = split[0];
 	std::shared_ptr<osb::Event> evt;
 	boost::algorithm::to_upper(ks);
 
+	if (split.size() < GetMinimumEventFields(ks))
+	{
+		if (OSBDebug)
+			Log::LogPrintf("OSB: \"%s\" event is missing fields.\n", ks.c_str());
+		return nullptr;
+	}
+
 	if (ks == "V"){
 		auto xvt = std::make_shared<osb::VectorScaleEvent>();
 		xvt->SetValue(Vec2(latof(split[4]), latof(split[5])));
-		if (split.size() > 6)
+		if (split.size() > 7)
 			xvt->SetEndValue(Vec2(latof(split[6]), latof(split[7])));
 		else 
 			xvt->SetEndValue(Vec2(latof(split[4]), latof(split[5])));
@@ -703,7 +1074,7 @@ std::shared_ptr<osb::Event> ParseEvent(std::vector<std::string> split)
 	if (ks == "M") {
 		auto xvt = std::make_shared<osb::MoveEvent>();
 		xvt->SetValue(Vec2(latof(split[4]), latof(split[5])));
-		if (split.size() > 6)
+		if (split.size() > 7)
 			xvt->SetEndValue(Vec2(latof(split[6]), latof(split[7])));
 		else
 			xvt->SetEndValue(Vec2(latof(split[4]), latof(split[5])));
@@ -730,7 +1101,7 @@ std::shared_ptr<osb::Event> ParseEvent(std::vector<std::string> split)
 	if (ks == "C") {
 		auto xvt = std::make_shared<osb::ColorizeEvent>();
 		xvt->SetValue(Vec3(latof(split[4]), latof(split[5]), latof(split[6])));
-		if (split.size() > 7)
+		if (split.size() > 9)
 			xvt->SetEndValue(Vec3(latof(split[7]), latof(split[8]), latof(split[9])));
 		else
 			xvt->SetEndValue(Vec3(latof(split[4]), latof(split[5]), latof(split[6])));
@@ -772,7 +1143,10 @@ std::shared_ptr<osb::Event> ParseEvent(std::vector<std::string> split)
 	}
 	if (ks == "T")
 	{
-		throw std::runtime_error("OSB: Storyboards using triggers is not supported.");
+		auto xvt = std::make_shared<osb::Trigger>(TriggerFromString(split[1]), split.size() > 4 ? int(latof(split[4])) : 0);
+		xvt->SetTime(latof(split[2]) / 1000.0);
+		xvt->SetEndTime(latof(split[3]) / 1000.0);
+		return xvt;
 	}
 
 	if (evt) {
@@ -797,7 +1171,7 @@ osb::SpriteList ReadOSBEvents(std::istream& event_str)
 	int loop_lead = -1;
 	osb::BGASprite* previous_background = nullptr;
 	osb::BGASprite* sprite = nullptr;
-	std::shared_ptr<osb::Loop> loop = nullptr;
+	std::shared_ptr<osb::EventComponent> loop = nullptr; // or trigger
 
 	std::string line;
 	/*
@@ -819,10 +1193,13 @@ osb::SpriteList ReadOSBEvents(std::istream& event_str)
 		return striped_filename;
 	};
 
-	auto unroll_loop_into_sprite = [&]()
+	auto close_loop = [&]()
 	{
-		osb::EventVector vec;
-		loop->Unroll(sprite);
+		loop->SortEvents();
+		if (loop->GetEventType() == osb::EVT_LOOP)
+			sprite->AddLoop(*std::static_pointer_cast<osb::Loop>(loop));
+		else
+			sprite->AddTrigger(*std::static_pointer_cast<osb::Trigger>(loop));
 		loop = nullptr;
 	};
 
@@ -930,11 +1307,11 @@ osb::SpriteList ReadOSBEvents(std::istream& event_str)
 			if (loop)
 			{
 				if (lead_spaces < previous_lead || lead_spaces == loop_lead) {
-					// We're done reading the loop - unroll it.
-					unroll_loop_into_sprite();
+					// We're done reading the loop - give it to the sprite.
+					close_loop();
 				}
-				else
-					loop->AddEvent(ParseEvent(split_result));
+				else if (auto ev = ParseEvent(split_result))
+					loop->AddEvent(ev);
 			}
 			
 			// It's not a command on the loop, or we weren't reading a loop in the first place.
@@ -956,13 +1333,13 @@ osb::SpriteList ReadOSBEvents(std::istream& event_str)
 						if (!sprite)
 							throw std::runtime_error("OSB command unpaired with sprite.");
 
-						// A loop began - set that we are reading a loop and set this loop as where to add the following commands.
-						if (ev->GetEventType() == osb::EVT_LOOP)
+						// A loop or trigger began - set that we are reading a loop and set this loop as where to add the following commands.
+						if (ev->GetEventType() == osb::EVT_LOOP || ev->GetEventType() == osb::EVT_TRIGGER)
 						{
-							loop = std::static_pointer_cast<osb::Loop>(ev);
+							loop = std::static_pointer_cast<osb::EventComponent>(ev);
 							loop_lead = lead_spaces;
 						}
-						else // add this event, if not a loop to this mSprite. It'll be unrolled once outside.
+						else // add this event, if not a loop to this mSprite.
 						{
 							sprite->AddEvent(ev);
 						}
@@ -974,11 +1351,32 @@ osb::SpriteList ReadOSBEvents(std::istream& event_str)
 		previous_lead = lead_spaces;
 	}
 
-	if (sprite)
-		sprite->SortEvents();
 	// we have a pending loop? oops sorry
 	if (sprite && loop)
-		unroll_loop_into_sprite();
+		close_loop();
+	if (sprite)
+		sprite->SortEvents();
+
+	return list;
+}
+
+osb::SpriteList LoadOSBEvents(const std::string& events)
+{
+	osb::SpriteList list;
+	std::string key;
+
+	if (StoryboardCache::IsEnabled())
+	{
+		key = StoryboardCache::GetKey(events);
+		if (StoryboardCache::Fetch(key, list))
+			return list;
+	}
+
+	std::stringstream ss(events);
+	list = ReadOSBEvents(ss);
+
+	if (key.length())
+		StoryboardCache::Store(key, list);
 
 	return list;
 }
@@ -1028,6 +1426,10 @@ osuBackgroundAnimation::osuBackgroundAnimation(Interruptible* parent, osb::Sprit
 	mScreenTransformation.ChainTransformation(&Transform);
 	Song = song;
 	CanValidate = false;
+	mImageList.SetCompressible(true);
+	mNextSprite = 0;
+	mLastTime = std::numeric_limits<double>::infinity();
+	mFailing = false;
 
 	int video_index = 0;
 	if (existing_mSprites) {
@@ -1039,7 +1441,7 @@ osuBackgroundAnimation::osuBackgroundAnimation(Interruptible* parent, osb::Sprit
 				video_index--;
 				auto vid = mVideoList[video_index] = new VideoPlayback();
 				if (vid->Open(vpath)) {
-					vid->StartDecodeThread();
+					vid->StartDecoding();
 					mImageList.AddToListIndex(vid, video_index);
 				}
 			} else {
@@ -1090,7 +1492,8 @@ void osuBackgroundAnimation::Load()
 
 		if (std::getline(s, head) && head == "[Events]")
 		{
-			auto mSprite_list = ReadOSBEvents(s);
+			std::string events((std::istreambuf_iterator<char>(s)), std::istreambuf_iterator<char>());
+			auto mSprite_list = LoadOSBEvents(events);
 
 			// at this point i honestly forgot the type of this thing
 			auto newlist = osb::SpriteList();
@@ -1194,6 +1597,56 @@ void osuBackgroundAnimation::Validate()
 				Log::LogPrintf(" Warning: Non-existing layer.\n");
 		}
 	}
+
+	BuildSpriteIndex();
+}
+
+void osuBackgroundAnimation::BuildSpriteIndex()
+{
+	mSpritesByStart.clear();
+	mPersistentSprites.clear();
+	mActiveSprites.clear();
+	mTriggerSprites.clear();
+
+	for (size_t i = 0; i < mSprites.size(); i++)
+	{
+		if (mSprites[i].GetLayer() == osb::LAYER_SP_BACKGROUND)
+			mPersistentSprites.push_back(i);
+		else
+			mSpritesByStart.push_back(i);
+
+		if (mSprites[i].HasTriggers())
+			mTriggerSprites.push_back(i);
+	}
+
+	std::stable_sort(mSpritesByStart.begin(), mSpritesByStart.end(), [&](size_t a, size_t b) {
+		return mSprites[a].GetStartTime() < mSprites[b].GetStartTime();
+	});
+
+	// Force a full update the first time around.
+	mNextSprite = 0;
+	mLastTime = std::numeric_limits<double>::infinity();
+}
+
+// Seek fallback: update everything once, so sprites we're skipping over are left hidden,
+// then find the sprites alive at Time.
+void osuBackgroundAnimation::RebuildActiveSprites(double Time)
+{
+	float t = Time;
+
+	mActiveSprites.clear();
+	for (mNextSprite = 0; mNextSprite < mSpritesByStart.size(); mNextSprite++)
+	{
+		auto &sp = mSprites[mSpritesByStart[mNextSprite]];
+		if (sp.GetStartTime() > t)
+			break;
+
+		if (sp.GetEndTime() >= t)
+			mActiveSprites.push_back(mSpritesByStart[mNextSprite]);
+	}
+
+	for (auto&& item : mSprites)
+		item.Update(Time);
 }
 
 void osuBackgroundAnimation::SetAnimationTime(double Time)
@@ -1201,9 +1654,43 @@ void osuBackgroundAnimation::SetAnimationTime(double Time)
 	if (!CanValidate)
 		return;
 
-	for (auto&& item: mSprites)
+	for (auto i : mPersistentSprites)
+		mSprites[i].Update(Time);
+
+	if (Time < mLastTime)
 	{
-		item.Update(Time);
+		RebuildActiveSprites(Time);
+		mLastTime = Time;
+		return;
+	}
+
+	mLastTime = Time;
+	float t = Time;
+
+	// Let in the sprites that started since. Anything that started and ended
+	// between two frames was never visible and stays hidden.
+	for (; mNextSprite < mSpritesByStart.size(); mNextSprite++)
+	{
+		auto idx = mSpritesByStart[mNextSprite];
+		if (mSprites[idx].GetStartTime() > t)
+			break;
+
+		if (mSprites[idx].GetEndTime() >= t)
+			mActiveSprites.push_back(idx);
+	}
+
+	// Update the live ones. Those past their end get a last update to hide them and are dropped.
+	for (size_t i = 0; i < mActiveSprites.size();)
+	{
+		auto &sp = mSprites[mActiveSprites[i]];
+		sp.Update(Time);
+
+		if (sp.GetEndTime() < t)
+		{
+			mActiveSprites[i] = mActiveSprites.back();
+			mActiveSprites.pop_back();
+		}
+		else i++;
 	}
 }
 
@@ -1211,12 +1698,43 @@ void osuBackgroundAnimation::Update(float Delta)
 {
 }
 
+void osuBackgroundAnimation::FireTriggers(osb::ETrigger kind)
+{
+	if (!std::isfinite(mLastTime))
+		return;
+
+	for (auto i : mTriggerSprites)
+		mSprites[i].FireTriggers(kind, mLastTime);
+}
+
+void osuBackgroundAnimation::OnHit()
+{
+	FireTriggers(osb::TRIGGER_HITSOUND);
+
+	if (mFailing)
+	{
+		mFailing = false;
+		FireTriggers(osb::TRIGGER_PASSING);
+	}
+}
+
+void osuBackgroundAnimation::OnMiss()
+{
+	if (!mFailing)
+	{
+		mFailing = true;
+		FireTriggers(osb::TRIGGER_FAILING);
+	}
+}
+
 void osuBackgroundAnimation::Render()
 {
 	for (auto&& item : mAutoBGLayer)
-		item.Render();
+		mBatch.Add(item);
 	for (auto&& item: mBackgroundLayer)
-		item.Render();
+		mBatch.Add(item);
 	for (auto&& item: mForegroundLayer)
-		item.Render();
+		mBatch.Add(item);
+
+	mBatch.Render();
 }
@@ -5,6 +5,7 @@
 #include "ImageList.h"
 #include "Easing.h"
 #include "SceneEnvironment.h"
+#include "SpriteBatch.h"
 
 class osuBackgroundAnimation;
 
@@ -30,36 +31,16 @@ namespace osb
 		EVT_VFLIP,
         EVT_COUNT,
 		// Non-events (to be unpacked)
-        EVT_LOOP, // Unroll once finished loading into regular events.
-        EVT_MOVE
+        EVT_LOOP, // Kept apart from the sprite's own events, see Loop.
+        EVT_MOVE,
+		EVT_TRIGGER
     };
 
-	enum EEase : int
-	{
-		EASE_NONE,
-		EASE_OUT,
-		EASE_IN,
-		EASE_2IN,
-		EASE_2OUT,
-		EASE_2INOUT,
-		EASE_3IN,
-		EASE_3OUT,
-		EASE_3INOUT,
-		EASE_4IN,
-		EASE_4OUT,
-		EASE_4INOUT,
-		EASE_5IN,
-		EASE_5OUT,
-		EASE_5INOUT,
-		EASE_COUNT
-		// And many others, tho nobody uses them lol.
-	};
-
 
     class Event : public TimeBased<Event, float>
     {
         EEventType mEvtType;
-		EEase mEase;
+		EEasing mEase;
     protected:
         float EndTime;
         explicit Event(EEventType typ);
@@ -217,6 +198,14 @@ namespace osb
 		LAYER_FOREGROUND
 	};
 
+	// An event as stored in the compiled storyboard cache. Values the event type doesn't use are 0.
+	struct PackedEvent
+	{
+		float Time, EndTime;
+		int32_t Ease;
+		float Value[3], EndValue[3];
+	};
+
     class EventComponent : public Event
     {
     protected:
@@ -232,29 +221,77 @@ namespace osb
 		std::vector<AdditiveEvent> evAdditive;
 
 		float StartPeriod, EndPeriod;
+
+		// Per list, index of the first event starting at or after the last time looked up.
+		// Moved forward during playback, looked up again when time goes back or after ResetCursors.
+		size_t mCursors[EVT_COUNT];
+
 	    EventComponent(EEventType evt);
-		friend class Loop;
     public:
         void AddEvent(std::shared_ptr<Event> evt);
 		void ClearEvents();
         void SortEvents();
+
+		// Forget where the last lookups landed, so the next ones search each whole list.
+		void ResetCursors();
 	    bool WithinEvents(float Time) const;
 		float GetStartTime() const;
 		float GetEndTime() const;
 		void CopyEventsFrom(EventComponent &ec);
         float GetDuration();
+
+		// Append every event list to out, one after another. first and count are indexed by EEventType.
+		void PackEvents(std::vector<PackedEvent> &out, uint32_t first[EVT_COUNT], uint32_t count[EVT_COUNT]) const;
+
+		// Replace our events with already sorted ones from PackEvents.
+		void UnpackEvents(const PackedEvent *events, const uint32_t first[EVT_COUNT], const uint32_t count[EVT_COUNT]);
     };
 
+	/*
+		Events repeated LoopCount times from the loop's Time on. They're stored once, with times relative
+		to the loop, and looked up modulo the iteration duration instead of being copied for every iteration.
+	*/
     class Loop : public EventComponent
     {
         int LoopCount;
-        // EndTime is the last loop's time in here.
     public:
-		Loop(int loop_count) : EventComponent(EVT_LOOP), LoopCount(loop_count) {}
+		Loop(int loop_count) : EventComponent(EVT_LOOP), LoopCount(std::max(loop_count, 1)) {}
 
-        void Unroll(EventComponent* evt_list);
+		int GetLoopCount() const;
+
+		// osu! starts an iteration as soon as the previous one's last event ends.
+		float GetIterationDuration() const;
     };
 
+	enum ETrigger
+	{
+		TRIGGER_UNKNOWN,
+		TRIGGER_HITSOUND,
+		TRIGGER_PASSING,
+		TRIGGER_FAILING
+	};
+
+	/*
+		Events played once, relative to when the trigger last fired within [Time, EndTime].
+		Firing a trigger stops the others in its group.
+	*/
+	class Trigger : public EventComponent
+	{
+		ETrigger mKind;
+		int mGroup;
+		float mFiredAt;
+	public:
+		Trigger(ETrigger kind, int group);
+
+		ETrigger GetKind() const;
+		int GetGroup() const;
+
+		// Time it last fired, or infinity if it hasn't.
+		float GetFiredAt() const;
+		void Fire(float Time);
+		void Reset();
+	};
+
     class BGASprite : public EventComponent
     {
         EOrigin mOrigin;
@@ -270,14 +307,45 @@ namespace osb
 
 		ELayer mLayer;
 		bool mUninitialized;
+
+		std::vector<Loop> mLoops;
+		std::vector<Trigger> mTriggers;
+
+		void ExtendPeriod(float start, float end);
+
+		// Anything besides triggers? Is a trigger playing at Time?
+		bool HasOwnEvents() const;
+		bool IsTriggered(float Time) const;
+
+		// The event at Time among ours (own), our loops' and our triggers'. Their events are relative to offset.
+		template <class T>
+		const T* GetLoopedEvent(float Time, std::vector<T> EventComponent::*list, const T* own, float &offset);
+		template <class T>
+		const T* GetCurrentEvent(float Time, std::vector<T> EventComponent::*list, size_t &cursor, float &offset);
     public:
         BGASprite(std::string file, EOrigin origin, Vec2 start_pos, ELayer laer);
 
+		// The loop and trigger must already be sorted.
+		void AddLoop(const Loop& loop);
+		void AddTrigger(const Trigger& trigger);
+		const std::vector<Loop>& GetLoops() const;
+		const std::vector<Trigger>& GetTriggers() const;
+		bool HasTriggers() const;
+
+		// Same as EventComponent's, but our period covers loops and triggers as well.
+		void SortEvents();
+		void CopyEventsFrom(BGASprite &sp);
+
+		// Fire our triggers of kind whose window contains Time.
+		void FireTriggers(ETrigger kind, float Time);
+
 		void SetSprite(Sprite* sprite);
 	    void InitializeSprite();
 	    void Update(float Time);
         std::string GetImageFilename() const;
 		ELayer GetLayer() const;
+		EOrigin GetOrigin() const;
+		Vec2 GetStartPosition() const;
         void SetParent(osuBackgroundAnimation* parent);
 	    void SetImageIndex(int index);
     };
@@ -302,6 +370,26 @@ class osuBackgroundAnimation : public BackgroundAnimation
     Transformation mScreenTransformation;
     bool CanValidate;
 
+	// All three layers go through here, in order.
+	SpriteBatch mBatch;
+
+	// Sprite indices sorted by start time, the special background sprites (visible outside their events)
+	// and the sprites whose lifetime contains the last time we were set to.
+	std::vector<size_t> mSpritesByStart;
+	std::vector<size_t> mPersistentSprites;
+	std::vector<size_t> mActiveSprites;
+	size_t mNextSprite;
+	double mLastTime;
+
+	// Sprites with trigger groups, and whether the player was last failing, for Passing/Failing triggers.
+	std::vector<size_t> mTriggerSprites;
+	bool mFailing;
+
+	void FireTriggers(osb::ETrigger kind);
+
+	void BuildSpriteIndex();
+	void RebuildActiveSprites(double Time);
+
 public:
     osuBackgroundAnimation(Interruptible* parent, osb::SpriteList* existing_sprites, Game::VSRG::Song* song);
     ~osuBackgroundAnimation();
@@ -313,7 +401,12 @@ public:
 	void Validate() override;
 	void Update(float Delta) override;
 	void SetAnimationTime(double Time) override;
+	void OnHit() override;
+	void OnMiss() override;
 	void Render() override;
 };
 
-osb::SpriteList ReadOSBEvents(std::istream& event_str);
\ No newline at end of file
+osb::SpriteList ReadOSBEvents(std::istream& event_str);
+
+// Same as ReadOSBEvents, but goes through the compiled storyboard cache.
+osb::SpriteList LoadOSBEvents(const std::string& events);
\ No newline at end of file
@@ -99,6 +99,7 @@
 #include <string>
 #include <future>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -3,9 +3,22 @@
 #include "../src/Song.h"
 #include "../src/Song7K.h"
 #include "../src/SongLoader.h"
+#include "../src/SongDatabase.h"
+#include "../src/SongList.h"
+#include "../src/SongScanner.h"
+#include "../src/Fingerprint.h"
 #include "../src/BackgroundAnimation.h"
+#include "../src/Sprite.h"
+#include "../src/osuBackgroundAnimation.h"
+#include "../src/StoryboardCache.h"
+#include "../src/Texture.h"
+#include "../src/ImageLoader.h"
+#include "../src/VideoPlayback.h"
+#include "../src/ImageStreamer.h"
 
 #include "../src/LuaManager.h"
+#include "../src/SceneEnvironment.h"
+#include "../src/Easing.h"
 #include "../src/Noteskin.h"
 
 #include "../src/PlayerChartData.h"
@@ -53,4 +66,671 @@ TEST_CASE("Speed support")
 	auto pcd = Game::VSRG::PlayerChartState::FromDifficulty(sng->GetDifficulty(0));
 	auto tbeat = pcd.GetTimeAtBeat(93. + 4.);
 	REQUIRE(pcd.GetSpeedMultiplierAt(tbeat) == 0.250);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Song scans list songs in directory order whatever the thread count")
+{
+	auto Root = std::filesystem::temp_directory_path() / "raindrop-scan-test";
+	std::filesystem::remove_all(Root);
+
+	for (int i = 0; i < 16; i++)
+	{
+		auto Dir = Root / ("Song " + std::to_string(i));
+		std::filesystem::create_directories(Dir);
+		std::filesystem::copy_file("tests/files/jnight.ssc", Dir / "chart.ssc");
+	}
+
+	// What a serial scan goes by.
+	std::vector<std::filesystem::path> Expected;
+	for (auto &i : std::filesystem::directory_iterator(Root))
+		Expected.push_back(i.path());
+
+	auto OldThreads = Configuration::GetConfigs("SongScanThreads");
+	auto Scan = [&](std::string Threads) {
+		Configuration::SetConfig("SongScanThreads", Threads);
+
+		// A new database each time, so every song gets parsed.
+		auto DBFile = (Root / ("songs-" + Threads + ".db")).string();
+		std::vector<std::filesystem::path> Found;
+		{
+			SongDatabase DB(DBFile);
+			SongLoader Loader(&DB);
+			SongList List;
+			std::mutex ListMutex;
+
+			{
+				SongScanner Scanner(&Loader, ListMutex);
+				Scanner.AddNamedDirectory(&List, Root, "Songs");
+			}
+
+			REQUIRE(List.GetNumEntries() == 1);
+			auto Songs = List.GetListEntry(0);
+			for (unsigned i = 0; i < Songs->GetNumEntries(); i++)
+				Found.push_back(Songs->GetSongEntry(i)->SongDirectory);
+		}
+
+		std::filesystem::remove(DBFile);
+		return Found;
+	};
+
+	auto Serial = Scan("1");
+	auto Parallel = Scan("8");
+	Configuration::SetConfig("SongScanThreads", OldThreads);
+	std::filesystem::remove_all(Root);
+
+	REQUIRE(Serial == Expected);
+	REQUIRE(Parallel == Expected);
+}
+
+TEST_CASE("Configuration changes are told to listeners")
+{
+	CfgVar Threads("SongScanThreads");
+	auto Old = Configuration::GetConfigs("SongScanThreads");
+
+	std::vector<std::string> Changes;
+	float Seen = 0;
+	auto ID = Configuration::AddChangeListener([&](const std::string &Name, const std::string &Namespace) {
+		Changes.push_back(Namespace + "/" + Name);
+		Seen = Threads;
+	});
+
+	Configuration::SetConfig("SongScanThreads", "3");
+	REQUIRE((Changes == std::vector<std::string>{ "Global/SongScanThreads" }));
+	REQUIRE(Seen == 3);
+
+	Configuration::RemoveChangeListener(ID);
+	Configuration::SetConfig("SongScanThreads", Old);
+	REQUIRE(Changes.size() == 1);
+}
+
+TEST_CASE("Chart fingerprints are XXH64")
+{
+	// xxhsum's sanity vectors: 101 bytes of its generated buffer, and seed 2654435761.
+	uint8_t buf[101];
+	uint32_t gen = 2654435761U;
+	for (auto &b : buf)
+	{
+		b = uint8_t(gen >> 24);
+		gen *= gen;
+	}
+
+	const uint64_t seed = 2654435761U;
+	REQUIRE(Fingerprint::Hash(nullptr, 0) == 0xEF46DB3751D8E999ULL);
+	REQUIRE(Fingerprint::Hash(nullptr, 0, seed) == 0xAC75FDA2929B17EFULL);
+	REQUIRE(Fingerprint::Hash(buf, 1) == 0x4FCE394CC88952D8ULL);
+	REQUIRE(Fingerprint::Hash(buf, 1, seed) == 0x739840CB819FA723ULL);
+	REQUIRE(Fingerprint::Hash(buf, 14) == 0xCFFA8DB881BC3A3DULL);
+	REQUIRE(Fingerprint::Hash(buf, 14, seed) == 0x5B9611585EFCC9CBULL);
+	REQUIRE(Fingerprint::Hash(buf, 101) == 0x0EAB543384F878ADULL);
+	REQUIRE(Fingerprint::Hash(buf, 101, seed) == 0xCAA65939306F1E21ULL);
+
+	std::string fox = "The quick brown fox jumps over the lazy dog";
+	REQUIRE(Fingerprint::Hash(fox.data(), fox.length()) == 0x0B242D361FDA71BCULL);
+	REQUIRE(Fingerprint::ToString(0x0B242D361FDA71BCULL) == "0b242d361fda71bc");
+}
+
+TEST_CASE("Log messages from several threads come out whole and in order")
+{
+	const int Threads = 4, Messages = 2000;
+
+	std::vector<std::thread> Writers;
+	for (int t = 0; t < Threads; t++)
+	{
+		Writers.push_back(std::thread([t]() {
+			for (int i = 0; i < Messages; i++)
+				Log::Logf("interleave-test %d %d end\n", t, i);
+		}));
+	}
+
+	for (auto &w : Writers)
+		w.join();
+
+	// Longer than the ring's slots used to be.
+	std::string Long(1500, 'x');
+	Log::Logf("long-test %s end\n", Long.c_str());
+	Log::Flush();
+
+	std::ifstream in("log.txt");
+	std::vector<int> Next(Threads, 0);
+	bool FoundLong = false;
+	std::string Line;
+	while (std::getline(in, Line))
+	{
+		if (Line.compare(0, 10, "long-test ") == 0)
+			FoundLong = Line == "long-test " + Long + " end";
+
+		int t, i;
+		char End[4] = {};
+		if (sscanf(Line.c_str(), "interleave-test %d %d %3s", &t, &i, End) != 3)
+			continue;
+
+		REQUIRE(std::string(End) == "end");
+		REQUIRE(t >= 0);
+		REQUIRE(t < Threads);
+		REQUIRE(i == Next[t]);
+		Next[t]++;
+	}
+
+	for (int t = 0; t < Threads; t++)
+		REQUIRE(Next[t] == Messages);
+	REQUIRE(FoundLong);
+}
+
+TEST_CASE("Skin easing numbers keep their meaning")
+{
+	// EaseIn and EaseOut as skins have always had them.
+	REQUIRE(LuaEaseIn == 1);
+	REQUIRE(LuaEaseOut == 2);
+	REQUIRE(ApplyEasing(EasingFromLua(LuaEaseIn), 0.5f) == Approx(0.25f));
+	REQUIRE(ApplyEasing(EasingFromLua(LuaEaseOut), 0.5f) == Approx(0.75f));
+
+	REQUIRE(EasingFromLua(0) == EASE_LINEAR);
+	REQUIRE(EasingFromLua(EASE_QUAD_IN) == EASE_QUAD_IN);
+	REQUIRE(EasingFromLua(EASE_CUBIC_OUT) == EASE_CUBIC_OUT);
+	REQUIRE(EasingFromLua(EASE_BOUNCE_INOUT) == EASE_BOUNCE_INOUT);
+	REQUIRE(EasingFromLua(-1) == EASE_LINEAR);
+	REQUIRE(EasingFromLua(1000) == EASE_COUNT - 1);
+}
+
+TEST_CASE("Scene objects keep their draw order when their layer changes")
+{
+	SceneEnvironment env("Test");
+	Sprite a(false), b(false), c(false), d(false), e(false);
+	a.SetZ(1); b.SetZ(2); c.SetZ(1); d.SetZ(2);
+	env.AddTarget(&a);
+	env.AddTarget(&b);
+	env.AddTarget(&c);
+	env.AddTarget(&d);
+	env.Sort();
+
+	using Order = std::vector<Drawable2D*>;
+	REQUIRE((env.GetDrawOrder() == Order{ &a, &c, &b, &d }));
+
+	// Moving up lands ahead of the objects already on the layer, moving down behind them,
+	// just as a stable sort of everything by Z would have it.
+	b.SetZ(1);
+	env.Sort();
+	REQUIRE((env.GetDrawOrder() == Order{ &a, &c, &b, &d }));
+
+	c.SetZ(2);
+	env.Sort();
+	REQUIRE((env.GetDrawOrder() == Order{ &a, &b, &c, &d }));
+
+	d.SetZ(1);
+	env.Sort();
+	REQUIRE((env.GetDrawOrder() == Order{ &a, &b, &d, &c }));
+
+	env.RemoveTarget(&a);
+	e.SetZ(1);
+	env.AddTarget(&e);
+	c.SetZ(1);
+	env.Sort();
+	REQUIRE((env.GetDrawOrder() == Order{ &b, &d, &c, &e }));
+
+	for (auto i : env.GetDrawOrder())
+		REQUIRE(i->GetZ() == 1);
+}
+
+TEST_CASE("Tweens carry leftover delay into their first step")
+{
+	SceneEnvironment env("Test");
+	Sprite s(false);
+	s.SetPositionX(-1);
+	env.AddTarget(&s);
+
+	env.AddTween(&s, "X", 0, 100, 1, 0, 0.5f, "");
+	env.UpdateTargets(0.25);
+	REQUIRE(s.GetPositionX() == -1);
+
+	// 0.25 past the delay.
+	env.UpdateTargets(0.5);
+	REQUIRE(s.GetPositionX() == Approx(25));
+
+	env.UpdateTargets(1);
+	REQUIRE(s.GetPositionX() == Approx(100));
+}
+
+TEST_CASE("Tweens to a value start from where the property is once the delay is over")
+{
+	SceneEnvironment env("Test");
+	Sprite s(false);
+	s.SetPositionX(10);
+	env.AddTarget(&s);
+
+	env.AddTweenTo(&s, "X", 20, 1, 0, 0.5f, "");
+	env.UpdateTargets(0.25);
+	REQUIRE(s.GetPositionX() == 10);
+
+	s.SetPositionX(50);
+	env.UpdateTargets(0.5);
+	REQUIRE(s.GetPositionX() == Approx(42.5));
+}
+
+TEST_CASE("Tween callbacks fire once the finished tweens are gone")
+{
+	SceneEnvironment env("Test");
+	Sprite a(false), b(false), c(false);
+	a.SetPositionY(1);
+	c.SetPositionY(3);
+	env.AddTarget(&a);
+	env.AddTarget(&b);
+	env.AddTarget(&c);
+
+	// Callbacks may start tweens of their own.
+	env.GetEnv()->RunString(
+		"count = 0 sum = 0\n"
+		"function Done(s) count = count + 1 sum = sum + s.Y Engine:AddTween(s, \"Alpha\", 1, 0, 1, 0, 0, \"\") end");
+
+	env.AddTween(&a, "X", 0, 100, 0.5f, 0, 0, "Done");
+	env.AddTween(&b, "X", 0, 100, 2, 0, 0, "Done");
+	env.AddTween(&c, "X", 0, 100, 0.5f, 0, 0, "Done");
+
+	env.UpdateTargets(1);
+	REQUIRE(env.GetEnv()->GetGlobalD("count") == 2);
+	REQUIRE(env.GetEnv()->GetGlobalD("sum") == 4);
+	REQUIRE(a.GetPositionX() == Approx(100));
+	REQUIRE(b.GetPositionX() == Approx(50));
+	REQUIRE(c.GetPositionX() == Approx(100));
+
+	env.UpdateTargets(0.5);
+	REQUIRE(a.Alpha == Approx(0.5));
+	REQUIRE(b.GetPositionX() == Approx(75));
+	REQUIRE(c.Alpha == Approx(0.5));
+
+	env.UpdateTargets(1);
+	REQUIRE(env.GetEnv()->GetGlobalD("count") == 3);
+}
+
+TEST_CASE("Removing a managed object stops its tweens")
+{
+	SceneEnvironment env("Test");
+	env.GetEnv()->RunString("gone = 0 function Gone(s) gone = gone + 1 end");
+
+	auto s = env.CreateObject();
+	env.AddTween(s, "X", 0, 100, 1, 0, 0, "Gone");
+	env.UpdateTargets(0.25);
+	env.RemoveManagedObject(s);
+
+	env.UpdateTargets(1);
+	REQUIRE(env.GetEnv()->GetGlobalD("gone") == 0);
+}
+
+TEST_CASE("Chained transformations follow their chain")
+{
+	Transformation parent, child;
+	child.ChainTransformation(&parent);
+	child.SetPosition(1, 0);
+	REQUIRE(child.GetMatrix()[3][0] == 1);
+
+	auto gen = child.GetGeneration();
+	child.GetMatrix();
+	REQUIRE(child.GetGeneration() == gen);
+
+	parent.SetPosition(2, 0);
+	REQUIRE(child.GetMatrix()[3][0] == 3);
+	REQUIRE(child.GetGeneration() != gen);
+}
+
+TEST_CASE("osu storyboard video sprites with only a looped fade")
+{
+	Interruptible stub;
+	osuBackgroundAnimation bga(&stub, nullptr, nullptr);
+
+	std::stringstream in(
+		"Sprite,Foreground,Centre,\"clip.mp4\",320,240\n"
+		" L,1000,2\n"
+		"  F,0,0,500,0,1\n");
+	auto sprites = ReadOSBEvents(in);
+	REQUIRE(sprites.size() == 1);
+
+	// No fade of its own, so the video's clock has to start with the loop.
+	auto &sp = sprites[0];
+	REQUIRE(sp.GetStartTime() == Approx(1.0f));
+
+	VideoPlayback video;
+	Sprite target(false);
+	target.SetImage(&video, false);
+	sp.SetParent(&bga);
+	sp.SetSprite(&target);
+	sp.Update(1.25f);
+
+	// A quarter into the loop's half-second fade in.
+	REQUIRE(target.Alpha == Approx(0.5f));
+}
+
+TEST_CASE("osu storyboard lines missing fields are skipped")
+{
+	std::stringstream in(
+		"Sprite,Foreground,Centre,\"a.png\",320,240\n"
+		" T,HitSound\n"
+		" F,0,1000\n"
+		" M,0,0,1000,1\n"
+		" C,0,0,1000,255,255\n"
+		" L\n"
+		" F,0,0,1000,0,1\n");
+	auto sprites = ReadOSBEvents(in);
+
+	REQUIRE(sprites.size() == 1);
+	REQUIRE(sprites[0].GetTriggers().empty());
+	REQUIRE(sprites[0].GetLoops().empty());
+	REQUIRE(sprites[0].GetStartTime() == Approx(0.0f));
+	REQUIRE(sprites[0].GetEndTime() == Approx(1.0f));
+}
+
+TEST_CASE("Compiled storyboards read back as they were stored")
+{
+	std::string events;
+	for (int i = 0; i < 20; i++)
+	{
+		auto t = std::to_string(i * 100);
+		events += "Sprite,Foreground,Centre,\"sb/" + std::to_string(i % 3) + ".png\",320,240\n";
+		events += " F,0," + t + ",1000,0,1\n";
+		events += " M,1," + t + ",2000,0,0,640,480\n";
+		events += " L,3000,2\n";
+		events += "  R,0,0,500,0,3.14\n";
+		events += " T,HitSound,0,5000\n";
+		events += "  S,0,0,100,1,2\n";
+	}
+
+	std::stringstream in(events);
+	auto parsed = ReadOSBEvents(in);
+	REQUIRE(parsed.size() == 20);
+
+	auto key = StoryboardCache::GetKey(events);
+	StoryboardCache::Store(key, parsed);
+
+	osb::SpriteList fetched;
+	REQUIRE(StoryboardCache::Fetch(key, fetched));
+	REQUIRE(fetched.size() == parsed.size());
+
+	auto packed = [](const osb::EventComponent &ec) {
+		std::vector<osb::PackedEvent> out;
+		uint32_t first[osb::EVT_COUNT], count[osb::EVT_COUNT];
+		ec.PackEvents(out, first, count);
+		return out;
+	};
+
+	auto same = [](const std::vector<osb::PackedEvent> &a, const std::vector<osb::PackedEvent> &b) {
+		return a.size() == b.size() && (a.empty() || !memcmp(a.data(), b.data(), a.size() * sizeof(osb::PackedEvent)));
+	};
+
+	for (size_t i = 0; i < parsed.size(); i++)
+	{
+		REQUIRE(fetched[i].GetStartTime() == parsed[i].GetStartTime());
+		REQUIRE(fetched[i].GetEndTime() == parsed[i].GetEndTime());
+		REQUIRE(same(packed(fetched[i]), packed(parsed[i])));
+
+		REQUIRE(fetched[i].GetLoops().size() == 1);
+		REQUIRE(fetched[i].GetLoops()[0].GetLoopCount() == 2);
+		REQUIRE(same(packed(fetched[i].GetLoops()[0]), packed(parsed[i].GetLoops()[0])));
+
+		REQUIRE(fetched[i].GetTriggers().size() == 1);
+		REQUIRE(same(packed(fetched[i].GetTriggers()[0]), packed(parsed[i].GetTriggers()[0])));
+	}
+
+	// Once the storyboard changes, what was stored for it isn't used.
+	osb::SpriteList stale;
+	REQUIRE(!StoryboardCache::Fetch(StoryboardCache::GetKey(events + " F,0,0,1,1,0\n"), stale));
+	REQUIRE(stale.empty());
+}
+
+// An uncompressed BMP with a 40 byte info header, the palette right after it and the pixels right after that.
+static std::vector<unsigned char> MakeBmp(int32_t width, int32_t height, uint16_t bpp,
+	const std::vector<unsigned char> &palette, const std::vector<unsigned char> &pixels)
+{
+	std::vector<unsigned char> out;
+	auto put = [&](uint32_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out.push_back((v >> (8 * i)) & 0xFF);
+	};
+
+	uint32_t data_offset = 14 + 40 + palette.size();
+	out.push_back('B'); out.push_back('M');
+	put(data_offset + pixels.size(), 4);
+	put(0, 4);
+	put(data_offset, 4);
+
+	put(40, 4);
+	put(width, 4);
+	put(height, 4);
+	put(1, 2);
+	put(bpp, 2);
+	put(0, 4); // compression
+	put(pixels.size(), 4);
+	put(0, 4); put(0, 4);
+	put(palette.size() / 4, 4);
+	put(0, 4);
+
+	out.insert(out.end(), palette.begin(), palette.end());
+	out.insert(out.end(), pixels.begin(), pixels.end());
+	return out;
+}
+
+static uint32_t Rgba(unsigned char r, unsigned char g, unsigned char b)
+{
+	uint32_t out;
+	unsigned char c[] = { r, g, b, 0xFF };
+	memcpy(&out, c, 4);
+	return out;
+}
+
+TEST_CASE("BMPs decode to RGBA")
+{
+	// Rows of 2 BGR pixels, padded to 8 bytes.
+	std::vector<unsigned char> top = { 0, 0, 255,  255, 255, 255,  0, 0 };
+	std::vector<unsigned char> bottom = { 255, 0, 0,  0, 255, 0,  0, 0 };
+	std::vector<uint32_t> expected = { Rgba(255, 0, 0), Rgba(255, 255, 255), Rgba(0, 0, 255), Rgba(0, 255, 0) };
+
+	SECTION("bottom-up")
+	{
+		auto pixels = bottom;
+		pixels.insert(pixels.end(), top.begin(), top.end());
+		auto bmp = MakeBmp(2, 2, 24, {}, pixels);
+		auto img = ImageLoader::GetDataForImageFromMemory(bmp.data(), bmp.size());
+		REQUIRE(img.Width == 2);
+		REQUIRE(img.Height == 2);
+		REQUIRE(img.Data == expected);
+	}
+
+	SECTION("top-down")
+	{
+		auto pixels = top;
+		pixels.insert(pixels.end(), bottom.begin(), bottom.end());
+		auto bmp = MakeBmp(2, -2, 24, {}, pixels);
+		auto img = ImageLoader::GetDataForImageFromMemory(bmp.data(), bmp.size());
+		REQUIRE(img.Height == 2);
+		REQUIRE(img.Data == expected);
+	}
+
+	SECTION("palettized")
+	{
+		std::vector<unsigned char> palette = { 0, 0, 255, 0,  0, 255, 0, 0 };
+		auto bmp = MakeBmp(3, 1, 8, palette, { 1, 0, 1, 0 });
+		auto img = ImageLoader::GetDataForImageFromMemory(bmp.data(), bmp.size());
+		REQUIRE(img.Width == 3);
+		REQUIRE((img.Data == std::vector<uint32_t>{ Rgba(0, 255, 0), Rgba(255, 0, 0), Rgba(0, 255, 0) }));
+	}
+}
+
+TEST_CASE("BMPs whose headers don't fit the file are rejected")
+{
+	std::vector<unsigned char> palette = { 0, 0, 255, 0,  0, 255, 0, 0 };
+	auto bmp = MakeBmp(3, 1, 8, palette, { 1, 0, 1, 0 });
+	auto set32 = [&](size_t at, uint32_t v)
+	{
+		for (int i = 0; i < 4; i++)
+			bmp[at + i] = (v >> (8 * i)) & 0xFF;
+	};
+
+	SECTION("height with no positive counterpart")
+	{
+		set32(22, 0x80000000);
+	}
+
+	SECTION("info header past the end")
+	{
+		set32(14, 0xFFFFFFF0);
+	}
+
+	SECTION("palette running into the pixels")
+	{
+		set32(46, 256);
+	}
+
+	SECTION("pixels starting past the end")
+	{
+		set32(10, bmp.size() + 1);
+	}
+
+	SECTION("pixels cut short")
+	{
+		bmp.pop_back();
+	}
+
+	SECTION("more rows than the file holds")
+	{
+		set32(22, 0x7FFFFFFF);
+	}
+
+	auto img = ImageLoader::GetDataForImageFromMemory(bmp.data(), bmp.size());
+	REQUIRE(img.Data.empty());
+	REQUIRE(img.Width == 0);
+	REQUIRE(img.Height == 0);
+}
+
+TEST_CASE("Streamed images that can't be loaded are failed, not retried")
+{
+	ImageStreamer streamer(1.0, 1);
+	streamer.AddImage(0, "tests/files/missing.png");
+	streamer.AddImage(1, "tests/files/jnight.ssc"); // Not an image.
+	streamer.AddInterval(0, 0, 1);
+	streamer.AddInterval(1, 0, 1);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (!(streamer.HasFailed(0) && streamer.HasFailed(1)) && std::chrono::steady_clock::now() < deadline)
+	{
+		streamer.Update(0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	REQUIRE(streamer.HasFailed(0));
+	REQUIRE(streamer.HasFailed(1));
+	REQUIRE(streamer.GetFromIndex(0) == nullptr);
+
+	// Released and asked for again, they stay failed.
+	streamer.Update(2);
+	streamer.AddInterval(0, 3, 4);
+	streamer.Update(3);
+	REQUIRE(streamer.HasFailed(0));
+}
+
+// Not run by default. Forward playback walks the per-sprite event cursors,
+// playing backwards makes every update a seek (binary search).
+// sprites sprites, each fading and moving events times in a row, 50ms apart.
+static std::string MakeLongStoryboard(int sprites, int events)
+{
+	std::stringstream out;
+	for (int s = 0; s < sprites; s++)
+	{
+		out << "Sprite,Foreground,Centre,\"sb/" << s << ".png\",320,240\n";
+		for (int e = 0; e < events; e++)
+		{
+			int t = s * 10 + e * 50;
+			out << " F,0," << t << "," << t + 50 << "," << e % 2 << "," << (e + 1) % 2 << "\n";
+			out << " M,0," << t << "," << t + 50 << "," << e << "," << s << "," << e + 1 << "," << s + 1 << "\n";
+		}
+	}
+
+	return out.str();
+}
+
+TEST_CASE("osu storyboard updates give the same result whichever way time goes")
+{
+	Interruptible stub;
+	osuBackgroundAnimation bga(&stub, nullptr, nullptr);
+
+	auto board = MakeLongStoryboard(3, 100);
+	std::stringstream in(board), in_ref(board);
+	auto sprites = ReadOSBEvents(in);
+	auto refs = ReadOSBEvents(in_ref);
+	REQUIRE(sprites.size() == 3);
+
+	std::vector<Sprite> targets(sprites.size(), Sprite(false)), ref_targets(targets);
+	for (size_t i = 0; i < sprites.size(); i++) {
+		sprites[i].SetParent(&bga);
+		sprites[i].SetSprite(&targets[i]);
+		refs[i].SetParent(&bga);
+		refs[i].SetSprite(&ref_targets[i]);
+	}
+
+	// Play a while, seek back to the middle and the start, and past either end.
+	std::vector<float> times;
+	for (float t = 0; t < 2; t += 1.f / 60.f) times.push_back(t);
+	for (float t = 1; t < 3; t += 1.f / 60.f) times.push_back(t);
+	for (float t : { 0.f, 4.f, -1.f, 2.5f, 2.49f, 2.51f, 6.f, 0.02f }) times.push_back(t);
+
+	for (auto t : times) {
+		for (size_t i = 0; i < sprites.size(); i++) {
+			sprites[i].Update(t);
+
+			// A lookup from scratch each time, as before sprites kept cursors.
+			refs[i].ResetCursors();
+			refs[i].Update(t);
+
+			INFO("sprite " << i << " at " << t);
+			REQUIRE(targets[i].Alpha == ref_targets[i].Alpha);
+			REQUIRE(targets[i].GetPositionX() == ref_targets[i].GetPositionX());
+			REQUIRE(targets[i].GetPositionY() == ref_targets[i].GetPositionY());
+		}
+	}
+}
+
+TEST_CASE("osu storyboard update benchmark", "[benchmark]")
+{
+	Interruptible stub;
+	osuBackgroundAnimation bga(&stub, nullptr, nullptr);
+
+	auto bench = [&](const char* name, std::istream &in) {
+		auto sprites = ReadOSBEvents(in);
+		REQUIRE(sprites.size() != 0);
+
+		std::vector<Sprite> targets(sprites.size(), Sprite(false));
+		float start = std::numeric_limits<float>::infinity(), end = -start;
+		for (size_t i = 0; i < sprites.size(); i++) {
+			sprites[i].SetParent(&bga);
+			sprites[i].SetSprite(&targets[i]);
+			start = std::min(start, sprites[i].GetStartTime());
+			end = std::max(end, sprites[i].GetEndTime());
+		}
+
+		// Baseline resets the cursors before every update, so each lookup is a binary search.
+		auto run = [&](float from, float step, bool baseline) {
+			auto t0 = std::chrono::steady_clock::now();
+			for (float t = from; t >= start && t <= end; t += step)
+				for (auto &sp : sprites) {
+					if (baseline) sp.ResetCursors();
+					sp.Update(t);
+				}
+
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		};
+
+		auto forward_base = run(start, 1.f / 60.f, true);
+		auto forward = run(start, 1.f / 60.f, false);
+		auto backward_base = run(end, -1.f / 60.f, true);
+		auto backward = run(end, -1.f / 60.f, false);
+
+		Log::Printf("%s: %d sprites over %.1f seconds. Forward: %.3fs (binary search only: %.3fs), "
+			"backward (seeking): %.3fs (binary search only: %.3fs)\n",
+			name, int(sprites.size()), end - start, forward, forward_base, backward, backward_base);
+	};
+
+	std::ifstream esb("tests/files/esb.osb");
+	std::string head;
+	REQUIRE(std::getline(esb, head));
+	bench("esb.osb", esb);
+
+	std::stringstream generated(MakeLongStoryboard(100, 1000));
+	bench("100 sprites, 1000 events each", generated);
+}